@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: MIT
+
+//! Checks the boot report logged by the kernel at the end of setup for regressions.
+//!
+//! The image is booted headless, the report is read from the kernel output and written to
+//! `<install prefix>/<target>/boot_report.txt`, which can be given as the baseline of a later run with
+//! `-Dboot_baseline`.
+
+const std = @import("std");
+const builtin = @import("builtin");
+
+const boot_report_format = @import("../kernel/boot_report_format.zig");
+
+const CascadeTarget = @import("CascadeTarget.zig").CascadeTarget;
+const Options = @import("Options.zig");
+
+const BootReport = @This();
+
+phases: std.ArrayListUnmanaged(Phase) = .{},
+total_nanoseconds: u64 = 0,
+
+/// The lines of the report without any prefix added by the kernel log.
+lines: std.ArrayListUnmanaged([]const u8) = .{},
+
+const Phase = struct {
+    name: []const u8,
+    nanoseconds: u64,
+};
+
+/// How long to wait for the kernel to log its boot report before giving up.
+const timeout_seconds = 120;
+
+/// Phases that take less than this much longer than the baseline are never regressions, the shortest phases vary by
+/// more than any reasonable percentage from run to run.
+const noise_floor_nanoseconds = std.time.ns_per_ms;
+
+/// Boots the image by running `argv`, then fails if the boot report shows a regression.
+pub fn check(b: *std.Build, argv: []const []const u8, target: CascadeTarget, options: Options) !void {
+    var child = std.ChildProcess.init(argv, b.allocator);
+    child.stdin_behavior = .Ignore;
+    child.stdout_behavior = .Pipe;
+    child.stderr_behavior = .Inherit;
+
+    try child.spawn();
+    defer _ = child.kill() catch {};
+
+    // the watchdog refers to `child` and `finished`, so it is joined before they go out of scope
+    var finished: std.Thread.ResetEvent = .{};
+    const watchdog = try std.Thread.spawn(.{}, killAfterTimeout, .{ &child, &finished });
+    defer {
+        finished.set();
+        watchdog.join();
+    }
+
+    const report = try readFrom(b.allocator, child.stdout.?.reader());
+
+    try report.write(b, target);
+    report.print();
+
+    var regressed = false;
+
+    if (options.boot_time_limit_ms != 0 and
+        report.total_nanoseconds > options.boot_time_limit_ms * std.time.ns_per_ms)
+    {
+        std.debug.print("boot took {} ms, over the limit of {} ms\n", .{
+            report.total_nanoseconds / std.time.ns_per_ms,
+            options.boot_time_limit_ms,
+        });
+        regressed = true;
+    }
+
+    if (options.boot_baseline) |baseline_path| {
+        const baseline_file = try std.fs.cwd().openFile(baseline_path, .{});
+        defer baseline_file.close();
+
+        const baseline = try readFrom(b.allocator, baseline_file.reader());
+
+        if (report.compareAgainst(baseline, options.boot_regression_percent)) regressed = true;
+    }
+
+    if (regressed) return error.BootTimeRegression;
+}
+
+fn killAfterTimeout(child: *std.ChildProcess, finished: *std.Thread.ResetEvent) void {
+    finished.timedWait(timeout_seconds * std.time.ns_per_s) catch |err| switch (err) {
+        error.Timeout => {},
+    };
+
+    if (finished.isSet()) return;
+
+    std.debug.print("no boot report after {} seconds\n", .{timeout_seconds});
+
+    // ending qemu ends its output, which fails the read of the report
+    if (builtin.os.tag == .windows) {
+        std.os.windows.TerminateProcess(child.id, 1) catch {};
+    } else {
+        std.os.kill(child.id, std.os.SIG.KILL) catch {};
+    }
+}
+
+/// Reads a boot report from `reader`, ignoring any line that is not part of the report.
+fn readFrom(allocator: std.mem.Allocator, reader: anytype) !BootReport {
+    var report: BootReport = .{};
+
+    while (try reader.readUntilDelimiterOrEofAlloc(allocator, '\n', 64 * 1024)) |raw_line| {
+        const marker_index = std.mem.indexOf(u8, raw_line, boot_report_format.line_marker) orelse continue;
+        const line = std.mem.trimRight(u8, raw_line[marker_index..], "\r");
+
+        try report.lines.append(allocator, line);
+
+        var fields = std.mem.tokenizeScalar(u8, line[boot_report_format.line_marker.len..], ' ');
+        const kind = fields.next() orelse return error.MalformedBootReport;
+
+        if (std.mem.eql(u8, kind, "end")) return report;
+
+        const nanoseconds = try std.fmt.parseInt(u64, fields.next() orelse return error.MalformedBootReport, 10);
+
+        if (std.mem.eql(u8, kind, "total")) {
+            report.total_nanoseconds = nanoseconds;
+        } else if (std.mem.eql(u8, kind, "phase")) {
+            // the percentage is recalculated when needed
+            _ = fields.next() orelse return error.MalformedBootReport;
+
+            try report.phases.append(allocator, .{
+                .name = fields.rest(),
+                .nanoseconds = nanoseconds,
+            });
+        } else return error.MalformedBootReport;
+    }
+
+    return error.NoBootReport;
+}
+
+fn write(self: BootReport, b: *std.Build, target: CascadeTarget) !void {
+    const directory_path = b.pathJoin(&.{ b.install_path, @tagName(target) });
+    try std.fs.cwd().makePath(directory_path);
+
+    const file = try std.fs.cwd().createFile(b.pathJoin(&.{ directory_path, "boot_report.txt" }), .{});
+    defer file.close();
+
+    for (self.lines.items) |line| {
+        try file.writer().print("{s}\n", .{line});
+    }
+}
+
+fn print(self: BootReport) void {
+    for (self.phases.items) |phase| {
+        std.debug.print("{d:>10.3} ms  {s}\n", .{ toMilliseconds(phase.nanoseconds), phase.name });
+    }
+    std.debug.print("{d:>10.3} ms  total\n", .{toMilliseconds(self.total_nanoseconds)});
+}
+
+/// Prints every phase and the total that are more than `percent` slower than in `baseline`, returns true if there
+/// were any.
+fn compareAgainst(self: BootReport, baseline: BootReport, percent: u64) bool {
+    var regressed = isRegression("total", self.total_nanoseconds, baseline.total_nanoseconds, percent);
+
+    for (self.phases.items) |phase| {
+        const baseline_phase = for (baseline.phases.items) |baseline_phase| {
+            if (std.mem.eql(u8, baseline_phase.name, phase.name)) break baseline_phase;
+        } else continue;
+
+        if (isRegression(phase.name, phase.nanoseconds, baseline_phase.nanoseconds, percent)) regressed = true;
+    }
+
+    return regressed;
+}
+
+fn isRegression(name: []const u8, nanoseconds: u64, baseline_nanoseconds: u64, percent: u64) bool {
+    const allowed = baseline_nanoseconds + @max(baseline_nanoseconds * percent / 100, noise_floor_nanoseconds);
+    if (nanoseconds <= allowed) return false;
+
+    std.debug.print("regression in {s}: {d:.3} ms, baseline {d:.3} ms\n", .{
+        name,
+        toMilliseconds(nanoseconds),
+        toMilliseconds(baseline_nanoseconds),
+    });
+    return true;
+}
+
+fn toMilliseconds(nanoseconds: u64) f64 {
+    return @as(f64, @floatFromInt(nanoseconds)) / std.time.ns_per_ms;
+}
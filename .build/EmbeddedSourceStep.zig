@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: MIT
+
+//! Builds the embedded form of the kernel's source files, described in `kernel/debug/embedded_source_format.zig`.
+//!
+//! Compressing every source file is slow, so it is done when the step is made rather than while the build graph is
+//! constructed, and the results are cached until a source file changes.
+
+const std = @import("std");
+const Step = std.Build.Step;
+
+const embedded_source_format = @import("../kernel/debug/embedded_source_format.zig");
+
+const EmbeddedSourceStep = @This();
+
+step: Step,
+
+files: std.ArrayListUnmanaged(*File) = .{},
+
+const File = struct {
+    /// The path of the file relative to the root of the repository, used as the name of its module.
+    name: []const u8,
+
+    /// The path of the source file.
+    path: []const u8,
+
+    /// The embedded form of the file.
+    generated: std.Build.GeneratedFile,
+};
+
+pub fn create(b: *std.Build) !*EmbeddedSourceStep {
+    const self = try b.allocator.create(EmbeddedSourceStep);
+    self.* = .{
+        .step = Step.init(.{
+            .id = .custom,
+            .name = "build embedded source files",
+            .owner = b,
+            .makeFn = make,
+        }),
+    };
+    return self;
+}
+
+/// Adds the source file at `path`, returns the embedded form of the file once the step is made.
+pub fn addFile(self: *EmbeddedSourceStep, name: []const u8, path: []const u8) !std.Build.FileSource {
+    const b = self.step.owner;
+
+    const file = try b.allocator.create(File);
+    file.* = .{
+        .name = name,
+        .path = path,
+        .generated = .{ .step = &self.step },
+    };
+
+    try self.files.append(b.allocator, file);
+
+    return .{ .generated = &file.generated };
+}
+
+fn make(step: *Step, progress_node: *std.Progress.Node) !void {
+    const b = step.owner;
+    const self = @fieldParentPtr(EmbeddedSourceStep, "step", step);
+
+    var node = progress_node.start(step.name, self.files.items.len);
+    defer node.end();
+
+    progress_node.activate();
+
+    var cache_manifest = b.cache.obtain();
+    defer cache_manifest.deinit();
+
+    _ = try cache_manifest.addFile(b.pathFromRoot(".build/EmbeddedSourceStep.zig"), null);
+    _ = try cache_manifest.addFile(b.pathFromRoot("kernel/debug/embedded_source_format.zig"), null);
+
+    for (self.files.items) |file| {
+        cache_manifest.hash.addBytes(file.name);
+        _ = try cache_manifest.addFile(file.path, null);
+    }
+
+    const hit = try step.cacheHit(&cache_manifest);
+
+    const digest = cache_manifest.final();
+    const cache_path = "o" ++ std.fs.path.sep_str ++ digest;
+
+    for (self.files.items) |file| {
+        file.generated.path = try b.cache_root.join(b.allocator, &.{ cache_path, outputName(b, file) });
+    }
+
+    if (hit) return;
+
+    var output_directory = try b.cache_root.handle.makeOpenPath(cache_path, .{});
+    defer output_directory.close();
+
+    var arena = std.heap.ArenaAllocator.init(b.allocator);
+    defer arena.deinit();
+
+    for (self.files.items) |file| {
+        defer _ = arena.reset(.retain_capacity);
+        const allocator = arena.allocator();
+
+        const contents = try std.fs.cwd().readFileAlloc(allocator, file.path, std.math.maxInt(usize));
+
+        const output_name = outputName(b, file);
+        if (std.fs.path.dirname(output_name)) |directory| try output_directory.makePath(directory);
+        try output_directory.writeFile(output_name, try buildEmbeddedSourceFile(allocator, contents));
+
+        node.completeOne();
+    }
+
+    try step.writeManifest(&cache_manifest);
+}
+
+fn outputName(b: *std.Build, file: *const File) []const u8 {
+    return b.fmt("{s}.compressed", .{file.name});
+}
+
+/// Builds the embedded form of a source file, see `kernel/debug/embedded_source_format.zig`.
+fn buildEmbeddedSourceFile(allocator: std.mem.Allocator, contents: []const u8) ![]const u8 {
+    var output = std.ArrayList(u8).init(allocator);
+    errdefer output.deinit();
+
+    const writer = output.writer();
+
+    const number_of_lines = std.mem.count(u8, contents, "\n") + 1;
+
+    try writer.writeStruct(embedded_source_format.Header{
+        .number_of_lines = @intCast(number_of_lines),
+        .uncompressed_size = @intCast(contents.len),
+    });
+
+    try writer.writeIntLittle(u32, 0);
+    for (contents, 0..) |char, i| {
+        if (char == '\n') try writer.writeIntLittle(u32, @intCast(i + 1));
+    }
+
+    var compressor = try std.compress.deflate.compressor(allocator, writer, .{ .level = .best_compression });
+    defer compressor.deinit();
+
+    _ = try compressor.write(contents);
+    try compressor.close();
+
+    return output.toOwnedSlice();
+}
@@ -6,9 +6,11 @@ const Step = std.Build.Step;
 const helpers = @import("helpers.zig");
 
 const CascadeTarget = @import("CascadeTarget.zig").CascadeTarget;
+const EmbeddedSourceStep = @import("EmbeddedSourceStep.zig");
 const Library = @import("Library.zig");
 const Options = @import("Options.zig");
 const StepCollection = @import("StepCollection.zig");
+const SymbolTableStep = @import("SymbolTableStep.zig");
 
 const Kernel = @This();
 
@@ -19,6 +21,9 @@ options: Options,
 
 install_step: *Step.InstallArtifact,
 
+/// Generates the symbol table of the kernel, installed next to it.
+symbol_table_step: *SymbolTableStep,
+
 /// Registers kernel build steps.
 ///
 /// For each target, creates a `Kernel` and registers its install_step with the `StepCollection`.
@@ -34,6 +39,7 @@ pub fn registerKernels(
     for (targets) |target| {
         const kernel = try Kernel.create(b, target, libraries, options, source_file_modules);
         step_collection.registerKernel(target, &kernel.install_step.step);
+        step_collection.registerKernel(target, &kernel.symbol_table_step.step);
     }
 }
 
@@ -95,7 +101,9 @@ fn create(
 
     // TODO: LTO cannot be enabled https://github.com/CascadeOS/CascadeOS/issues/8
     kernel_exe.want_lto = false;
-    kernel_exe.omit_frame_pointer = false;
+    // stacks are walked with unwind entries computed from `.debug_frame` rather than frame pointers, see
+    // `kernel/debug/StackIterator.zig`, so the frame pointer is free to be used as a general purpose register
+    kernel_exe.omit_frame_pointer = options.optimize == .ReleaseFast;
     kernel_exe.disable_stack_probing = true;
     kernel_exe.pie = true;
 
@@ -106,6 +114,7 @@ fn create(
         .target = target,
         .options = options,
         .install_step = b.addInstallArtifact(kernel_exe),
+        .symbol_table_step = try SymbolTableStep.create(b, target, kernel_exe),
     };
 }
 
@@ -123,6 +132,9 @@ const SourceFileModule = struct {
 ///
 /// This allows combining `ComptimeStringHashMap` and `@embedFile(file_name)`, providing access to the contents of
 /// source files by file path key, which is exactly what is needed for printing source code in stacktraces.
+///
+/// The root of each module is not the source file itself but the compressed form described in
+/// `kernel/debug/embedded_source_format.zig`, which includes the offset of every line, built by `EmbeddedSourceStep`.
 fn getSourceFileModules(b: *std.Build, libraries: Library.Collection) ![]const SourceFileModule {
     var modules = std.ArrayList(SourceFileModule).init(b.allocator);
     errdefer modules.deinit();
@@ -130,6 +142,8 @@ fn getSourceFileModules(b: *std.Build, libraries: Library.Collection) ![]const S
     var file_paths = std.ArrayList([]const u8).init(b.allocator);
     defer file_paths.deinit();
 
+    const embedded_source_step = try EmbeddedSourceStep.create(b);
+
     const root_path = std.fmt.allocPrint(
         b.allocator,
         comptime "{s}" ++ std.fs.path.sep_str,
@@ -137,17 +151,30 @@ fn getSourceFileModules(b: *std.Build, libraries: Library.Collection) ![]const S
     ) catch unreachable;
 
     // add the kernel's files
-    try addFilesRecursive(b, &modules, &file_paths, root_path, helpers.pathJoinFromRoot(b, &.{"kernel"}));
+    try addFilesRecursive(
+        b,
+        &modules,
+        &file_paths,
+        embedded_source_step,
+        root_path,
+        helpers.pathJoinFromRoot(b, &.{"kernel"}),
+    );
 
     // add each dependencies files
     const kernel_dependencies: []const []const u8 = @import("../kernel/dependencies.zig").dependencies;
     for (kernel_dependencies) |dependency| {
         const library = libraries.get(dependency).?;
         const root_file_path = library.getRootFilePath(b);
-        try addFilesRecursive(b, &modules, &file_paths, root_path, std.fs.path.dirname(root_file_path).?);
+        try addFilesRecursive(
+            b,
+            &modules,
+            &file_paths,
+            embedded_source_step,
+            root_path,
+            std.fs.path.dirname(root_file_path).?,
+        );
     }
 
-    // TODO: compress the embeded files https://github.com/CascadeOS/CascadeOS/issues/48
     // TODO: embed the std lib (all of it or parts?) https://github.com/CascadeOS/CascadeOS/issues/49
 
     const files_option = b.addOptions();
@@ -165,6 +192,7 @@ fn addFilesRecursive(
     b: *std.Build,
     modules: *std.ArrayList(SourceFileModule),
     files: *std.ArrayList([]const u8),
+    embedded_source_step: *EmbeddedSourceStep,
     root_path: []const u8,
     target_path: []const u8,
 ) !void {
@@ -183,8 +211,9 @@ fn addFilesRecursive(
 
                     if (removeRootPrefixFromPath(path, root_path)) |name| {
                         try files.append(name);
+
                         const module = b.createModule(.{
-                            .source_file = .{ .path = path },
+                            .source_file = try embedded_source_step.addFile(name, path),
                         });
                         try modules.append(.{ .name = name, .module = module });
                     } else {
@@ -197,7 +226,7 @@ fn addFilesRecursive(
                 if (file.name[0] == '.') continue; // skip hidden directories
 
                 const path = b.pathJoin(&.{ target_path, file.name });
-                try addFilesRecursive(b, modules, files, root_path, path);
+                try addFilesRecursive(b, modules, files, embedded_source_step, root_path, path);
             },
             else => {},
         }
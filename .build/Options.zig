@@ -43,12 +43,37 @@ uefi: bool,
 /// Defaults to 256 for UEFI and 128 otherwise.
 memory: usize,
 
+/// Fail the boot report if setup takes longer than this many milliseconds, zero disables the limit.
+boot_time_limit_ms: u64,
+
+/// A boot report to compare against, phases slower than it by more than `boot_regression_percent` fail the boot
+/// report.
+boot_baseline: ?[]const u8,
+
+/// How much slower than `boot_baseline` a phase can be before it is a regression.
+boot_regression_percent: u64,
+
 /// Force the provided log scopes to be debug in the kernel (comma separated list of wildcard scope matchers).
 kernel_forced_debug_log_scopes: []const u8,
 
 /// Force the log level of every scope to be debug in the kernel.
 kernel_force_debug_log: bool,
 
+/// Compile debug messages out of the kernel, so they cannot be enabled at runtime.
+kernel_compile_out_debug_log: bool,
+
+/// Run the in-kernel benchmarks after system setup.
+kernel_run_benchmarks: bool,
+
+/// Log the raw arguments of messages and format them when they are written out rather than when they are logged.
+kernel_binary_log: bool,
+
+/// Profile the kernel for this many seconds after system setup, zero disables profiling.
+kernel_profile_seconds: u64,
+
+/// Write kernel output to the QEMU debug console rather than the serial port, only supported on x86_64.
+kernel_debugcon: bool,
+
 /// Module containing kernel options.
 kernel_option_module: *std.Build.Module,
 
@@ -124,6 +149,24 @@ pub fn get(b: *std.Build, cascade_version: std.SemanticVersion, targets: []const
         "How much memory (in MB) to request from qemu (defaults to 256 for UEFI and 128 otherwise)",
     ) orelse if (uefi) 256 else 128;
 
+    const boot_time_limit_ms = b.option(
+        u64,
+        "boot_time_limit",
+        "Fail the boot report if setup takes longer than the given number of milliseconds",
+    ) orelse 0;
+
+    const boot_baseline = b.option(
+        []const u8,
+        "boot_baseline",
+        "Fail the boot report if any phase is slower than in the given earlier boot report",
+    );
+
+    const boot_regression_percent = b.option(
+        u64,
+        "boot_regression_percent",
+        "How much slower than the boot baseline a phase can be before it is a regression (default 10)",
+    ) orelse 10;
+
     const kernel_force_debug_log = b.option(
         bool,
         "force_debug_log",
@@ -136,6 +179,36 @@ pub fn get(b: *std.Build, cascade_version: std.SemanticVersion, targets: []const
         "Force the provided log scopes to be debug in the kernel (comma separated list of wildcard scope matchers)",
     ) orelse "";
 
+    const kernel_compile_out_debug_log = b.option(
+        bool,
+        "compile_out_debug_log",
+        "Compile debug messages out of the kernel, so they cannot be enabled at runtime",
+    ) orelse false;
+
+    const kernel_run_benchmarks = b.option(
+        bool,
+        "benchmarks",
+        "Run the in-kernel benchmarks after system setup",
+    ) orelse false;
+
+    const kernel_binary_log = b.option(
+        bool,
+        "binary_log",
+        "Log the raw arguments of messages and format them when they are written out rather than when they are logged",
+    ) orelse false;
+
+    const kernel_profile_seconds = b.option(
+        u64,
+        "profile",
+        "Profile the kernel for the given number of seconds after system setup and log the samples as folded stacks",
+    ) orelse 0;
+
+    const kernel_debugcon = b.option(
+        bool,
+        "debugcon",
+        "Write kernel output to the QEMU debug console rather than the serial port, only supported on x86_64",
+    ) orelse false;
+
     const cascade_version_string = try getVersionString(b, cascade_version);
 
     return .{
@@ -150,12 +223,25 @@ pub fn get(b: *std.Build, cascade_version: std.SemanticVersion, targets: []const
         .number_of_cores = number_of_cores,
         .uefi = uefi,
         .memory = memory,
+        .boot_time_limit_ms = boot_time_limit_ms,
+        .boot_baseline = boot_baseline,
+        .boot_regression_percent = boot_regression_percent,
         .kernel_force_debug_log = kernel_force_debug_log,
         .kernel_forced_debug_log_scopes = kernel_forced_debug_log_scopes,
+        .kernel_compile_out_debug_log = kernel_compile_out_debug_log,
+        .kernel_run_benchmarks = kernel_run_benchmarks,
+        .kernel_binary_log = kernel_binary_log,
+        .kernel_profile_seconds = kernel_profile_seconds,
+        .kernel_debugcon = kernel_debugcon,
         .kernel_option_module = try buildKernelOptionModule(
             b,
             kernel_force_debug_log,
             kernel_forced_debug_log_scopes,
+            kernel_compile_out_debug_log,
+            kernel_run_benchmarks,
+            kernel_binary_log,
+            kernel_profile_seconds,
+            kernel_debugcon,
             cascade_version_string,
         ),
         .target_specific_kernel_options_modules = try buildKernelTargetOptionModules(b, targets),
@@ -197,6 +283,11 @@ fn buildKernelOptionModule(
     b: *std.Build,
     force_debug_log: bool,
     forced_debug_log_scopes: []const u8,
+    compile_out_debug_log: bool,
+    run_benchmarks: bool,
+    binary_log: bool,
+    profile_seconds: u64,
+    debugcon: bool,
     cascade_version_string: []const u8,
 ) !*std.Build.Module {
     const root_path = std.fmt.allocPrint(
@@ -211,6 +302,15 @@ fn buildKernelOptionModule(
 
     kernel_options.addOption(bool, "force_debug_log", force_debug_log);
     addStringLiteralSliceOption(kernel_options, "forced_debug_log_scopes", forced_debug_log_scopes);
+    kernel_options.addOption(bool, "compile_out_debug_log", compile_out_debug_log);
+
+    kernel_options.addOption(bool, "run_benchmarks", run_benchmarks);
+
+    kernel_options.addOption(bool, "binary_log", binary_log);
+
+    kernel_options.addOption(u64, "profile_seconds", profile_seconds);
+
+    kernel_options.addOption(bool, "debugcon", debugcon);
 
     kernel_options.addOption([]const u8, "root_path", root_path);
 
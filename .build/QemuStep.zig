@@ -8,6 +8,7 @@ const ansi = @import("../libraries/ansi/ansi.zig");
 
 const helpers = @import("helpers.zig");
 
+const BootReport = @import("BootReport.zig");
 const CascadeTarget = @import("CascadeTarget.zig").CascadeTarget;
 const EDK2Step = @import("EDK2Step.zig");
 const ImageStep = @import("ImageStep.zig");
@@ -24,12 +25,23 @@ options: Options,
 
 uefi: bool,
 
+mode: Mode,
+
 /// Only non-null if uefi is true
 edk2_step: ?*EDK2Step,
 
+pub const Mode = enum {
+    /// Run the image with the output and optionally the monitor on stdio.
+    interactive,
+
+    /// Run the image headless and check the boot report of the kernel, see `BootReport`.
+    boot_report,
+};
+
 /// Registers QEMU steps for all targets.
 ///
-/// For each target, creates a `QemuStep` that runs the image for the target using QEMU.
+/// For each target, creates a `QemuStep` that runs the image for the target using QEMU and another that checks its
+/// boot report.
 pub fn registerQemuSteps(
     b: *std.Build,
     image_steps: ImageStep.Collection,
@@ -39,7 +51,7 @@ pub fn registerQemuSteps(
     for (targets) |target| {
         const image_step = image_steps.get(target).?;
 
-        const qemu_step = try QemuStep.create(b, target, image_step.image_file_source, options);
+        const qemu_step = try QemuStep.create(b, target, image_step.image_file_source, options, .interactive);
 
         const qemu_step_name = try std.fmt.allocPrint(
             b.allocator,
@@ -54,18 +66,46 @@ pub fn registerQemuSteps(
 
         const run_step = b.step(qemu_step_name, qemu_step_description);
         run_step.dependOn(&qemu_step.step);
+
+        const boot_report_qemu_step = try QemuStep.create(
+            b,
+            target,
+            image_step.image_file_source,
+            options,
+            .boot_report,
+        );
+
+        const boot_report_step_name = try std.fmt.allocPrint(
+            b.allocator,
+            "boot_report_{s}",
+            .{@tagName(target)},
+        );
+        const boot_report_step_description = try std.fmt.allocPrint(
+            b.allocator,
+            "Boot the image for {s} headless in qemu and fail on boot time regressions",
+            .{@tagName(target)},
+        );
+
+        const boot_report_step = b.step(boot_report_step_name, boot_report_step_description);
+        boot_report_step.dependOn(&boot_report_qemu_step.step);
     }
 }
 
-fn create(b: *std.Build, target: CascadeTarget, image: std.Build.FileSource, options: Options) !*QemuStep {
+fn create(
+    b: *std.Build,
+    target: CascadeTarget,
+    image: std.Build.FileSource,
+    options: Options,
+    mode: Mode,
+) !*QemuStep {
     const uefi = options.uefi or target.needsUefi();
 
     const edk2_step: ?*EDK2Step = if (uefi) try EDK2Step.create(b, target) else null;
 
     const step_name = try std.fmt.allocPrint(
         b.allocator,
-        "run qemu with {s} image",
-        .{@tagName(target)},
+        "{s} qemu with {s} image",
+        .{ if (mode == .interactive) "run" else "check boot report of", @tagName(target) },
     );
 
     const self = try b.allocator.create(QemuStep);
@@ -82,6 +122,7 @@ fn create(b: *std.Build, target: CascadeTarget, image: std.Build.FileSource, opt
         .target = target,
         .options = options,
         .uefi = uefi,
+        .mode = mode,
         .edk2_step = edk2_step,
     };
 
@@ -100,14 +141,36 @@ fn make(step: *Step, prog_node: *std.Progress.Node) !void {
 
     const run_qemu = b.addSystemCommand(&.{self.target.qemuExecutable()});
 
-    run_qemu.has_side_effects = true;
-    run_qemu.stdio = .inherit;
+    try self.addQemuArguments(b, run_qemu);
+
+    switch (self.mode) {
+        .interactive => {
+            run_qemu.has_side_effects = true;
+            run_qemu.stdio = .inherit;
+
+            // This is a hack to stop zig's progress output interfering with qemu's output
+            try ensureCurrentStdoutLineIsEmpty();
+
+            try run_qemu.step.make(prog_node);
+        },
+        .boot_report => {
+            // qemu is run directly so its output can be read as it boots, every argument added above is plain bytes
+            var argv = try std.ArrayList([]const u8).initCapacity(b.allocator, run_qemu.argv.items.len);
+            for (run_qemu.argv.items) |argument| argv.appendAssumeCapacity(argument.bytes);
+
+            try BootReport.check(b, argv.items, self.target, self.options);
+        },
+    }
+}
+
+fn addQemuArguments(self: *QemuStep, b: *std.Build, run_qemu: *Step.Run) !void {
+    const interactive = self.mode == .interactive;
 
     // no reboot
     run_qemu.addArg("-no-reboot");
 
     // no shutdown
-    run_qemu.addArg("-no-shutdown");
+    if (interactive) run_qemu.addArg("-no-shutdown");
 
     // RAM
     run_qemu.addArgs(&.{
@@ -136,7 +199,7 @@ fn make(step: *Step, prog_node: *std.Progress.Node) !void {
     });
 
     // interrupt details
-    if (self.options.interrupt_details) {
+    if (interactive and self.options.interrupt_details) {
         if (self.target == .x86_64) {
             // The "-M smm=off" below disables the SMM generated spam that happens before the kernel starts.
             run_qemu.addArgs(&[_][]const u8{ "-d", "int", "-M", "smm=off" });
@@ -146,20 +209,36 @@ fn make(step: *Step, prog_node: *std.Progress.Node) !void {
         }
     }
 
-    // qemu monitor
-    if (self.options.qemu_monitor) {
+    // the monitor is never used headless, it would consume the input and output of the boot report
+    const qemu_monitor = interactive and self.options.qemu_monitor;
+
+    // kernel output
+    if (self.options.kernel_debugcon and self.target == .x86_64) {
+        // only one device can use stdio directly, so the monitor is multiplexed with the debug console
+        if (qemu_monitor) {
+            run_qemu.addArgs(&[_][]const u8{
+                "-chardev",  "stdio,id=stdio,mux=on,signal=off",
+                "-mon",      "chardev=stdio",
+                "-debugcon", "chardev:stdio",
+            });
+        } else {
+            run_qemu.addArgs(&[_][]const u8{ "-debugcon", "stdio" });
+        }
+
+        run_qemu.addArgs(&[_][]const u8{ "-serial", "none" });
+    } else if (qemu_monitor) {
         run_qemu.addArgs(&[_][]const u8{ "-serial", "mon:stdio" });
     } else {
         run_qemu.addArgs(&[_][]const u8{ "-serial", "stdio" });
     }
 
     // gdb remote debug
-    if (self.options.qemu_remote_debug) {
+    if (interactive and self.options.qemu_remote_debug) {
         run_qemu.addArgs(&[_][]const u8{ "-s", "-S" });
     }
 
     // no display
-    if (self.options.no_display) {
+    if (!interactive or self.options.no_display) {
         run_qemu.addArgs(&[_][]const u8{ "-display", "none" });
     }
 
@@ -187,11 +266,6 @@ fn make(step: *Step, prog_node: *std.Progress.Node) !void {
     if (self.uefi) {
         run_qemu.addArgs(&[_][]const u8{ "-bios", self.edk2_step.?.firmware.getPath() });
     }
-
-    // This is a hack to stop zig's progress output interfering with qemu's output
-    try ensureCurrentStdoutLineIsEmpty();
-
-    try run_qemu.step.make(prog_node);
 }
 
 fn ensureCurrentStdoutLineIsEmpty() !void {
@@ -0,0 +1,1192 @@
+// SPDX-License-Identifier: MIT
+
+//! Generates the symbol table of a kernel, installed next to it and loaded as a Limine module so that addresses can be
+//! symbolized without parsing DWARF in the kernel.
+//!
+//! Symbols are taken from `.symtab` and source locations from running the line number programs in `.debug_line`. The
+//! unwind entries are taken from running the call frame information programs in `.debug_frame`, or `.eh_frame` if
+//! the kernel was built with unwind tables.
+//!
+//! The format is described in `kernel/debug/symbol_table_format.zig`.
+
+const std = @import("std");
+const Step = std.Build.Step;
+
+const helpers = @import("helpers.zig");
+
+const CascadeTarget = @import("CascadeTarget.zig").CascadeTarget;
+
+const format = @import("../kernel/debug/symbol_table_format.zig");
+
+const SymbolTableStep = @This();
+
+step: Step,
+
+target: CascadeTarget,
+
+/// The kernel ELF file the symbol table is generated from.
+kernel_file: std.Build.FileSource,
+
+pub fn create(b: *std.Build, target: CascadeTarget, kernel_exe: *Step.Compile) !*SymbolTableStep {
+    const step_name = try std.fmt.allocPrint(
+        b.allocator,
+        "build {s} symbol table",
+        .{@tagName(target)},
+    );
+
+    const self = try b.allocator.create(SymbolTableStep);
+    self.* = .{
+        .step = Step.init(.{
+            .id = .custom,
+            .name = step_name,
+            .owner = b,
+            .makeFn = make,
+        }),
+        .target = target,
+        .kernel_file = kernel_exe.getOutputSource(),
+    };
+
+    self.kernel_file.addStepDependencies(&self.step);
+
+    return self;
+}
+
+fn make(step: *Step, progress_node: *std.Progress.Node) !void {
+    var node = progress_node.start(step.name, 0);
+    defer node.end();
+
+    progress_node.activate();
+
+    const b = step.owner;
+    const self = @fieldParentPtr(SymbolTableStep, "step", step);
+
+    const kernel_path = self.kernel_file.getPath(b);
+
+    var cache_manifest = b.cache.obtain();
+    defer cache_manifest.deinit();
+
+    _ = try cache_manifest.addFile(kernel_path, null);
+    _ = try cache_manifest.addFile(b.pathFromRoot(".build/SymbolTableStep.zig"), null);
+    _ = try cache_manifest.addFile(b.pathFromRoot("kernel/debug/symbol_table_format.zig"), null);
+
+    const symbol_table_path = helpers.pathJoinFromRoot(b, &.{
+        "zig-out",
+        @tagName(self.target),
+        "root",
+        "boot",
+        "symbols",
+    });
+
+    // the table is generated into the cache and installed from there, so it is reinstalled if the install directory
+    // is removed
+    const hit = try step.cacheHit(&cache_manifest);
+
+    const digest = cache_manifest.final();
+    const cache_path = "o" ++ std.fs.path.sep_str ++ digest;
+    const cached_symbol_table_path = try b.cache_root.join(b.allocator, &.{ cache_path, "symbols" });
+
+    if (!hit) {
+        try self.generateInto(kernel_path, cache_path);
+        try step.writeManifest(&cache_manifest);
+    }
+
+    try std.fs.cwd().makePath(std.fs.path.dirname(symbol_table_path).?);
+    _ = try std.fs.cwd().updateFile(cached_symbol_table_path, std.fs.cwd(), symbol_table_path, .{});
+}
+
+/// Generates the symbol table of the kernel at `kernel_path` into `cache_path` in the cache.
+fn generateInto(self: *SymbolTableStep, kernel_path: []const u8, cache_path: []const u8) !void {
+    const b = self.step.owner;
+
+    var arena = std.heap.ArenaAllocator.init(b.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const elf_bytes = try std.fs.cwd().readFileAlloc(allocator, kernel_path, std.math.maxInt(usize));
+
+    const root_path = try std.fmt.allocPrint(
+        allocator,
+        comptime "{s}" ++ std.fs.path.sep_str,
+        .{b.build_root.path.?},
+    );
+
+    const symbol_table = try generate(allocator, elf_bytes, root_path, self.target);
+
+    var cache_directory = try b.cache_root.handle.makeOpenPath(cache_path, .{});
+    defer cache_directory.close();
+
+    try cache_directory.writeFile("symbols", symbol_table);
+}
+
+/// Generates the symbol table of the kernel ELF file in `elf_bytes`.
+///
+/// `root_path` is removed from the start of source file paths.
+fn generate(
+    allocator: std.mem.Allocator,
+    elf_bytes: []const u8,
+    root_path: []const u8,
+    target: CascadeTarget,
+) ![]const u8 {
+    const elf = try Elf.init(allocator, elf_bytes);
+
+    var strings = StringPool.init(allocator);
+
+    const symbols = try collectSymbols(allocator, elf, &strings);
+    const lines = try collectLines(allocator, elf, &strings, root_path);
+    const unwind_entries = try collectUnwindEntries(allocator, elf, UnwindRegisters.of(target));
+
+    var output = std.ArrayList(u8).init(allocator);
+    const writer = output.writer();
+
+    try writer.writeStruct(format.Header{
+        .number_of_symbols = @intCast(symbols.len),
+        .number_of_lines = @intCast(lines.len),
+        .number_of_unwind_entries = @intCast(unwind_entries.len),
+        .string_pool_size = @intCast(strings.bytes.items.len),
+    });
+    for (symbols) |symbol| try writer.writeStruct(symbol);
+    for (lines) |line| try writer.writeStruct(line);
+    for (unwind_entries) |unwind_entry| try writer.writeStruct(unwind_entry);
+    try writer.writeAll(strings.bytes.items);
+
+    const header = std.mem.bytesAsValue(format.Header, output.items[0..@sizeOf(format.Header)]);
+    header.checksum = std.hash.crc.Crc32WithPoly(.Castagnoli).hash(output.items[@sizeOf(format.Header)..]);
+
+    return output.toOwnedSlice();
+}
+
+/// Collects every function symbol, sorted by address.
+fn collectSymbols(allocator: std.mem.Allocator, elf: Elf, strings: *StringPool) ![]const format.SymbolEntry {
+    const symbol_section = elf.section(".symtab") orelse return error.MissingSymbolTable;
+    const symbol_strings = elf.section(".strtab") orelse return error.MissingSymbolTable;
+
+    var symbols = std.ArrayList(format.SymbolEntry).init(allocator);
+
+    const number_of_symbols = symbol_section.len / @sizeOf(std.elf.Elf64_Sym);
+    for (0..number_of_symbols) |i| {
+        const symbol = std.mem.bytesToValue(
+            std.elf.Elf64_Sym,
+            symbol_section[i * @sizeOf(std.elf.Elf64_Sym) ..][0..@sizeOf(std.elf.Elf64_Sym)],
+        );
+
+        if (symbol.st_type() != std.elf.STT_FUNC) continue;
+        if (symbol.st_value == 0 or symbol.st_size == 0) continue;
+
+        try symbols.append(.{
+            .address = symbol.st_value,
+            .size = symbol.st_size,
+            .name = try strings.add(std.mem.sliceTo(symbol_strings[symbol.st_name..], 0)),
+        });
+    }
+
+    std.sort.block(format.SymbolEntry, symbols.items, {}, struct {
+        fn lessThan(_: void, lhs: format.SymbolEntry, rhs: format.SymbolEntry) bool {
+            return lhs.address < rhs.address;
+        }
+    }.lessThan);
+
+    // aliases of the same function only need to be found once
+    var deduplicated = std.ArrayList(format.SymbolEntry).init(allocator);
+    for (symbols.items) |symbol| {
+        if (deduplicated.items.len != 0 and deduplicated.items[deduplicated.items.len - 1].address == symbol.address) {
+            continue;
+        }
+        try deduplicated.append(symbol);
+    }
+
+    return deduplicated.toOwnedSlice();
+}
+
+const LineRow = struct {
+    address: u64,
+    file: format.StringReference,
+    line: u32,
+    column: u32,
+    end_sequence: bool,
+};
+
+/// Collects the source location of every address in an executable section, sorted by address.
+fn collectLines(
+    allocator: std.mem.Allocator,
+    elf: Elf,
+    strings: *StringPool,
+    root_path: []const u8,
+) ![]const format.LineEntry {
+    const debug_line = elf.section(".debug_line") orelse return error.MissingDebugInfo;
+
+    var rows = std.ArrayList(LineRow).init(allocator);
+
+    var reader: Reader = .{ .bytes = debug_line };
+    while (reader.position < debug_line.len) {
+        try runLineProgram(allocator, elf, &reader, strings, root_path, &rows);
+    }
+
+    // at an address where one sequence ends and another starts the start must win, so it is sorted last, the sort
+    // is stable so otherwise the last row of a program at an address wins
+    std.sort.block(LineRow, rows.items, {}, struct {
+        fn lessThan(_: void, lhs: LineRow, rhs: LineRow) bool {
+            if (lhs.address != rhs.address) return lhs.address < rhs.address;
+            return lhs.end_sequence and !rhs.end_sequence;
+        }
+    }.lessThan);
+
+    var lines = std.ArrayList(format.LineEntry).init(allocator);
+
+    for (rows.items, 0..) |row, i| {
+        // only the last row at an address is ever found
+        if (i + 1 < rows.items.len and rows.items[i + 1].address == row.address) continue;
+
+        const entry: format.LineEntry = if (row.end_sequence) .{
+            .address = row.address,
+            .file = .{ .offset = 0, .length = 0 },
+            .line = 0,
+            .column = 0,
+        } else .{
+            .address = row.address,
+            .file = row.file,
+            .line = row.line,
+            .column = row.column,
+        };
+
+        // rows that do not change the location add nothing
+        if (lines.items.len != 0) {
+            const previous = lines.items[lines.items.len - 1];
+            if (previous.file.offset == entry.file.offset and
+                previous.file.length == entry.file.length and
+                previous.line == entry.line and
+                previous.column == entry.column) continue;
+        }
+
+        try lines.append(entry);
+    }
+
+    return lines.toOwnedSlice();
+}
+
+/// Runs the line number program at the position of `reader`, appending the rows of every sequence that lies in an
+/// executable section to `rows`.
+///
+/// Supports DWARF versions 2 to 5.
+fn runLineProgram(
+    allocator: std.mem.Allocator,
+    elf: Elf,
+    reader: *Reader,
+    strings: *StringPool,
+    root_path: []const u8,
+    rows: *std.ArrayList(LineRow),
+) !void {
+    var is_64 = false;
+    var unit_length: u64 = try reader.readInt(u32);
+    if (unit_length == 0xFFFF_FFFF) {
+        is_64 = true;
+        unit_length = try reader.readInt(u64);
+    }
+
+    const unit_end = reader.position + unit_length;
+    if (unit_end > reader.bytes.len) return error.InvalidDebugInfo;
+    defer reader.position = unit_end;
+
+    const version = try reader.readInt(u16);
+    if (version < 2 or version > 5) return error.UnsupportedDebugInfo;
+
+    if (version >= 5) {
+        _ = try reader.readInt(u8); // address_size
+        _ = try reader.readInt(u8); // segment_selector_size
+    }
+
+    const header_length = try reader.readOffset(is_64);
+    const program_start = reader.position + header_length;
+
+    const minimum_instruction_length = try reader.readInt(u8);
+    if (version >= 4) _ = try reader.readInt(u8); // maximum_operations_per_instruction
+    const default_is_stmt = try reader.readInt(u8);
+    _ = default_is_stmt;
+    const line_base = try reader.readInt(i8);
+    const line_range = try reader.readInt(u8);
+    const opcode_base = try reader.readInt(u8);
+
+    if (line_range == 0 or opcode_base == 0) return error.InvalidDebugInfo;
+
+    const standard_opcode_lengths = try reader.readBytes(opcode_base - 1);
+
+    var directories = std.ArrayList([]const u8).init(allocator);
+    var files = std.ArrayList(FileEntry).init(allocator);
+
+    if (version >= 5) {
+        try readEntries(elf, reader, is_64, &directories, null);
+        try readEntries(elf, reader, is_64, null, &files);
+    } else {
+        // the compilation directory, which is only available from `.debug_info`
+        try directories.append("");
+        while (true) {
+            const directory = try reader.readString();
+            if (directory.len == 0) break;
+            try directories.append(directory);
+        }
+
+        // file numbers start at one
+        try files.append(.{ .path = "", .directory_index = 0 });
+        while (true) {
+            const path = try reader.readString();
+            if (path.len == 0) break;
+            const directory_index = try reader.readUleb();
+            _ = try reader.readUleb(); // modification time
+            _ = try reader.readUleb(); // length
+            try files.append(.{ .path = path, .directory_index = directory_index });
+        }
+    }
+
+    // the file paths are only resolved and added to the string pool once used
+    const file_references = try allocator.alloc(?format.StringReference, files.items.len);
+    @memset(file_references, null);
+
+    reader.position = program_start;
+
+    var sequence = std.ArrayList(LineRow).init(allocator);
+
+    var address: u64 = 0;
+    var file: u64 = 1;
+    var line: i64 = 1;
+    var column: u64 = 0;
+
+    while (reader.position < unit_end) {
+        const opcode = try reader.readInt(u8);
+
+        var emit_row = false;
+        var end_sequence = false;
+
+        if (opcode >= opcode_base) {
+            const adjusted_opcode = opcode - opcode_base;
+            address += @as(u64, adjusted_opcode / line_range) * minimum_instruction_length;
+            line += @as(i64, line_base) + @as(i64, adjusted_opcode % line_range);
+            emit_row = true;
+        } else switch (opcode) {
+            0 => {
+                const length = try reader.readUleb();
+                if (length == 0) continue;
+                const extended_end = reader.position + length;
+
+                switch (try reader.readInt(u8)) {
+                    // DW_LNE_end_sequence
+                    1 => {
+                        emit_row = true;
+                        end_sequence = true;
+                    },
+                    // DW_LNE_set_address
+                    2 => address = switch (length - 1) {
+                        4 => try reader.readInt(u32),
+                        8 => try reader.readInt(u64),
+                        else => return error.UnsupportedDebugInfo,
+                    },
+                    else => {},
+                }
+
+                reader.position = extended_end;
+            },
+            // DW_LNS_copy
+            1 => emit_row = true,
+            // DW_LNS_advance_pc
+            2 => address += try reader.readUleb() * minimum_instruction_length,
+            // DW_LNS_advance_line
+            3 => line += try reader.readSleb(),
+            // DW_LNS_set_file
+            4 => file = try reader.readUleb(),
+            // DW_LNS_set_column
+            5 => column = try reader.readUleb(),
+            // DW_LNS_const_add_pc
+            8 => address += @as(u64, (255 - opcode_base) / line_range) * minimum_instruction_length,
+            // DW_LNS_fixed_advance_pc
+            9 => address += try reader.readInt(u16),
+            // every other standard opcode only has ULEB128 operands that do not affect the rows
+            else => for (0..standard_opcode_lengths[opcode - 1]) |_| {
+                _ = try reader.readUleb();
+            },
+        }
+
+        if (!emit_row) continue;
+
+        const file_reference = if (file < files.items.len) file_reference: {
+            if (file_references[file]) |reference| break :file_reference reference;
+
+            const path = try resolvePath(allocator, directories.items, files.items[file], root_path);
+            const reference = try strings.add(path);
+            file_references[file] = reference;
+            break :file_reference reference;
+        } else try strings.add("");
+
+        try sequence.append(.{
+            .address = address,
+            .file = file_reference,
+            .line = std.math.cast(u32, line) orelse 0,
+            .column = std.math.cast(u32, column) orelse 0,
+            .end_sequence = end_sequence,
+        });
+
+        if (end_sequence) {
+            // functions removed by the linker are left in the line programs at address zero
+            if (sequence.items.len != 0 and elf.isExecutableAddress(sequence.items[0].address)) {
+                try rows.appendSlice(sequence.items);
+            }
+
+            sequence.clearRetainingCapacity();
+
+            address = 0;
+            file = 1;
+            line = 1;
+            column = 0;
+        }
+    }
+}
+
+const FileEntry = struct {
+    path: []const u8,
+    directory_index: u64,
+};
+
+/// Reads the DWARF 5 directory or file name entries, whichever of `directories` and `files` is not null.
+fn readEntries(
+    elf: Elf,
+    reader: *Reader,
+    is_64: bool,
+    directories: ?*std.ArrayList([]const u8),
+    files: ?*std.ArrayList(FileEntry),
+) !void {
+    const Format = struct { content_type: u64, form: u64 };
+
+    var formats: [8]Format = undefined;
+    const number_of_formats = try reader.readInt(u8);
+    if (number_of_formats > formats.len) return error.UnsupportedDebugInfo;
+
+    for (formats[0..number_of_formats]) |*entry_format| {
+        entry_format.* = .{ .content_type = try reader.readUleb(), .form = try reader.readUleb() };
+    }
+
+    const number_of_entries = try reader.readUleb();
+    for (0..number_of_entries) |_| {
+        var entry: FileEntry = .{ .path = "", .directory_index = 0 };
+
+        for (formats[0..number_of_formats]) |entry_format| {
+            const value = try readForm(elf, reader, is_64, entry_format.form);
+
+            switch (entry_format.content_type) {
+                // DW_LNCT_path
+                1 => entry.path = switch (value) {
+                    .string => |string| string,
+                    else => return error.InvalidDebugInfo,
+                },
+                // DW_LNCT_directory_index
+                2 => entry.directory_index = switch (value) {
+                    .number => |number| number,
+                    else => return error.InvalidDebugInfo,
+                },
+                else => {},
+            }
+        }
+
+        if (directories) |list| try list.append(entry.path);
+        if (files) |list| try list.append(entry);
+    }
+}
+
+const FormValue = union(enum) {
+    string: []const u8,
+    number: u64,
+    other,
+};
+
+fn readForm(elf: Elf, reader: *Reader, is_64: bool, form: u64) !FormValue {
+    return switch (form) {
+        // DW_FORM_string
+        0x08 => .{ .string = try reader.readString() },
+        // DW_FORM_strp
+        0x0e => .{ .string = try elf.string(".debug_str", try reader.readOffset(is_64)) },
+        // DW_FORM_line_strp
+        0x1f => .{ .string = try elf.string(".debug_line_str", try reader.readOffset(is_64)) },
+        // DW_FORM_data1
+        0x0b => .{ .number = try reader.readInt(u8) },
+        // DW_FORM_data2
+        0x05 => .{ .number = try reader.readInt(u16) },
+        // DW_FORM_data4
+        0x06 => .{ .number = try reader.readInt(u32) },
+        // DW_FORM_data8
+        0x07 => .{ .number = try reader.readInt(u64) },
+        // DW_FORM_udata
+        0x0f => .{ .number = try reader.readUleb() },
+        // DW_FORM_data16, used for MD5 checksums
+        0x1e => blk: {
+            _ = try reader.readBytes(16);
+            break :blk .other;
+        },
+        // DW_FORM_block
+        0x09 => blk: {
+            _ = try reader.readBytes(try reader.readUleb());
+            break :blk .other;
+        },
+        else => error.UnsupportedDebugInfo,
+    };
+}
+
+fn resolvePath(
+    allocator: std.mem.Allocator,
+    directories: []const []const u8,
+    file: FileEntry,
+    root_path: []const u8,
+) ![]const u8 {
+    const path = if (std.fs.path.isAbsolute(file.path) or file.directory_index >= directories.len)
+        file.path
+    else
+        try std.fs.path.join(allocator, &.{ directories[file.directory_index], file.path });
+
+    // things like `memset` and `memcopy` won't be under the root path
+    if (std.mem.startsWith(u8, path, root_path)) return path[root_path.len..];
+
+    return path;
+}
+
+/// The DWARF register numbers of the registers the unwind entries are expressed in.
+const UnwindRegisters = struct {
+    stack_pointer: u64,
+    frame_pointer: u64,
+
+    fn of(target: CascadeTarget) UnwindRegisters {
+        return switch (target) {
+            .aarch64 => .{ .stack_pointer = 31, .frame_pointer = 29 },
+            .x86_64 => .{ .stack_pointer = 7, .frame_pointer = 6 },
+        };
+    }
+};
+
+const CallFrameSection = struct {
+    bytes: []const u8,
+
+    /// The address of the section, `.eh_frame` pointers can be relative to it.
+    address: u64,
+
+    kind: enum { debug_frame, eh_frame },
+};
+
+const CommonInformationEntry = struct {
+    code_alignment_factor: u64,
+    data_alignment_factor: i64,
+    return_address_register: u64,
+
+    /// The encoding of the addresses in the frame description entries, `.debug_frame` always uses absolute addresses.
+    pointer_encoding: u8,
+
+    /// Set if frame description entries have augmentation data, which is skipped.
+    has_augmentation_data: bool,
+
+    initial_instructions: []const u8,
+};
+
+const RegisterRule = union(enum) {
+    /// The register holds the value of the caller, or the value is undefined.
+    unchanged,
+
+    /// The value of the caller is saved at this offset from the canonical frame address.
+    at_cfa_offset: i64,
+
+    /// A rule that cannot be represented in an unwind entry.
+    unsupported,
+};
+
+/// The rules of a row of the call frame information table, only for the registers the kernel unwinds.
+const RowState = struct {
+    cfa_register: u64 = 0,
+    cfa_offset: i64 = 0,
+
+    /// Set if the canonical frame address is defined by a DWARF expression.
+    cfa_is_expression: bool = false,
+
+    return_address: RegisterRule = .unchanged,
+    frame_pointer: RegisterRule = .unchanged,
+
+    fn toEntry(self: RowState, address: u64, registers: UnwindRegisters) format.UnwindEntry {
+        const none = noUnwindEntry(address);
+
+        if (self.cfa_is_expression) return none;
+
+        const cfa_register: format.UnwindEntry.CfaRegister = if (self.cfa_register == registers.stack_pointer)
+            .stack_pointer
+        else if (self.cfa_register == registers.frame_pointer)
+            .frame_pointer
+        else
+            return none;
+
+        return .{
+            .address = address,
+            .cfa_offset = std.math.cast(i32, self.cfa_offset) orelse return none,
+            .return_address_offset = ruleToOffset(self.return_address) orelse return none,
+            .frame_pointer_offset = ruleToOffset(self.frame_pointer) orelse return none,
+            .cfa_register = cfa_register,
+        };
+    }
+
+    fn ruleToOffset(rule: RegisterRule) ?i16 {
+        return switch (rule) {
+            .unchanged => 0,
+            .at_cfa_offset => |offset| if (offset == 0) null else std.math.cast(i16, offset),
+            .unsupported => null,
+        };
+    }
+
+    fn setRule(
+        self: *RowState,
+        cie: CommonInformationEntry,
+        registers: UnwindRegisters,
+        register: u64,
+        rule: RegisterRule,
+    ) void {
+        if (register == cie.return_address_register) {
+            self.return_address = rule;
+        } else if (register == registers.frame_pointer) {
+            self.frame_pointer = rule;
+        }
+    }
+
+    /// Sets the rule of `register` back to its rule after the initial instructions of the CIE.
+    fn restoreRule(
+        self: *RowState,
+        initial_state: RowState,
+        cie: CommonInformationEntry,
+        registers: UnwindRegisters,
+        register: u64,
+    ) void {
+        if (register == cie.return_address_register) {
+            self.return_address = initial_state.return_address;
+        } else if (register == registers.frame_pointer) {
+            self.frame_pointer = initial_state.frame_pointer;
+        }
+    }
+};
+
+/// An entry for addresses that cannot be unwound.
+fn noUnwindEntry(address: u64) format.UnwindEntry {
+    return .{
+        .address = address,
+        .cfa_offset = 0,
+        .return_address_offset = 0,
+        .frame_pointer_offset = 0,
+        .cfa_register = .none,
+    };
+}
+
+const UnwindRow = struct {
+    entry: format.UnwindEntry,
+
+    /// Set for the row at the end of a frame description entry.
+    is_end: bool,
+};
+
+/// Collects the unwind entry of every address covered by call frame information, sorted by address.
+///
+/// Returns no entries if the kernel has no call frame information, the kernel then falls back to frame pointers.
+fn collectUnwindEntries(
+    allocator: std.mem.Allocator,
+    elf: Elf,
+    registers: UnwindRegisters,
+) ![]const format.UnwindEntry {
+    const section: CallFrameSection = if (elf.sectionHeader(".debug_frame")) |section_header| .{
+        .bytes = elf.bytes[section_header.sh_offset..][0..section_header.sh_size],
+        .address = section_header.sh_addr,
+        .kind = .debug_frame,
+    } else if (elf.sectionHeader(".eh_frame")) |section_header| .{
+        .bytes = elf.bytes[section_header.sh_offset..][0..section_header.sh_size],
+        .address = section_header.sh_addr,
+        .kind = .eh_frame,
+    } else return &.{};
+
+    var common_information_entries = std.AutoHashMap(u64, CommonInformationEntry).init(allocator);
+    var rows = std.ArrayList(UnwindRow).init(allocator);
+
+    var reader: Reader = .{ .bytes = section.bytes };
+    while (reader.position < section.bytes.len) {
+        var is_64 = false;
+        var length: u64 = try reader.readInt(u32);
+        if (length == 0) {
+            // terminates `.eh_frame`
+            if (section.kind == .eh_frame) break;
+            continue;
+        }
+        if (length == 0xFFFF_FFFF) {
+            is_64 = true;
+            length = try reader.readInt(u64);
+        }
+
+        const entry_end = reader.position + length;
+        if (entry_end > section.bytes.len) return error.InvalidCallFrameInformation;
+        defer reader.position = entry_end;
+
+        const id_position = reader.position;
+        const id = try reader.readOffset(is_64);
+
+        const cie_position = switch (section.kind) {
+            .debug_frame => cie_position: {
+                const cie_id: u64 = if (is_64) std.math.maxInt(u64) else std.math.maxInt(u32);
+                if (id == cie_id) continue;
+                break :cie_position id;
+            },
+            // the offset is back from the id field itself
+            .eh_frame => if (id == 0) continue else id_position - id,
+        };
+
+        const cie = common_information_entries.get(cie_position) orelse cie: {
+            const cie = try parseCommonInformationEntry(section, cie_position);
+            try common_information_entries.put(cie_position, cie);
+            break :cie cie;
+        };
+
+        const initial_location = try readEncodedPointer(&reader, cie.pointer_encoding, section.address);
+        // the range is never relative to anything
+        const address_range = try readEncodedPointer(&reader, cie.pointer_encoding & 0x0F, section.address);
+
+        if (cie.has_augmentation_data) _ = try reader.readBytes(try reader.readUleb());
+
+        // functions removed by the linker are left in the call frame information at address zero
+        if (!elf.isExecutableAddress(initial_location)) continue;
+
+        var initial_state: RowState = .{};
+        var location = initial_location;
+        try runCallFrameInstructions(
+            allocator,
+            cie.initial_instructions,
+            section,
+            cie,
+            registers,
+            .{},
+            &initial_state,
+            &location,
+            null,
+        );
+
+        var state = initial_state;
+        try runCallFrameInstructions(
+            allocator,
+            section.bytes[reader.position..entry_end],
+            section,
+            cie,
+            registers,
+            initial_state,
+            &state,
+            &location,
+            &rows,
+        );
+
+        const end = initial_location + address_range;
+        if (location < end) try rows.append(.{ .entry = state.toEntry(location, registers), .is_end = false });
+        try rows.append(.{ .entry = noUnwindEntry(end), .is_end = true });
+    }
+
+    // at an address where one function ends and another starts the start must win, so it is sorted last, the sort is
+    // stable so otherwise the last row at an address wins
+    std.sort.block(UnwindRow, rows.items, {}, struct {
+        fn lessThan(_: void, lhs: UnwindRow, rhs: UnwindRow) bool {
+            if (lhs.entry.address != rhs.entry.address) return lhs.entry.address < rhs.entry.address;
+            return lhs.is_end and !rhs.is_end;
+        }
+    }.lessThan);
+
+    var entries = std.ArrayList(format.UnwindEntry).init(allocator);
+
+    for (rows.items, 0..) |row, i| {
+        // only the last row at an address is ever found
+        if (i + 1 < rows.items.len and rows.items[i + 1].entry.address == row.entry.address) continue;
+
+        // rows that do not change the rules add nothing
+        if (entries.items.len != 0) {
+            const previous = entries.items[entries.items.len - 1];
+            if (previous.cfa_register == row.entry.cfa_register and
+                previous.cfa_offset == row.entry.cfa_offset and
+                previous.return_address_offset == row.entry.return_address_offset and
+                previous.frame_pointer_offset == row.entry.frame_pointer_offset) continue;
+        }
+
+        try entries.append(row.entry);
+    }
+
+    return entries.toOwnedSlice();
+}
+
+/// Parses the common information entry at `position` in `section`.
+///
+/// Supports versions 1, 3 and 4 and the `z`, `R`, `P`, `L` and `S` augmentations of `.eh_frame`.
+fn parseCommonInformationEntry(section: CallFrameSection, position: u64) !CommonInformationEntry {
+    var reader: Reader = .{ .bytes = section.bytes, .position = position };
+
+    var is_64 = false;
+    var length: u64 = try reader.readInt(u32);
+    if (length == 0xFFFF_FFFF) {
+        is_64 = true;
+        length = try reader.readInt(u64);
+    }
+
+    const entry_end = reader.position + length;
+    if (entry_end > section.bytes.len) return error.InvalidCallFrameInformation;
+
+    _ = try reader.readOffset(is_64); // id
+
+    const version = try reader.readInt(u8);
+    if (version != 1 and version != 3 and version != 4) return error.UnsupportedCallFrameInformation;
+
+    const augmentation = try reader.readString();
+
+    if (version >= 4) {
+        if (try reader.readInt(u8) != 8) return error.UnsupportedCallFrameInformation; // address_size
+        _ = try reader.readInt(u8); // segment_selector_size
+    }
+
+    var cie: CommonInformationEntry = .{
+        .code_alignment_factor = try reader.readUleb(),
+        .data_alignment_factor = try reader.readSleb(),
+        .return_address_register = if (version == 1) try reader.readInt(u8) else try reader.readUleb(),
+        .pointer_encoding = pointer_encoding_absolute,
+        .has_augmentation_data = false,
+        .initial_instructions = &.{},
+    };
+
+    if (augmentation.len != 0) {
+        if (augmentation[0] != 'z') return error.UnsupportedCallFrameInformation;
+        cie.has_augmentation_data = true;
+
+        const augmentation_length = try reader.readUleb();
+        const augmentation_end = reader.position + augmentation_length;
+
+        for (augmentation[1..]) |character| switch (character) {
+            'R' => cie.pointer_encoding = try reader.readInt(u8),
+            // the personality routine
+            'P' => _ = try readEncodedPointer(&reader, try reader.readInt(u8), section.address),
+            // the encoding of the language specific data area pointer
+            'L' => _ = try reader.readInt(u8),
+            // signal frames unwind the same way
+            'S' => {},
+            else => break,
+        };
+
+        reader.position = augmentation_end;
+    }
+
+    cie.initial_instructions = section.bytes[reader.position..entry_end];
+
+    return cie;
+}
+
+/// Runs the call frame instructions in `instructions`, updating `state` and `location`.
+///
+/// If `rows` is not null a row is appended for every range of addresses the instructions advance over.
+fn runCallFrameInstructions(
+    allocator: std.mem.Allocator,
+    instructions: []const u8,
+    section: CallFrameSection,
+    cie: CommonInformationEntry,
+    registers: UnwindRegisters,
+    initial_state: RowState,
+    state: *RowState,
+    location: *u64,
+    rows: ?*std.ArrayList(UnwindRow),
+) !void {
+    var reader: Reader = .{ .bytes = instructions };
+    var remembered_states = std.ArrayList(RowState).init(allocator);
+
+    while (reader.position < instructions.len) {
+        const opcode = try reader.readInt(u8);
+        const operand: u64 = opcode & 0x3F;
+
+        var new_location: ?u64 = null;
+
+        switch (opcode >> 6) {
+            // DW_CFA_advance_loc
+            1 => new_location = location.* + operand * cie.code_alignment_factor,
+            // DW_CFA_offset
+            2 => state.setRule(cie, registers, operand, .{
+                .at_cfa_offset = @as(i64, @intCast(try reader.readUleb())) * cie.data_alignment_factor,
+            }),
+            // DW_CFA_restore
+            3 => state.restoreRule(initial_state, cie, registers, operand),
+            else => switch (opcode) {
+                // DW_CFA_nop
+                0x00 => {},
+                // DW_CFA_set_loc
+                0x01 => new_location = try readEncodedPointer(&reader, cie.pointer_encoding, section.address),
+                // DW_CFA_advance_loc1
+                0x02 => new_location = location.* + try reader.readInt(u8) * cie.code_alignment_factor,
+                // DW_CFA_advance_loc2
+                0x03 => new_location = location.* + try reader.readInt(u16) * cie.code_alignment_factor,
+                // DW_CFA_advance_loc4
+                0x04 => new_location = location.* + try reader.readInt(u32) * cie.code_alignment_factor,
+                // DW_CFA_offset_extended
+                0x05 => {
+                    const register = try reader.readUleb();
+                    state.setRule(cie, registers, register, .{
+                        .at_cfa_offset = @as(i64, @intCast(try reader.readUleb())) * cie.data_alignment_factor,
+                    });
+                },
+                // DW_CFA_restore_extended
+                0x06 => state.restoreRule(initial_state, cie, registers, try reader.readUleb()),
+                // DW_CFA_undefined, DW_CFA_same_value
+                0x07, 0x08 => state.setRule(cie, registers, try reader.readUleb(), .unchanged),
+                // DW_CFA_register
+                0x09 => {
+                    const register = try reader.readUleb();
+                    _ = try reader.readUleb();
+                    state.setRule(cie, registers, register, .unsupported);
+                },
+                // DW_CFA_remember_state
+                0x0A => try remembered_states.append(state.*),
+                // DW_CFA_restore_state
+                0x0B => state.* = remembered_states.popOrNull() orelse return error.InvalidCallFrameInformation,
+                // DW_CFA_def_cfa
+                0x0C => {
+                    state.cfa_register = try reader.readUleb();
+                    state.cfa_offset = @intCast(try reader.readUleb());
+                    state.cfa_is_expression = false;
+                },
+                // DW_CFA_def_cfa_register
+                0x0D => {
+                    state.cfa_register = try reader.readUleb();
+                    state.cfa_is_expression = false;
+                },
+                // DW_CFA_def_cfa_offset
+                0x0E => state.cfa_offset = @intCast(try reader.readUleb()),
+                // DW_CFA_def_cfa_expression
+                0x0F => {
+                    _ = try reader.readBytes(try reader.readUleb());
+                    state.cfa_is_expression = true;
+                },
+                // DW_CFA_expression, DW_CFA_val_expression
+                0x10, 0x16 => {
+                    const register = try reader.readUleb();
+                    _ = try reader.readBytes(try reader.readUleb());
+                    state.setRule(cie, registers, register, .unsupported);
+                },
+                // DW_CFA_offset_extended_sf
+                0x11 => {
+                    const register = try reader.readUleb();
+                    state.setRule(cie, registers, register, .{
+                        .at_cfa_offset = try reader.readSleb() * cie.data_alignment_factor,
+                    });
+                },
+                // DW_CFA_def_cfa_sf
+                0x12 => {
+                    state.cfa_register = try reader.readUleb();
+                    state.cfa_offset = try reader.readSleb() * cie.data_alignment_factor;
+                    state.cfa_is_expression = false;
+                },
+                // DW_CFA_def_cfa_offset_sf
+                0x13 => state.cfa_offset = try reader.readSleb() * cie.data_alignment_factor,
+                // DW_CFA_val_offset, DW_CFA_val_offset_sf
+                0x14, 0x15 => {
+                    const register = try reader.readUleb();
+                    _ = try reader.readUleb();
+                    state.setRule(cie, registers, register, .unsupported);
+                },
+                // DW_CFA_AARCH64_negate_ra_state, pointer authentication is not used by the kernel
+                0x2D => {},
+                // DW_CFA_GNU_args_size
+                0x2E => _ = try reader.readUleb(),
+                // DW_CFA_GNU_negative_offset_extended
+                0x2F => {
+                    const register = try reader.readUleb();
+                    state.setRule(cie, registers, register, .{
+                        .at_cfa_offset = -@as(i64, @intCast(try reader.readUleb())) * cie.data_alignment_factor,
+                    });
+                },
+                else => return error.UnsupportedCallFrameInformation,
+            },
+        }
+
+        if (new_location) |address| {
+            if (rows) |list| try list.append(.{ .entry = state.toEntry(location.*, registers), .is_end = false });
+            location.* = address;
+        }
+    }
+}
+
+const pointer_encoding_absolute = 0x00;
+const pointer_encoding_omit = 0xFF;
+
+/// Reads a pointer in the `.eh_frame` encoding `encoding`.
+///
+/// Only absolute and program counter relative pointers are supported, the kernel has no data or text relative ones.
+fn readEncodedPointer(reader: *Reader, encoding: u8, section_address: u64) !u64 {
+    if (encoding == pointer_encoding_omit) return 0;
+
+    const field_address = section_address + reader.position;
+
+    const value: u64 = switch (encoding & 0x0F) {
+        // DW_EH_PE_absptr
+        0x00 => try reader.readInt(u64),
+        // DW_EH_PE_uleb128
+        0x01 => try reader.readUleb(),
+        // DW_EH_PE_udata2
+        0x02 => try reader.readInt(u16),
+        // DW_EH_PE_udata4
+        0x03 => try reader.readInt(u32),
+        // DW_EH_PE_udata8
+        0x04 => try reader.readInt(u64),
+        // DW_EH_PE_sleb128
+        0x09 => @bitCast(try reader.readSleb()),
+        // DW_EH_PE_sdata2
+        0x0A => @bitCast(@as(i64, try reader.readInt(i16))),
+        // DW_EH_PE_sdata4
+        0x0B => @bitCast(@as(i64, try reader.readInt(i32))),
+        // DW_EH_PE_sdata8
+        0x0C => try reader.readInt(u64),
+        else => return error.UnsupportedCallFrameInformation,
+    };
+
+    return switch (encoding & 0xF0) {
+        // DW_EH_PE_absptr
+        0x00 => value,
+        // DW_EH_PE_pcrel
+        0x10 => field_address +% value,
+        else => error.UnsupportedCallFrameInformation,
+    };
+}
+
+const Reader = struct {
+    bytes: []const u8,
+    position: usize = 0,
+
+    fn readInt(self: *Reader, comptime T: type) !T {
+        const bytes = try self.readBytes(@sizeOf(T));
+        return std.mem.readIntLittle(T, bytes[0..@sizeOf(T)]);
+    }
+
+    fn readOffset(self: *Reader, is_64: bool) !u64 {
+        return if (is_64) try self.readInt(u64) else try self.readInt(u32);
+    }
+
+    fn readBytes(self: *Reader, length: u64) ![]const u8 {
+        if (length > self.bytes.len - self.position) return error.EndOfStream;
+        const bytes = self.bytes[self.position..][0..length];
+        self.position += length;
+        return bytes;
+    }
+
+    fn readString(self: *Reader) ![]const u8 {
+        const length = std.mem.indexOfScalarPos(u8, self.bytes, self.position, 0) orelse return error.EndOfStream;
+        const string = self.bytes[self.position..length];
+        self.position = length + 1;
+        return string;
+    }
+
+    fn readUleb(self: *Reader) !u64 {
+        var result: u64 = 0;
+        var shift: usize = 0;
+
+        while (true) {
+            const byte = try self.readInt(u8);
+            if (shift < 64) result |= @as(u64, byte & 0x7F) << @intCast(shift);
+            shift += 7;
+            if (byte & 0x80 == 0) return result;
+        }
+    }
+
+    fn readSleb(self: *Reader) !i64 {
+        var result: u64 = 0;
+        var shift: usize = 0;
+
+        while (true) {
+            const byte = try self.readInt(u8);
+            if (shift < 64) result |= @as(u64, byte & 0x7F) << @intCast(shift);
+            shift += 7;
+
+            if (byte & 0x80 == 0) {
+                // sign extend from the last byte read
+                if (shift < 64 and byte & 0x40 != 0) result |= ~@as(u64, 0) << @intCast(shift);
+                return @bitCast(result);
+            }
+        }
+    }
+};
+
+const Elf = struct {
+    bytes: []const u8,
+    section_headers: []const std.elf.Elf64_Shdr,
+    section_names: []const u8,
+
+    fn init(allocator: std.mem.Allocator, bytes: []const u8) !Elf {
+        if (bytes.len < @sizeOf(std.elf.Elf64_Ehdr)) return error.InvalidElf;
+
+        const header = std.mem.bytesToValue(std.elf.Elf64_Ehdr, bytes[0..@sizeOf(std.elf.Elf64_Ehdr)]);
+        if (!std.mem.eql(u8, header.e_ident[0..4], std.elf.MAGIC)) return error.InvalidElf;
+        if (header.e_ident[std.elf.EI_CLASS] != std.elf.ELFCLASS64) return error.InvalidElf;
+
+        const section_headers = try allocator.alloc(std.elf.Elf64_Shdr, header.e_shnum);
+        for (section_headers, 0..) |*section_header, i| {
+            const offset = header.e_shoff + i * @as(u64, header.e_shentsize);
+            if (offset + @sizeOf(std.elf.Elf64_Shdr) > bytes.len) return error.InvalidElf;
+            section_header.* = std.mem.bytesToValue(
+                std.elf.Elf64_Shdr,
+                bytes[offset..][0..@sizeOf(std.elf.Elf64_Shdr)],
+            );
+        }
+
+        if (header.e_shstrndx >= section_headers.len) return error.InvalidElf;
+        const names_header = section_headers[header.e_shstrndx];
+
+        return .{
+            .bytes = bytes,
+            .section_headers = section_headers,
+            .section_names = bytes[names_header.sh_offset..][0..names_header.sh_size],
+        };
+    }
+
+    fn section(self: Elf, name: []const u8) ?[]const u8 {
+        const section_header = self.sectionHeader(name) orelse return null;
+        return self.bytes[section_header.sh_offset..][0..section_header.sh_size];
+    }
+
+    fn sectionHeader(self: Elf, name: []const u8) ?std.elf.Elf64_Shdr {
+        for (self.section_headers) |section_header| {
+            if (section_header.sh_type == std.elf.SHT_NULL or section_header.sh_type == std.elf.SHT_NOBITS) continue;
+
+            const section_name = std.mem.sliceTo(self.section_names[section_header.sh_name..], 0);
+            if (std.mem.eql(u8, section_name, name)) return section_header;
+        }
+        return null;
+    }
+
+    /// Returns the null terminated string at `offset` in the section `section_name`.
+    fn string(self: Elf, section_name: []const u8, offset: u64) ![]const u8 {
+        const strings = self.section(section_name) orelse return error.MissingDebugInfo;
+        if (offset >= strings.len) return error.InvalidDebugInfo;
+        return std.mem.sliceTo(strings[offset..], 0);
+    }
+
+    fn isExecutableAddress(self: Elf, address: u64) bool {
+        for (self.section_headers) |section_header| {
+            if (section_header.sh_flags & std.elf.SHF_EXECINSTR == 0) continue;
+            if (address >= section_header.sh_addr and address - section_header.sh_addr < section_header.sh_size) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/// Deduplicated strings, referenced by offset and length.
+const StringPool = struct {
+    bytes: std.ArrayList(u8),
+    references: std.StringHashMap(format.StringReference),
+
+    fn init(allocator: std.mem.Allocator) StringPool {
+        return .{
+            .bytes = std.ArrayList(u8).init(allocator),
+            .references = std.StringHashMap(format.StringReference).init(allocator),
+        };
+    }
+
+    fn add(self: *StringPool, string: []const u8) !format.StringReference {
+        const result = try self.references.getOrPut(string);
+        if (result.found_existing) return result.value_ptr.*;
+
+        result.value_ptr.* = .{
+            .offset = @intCast(self.bytes.items.len),
+            .length = @intCast(string.len),
+        };
+        try self.bytes.appendSlice(string);
+
+        return result.value_ptr.*;
+    }
+};
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const Step = std.Build.Step;
+
+const Options = @import("Options.zig");
+
+/// A tool that runs on the host, built from `tools/<name>/<name>.zig`.
+const ToolDescription = struct {
+    name: []const u8,
+
+    /// Files from elsewhere in the tree the tool imports, such as formats shared with the kernel.
+    shared_modules: []const SharedModule = &.{},
+
+    const SharedModule = struct {
+        name: []const u8,
+        path: []const u8,
+    };
+};
+
+const tools = [_]ToolDescription{
+    .{
+        .name = "trace_to_chrome",
+        .shared_modules = &.{
+            .{ .name = "trace_event_format", .path = "kernel/trace/event_format.zig" },
+        },
+    },
+};
+
+/// Registers the build and run steps of every tool.
+pub fn registerTools(b: *std.Build, options: Options) !void {
+    const all_tools_step = b.step(
+        "tools",
+        "Build all the host tools",
+    );
+
+    for (tools) |tool| {
+        const exe = b.addExecutable(.{
+            .name = tool.name,
+            .root_source_file = .{ .path = b.pathJoin(&.{ "tools", tool.name, b.fmt("{s}.zig", .{tool.name}) }) },
+            .target = .{},
+            .optimize = options.optimize,
+        });
+
+        for (tool.shared_modules) |shared_module| {
+            exe.addModule(shared_module.name, b.createModule(.{
+                .source_file = .{ .path = shared_module.path },
+            }));
+        }
+
+        const install_step = b.addInstallArtifact(exe);
+
+        const build_step = b.step(
+            b.fmt("tool_{s}", .{tool.name}),
+            b.fmt("Build the {s} tool", .{tool.name}),
+        );
+        build_step.dependOn(&install_step.step);
+        all_tools_step.dependOn(build_step);
+
+        const run = b.addRunArtifact(exe);
+        if (b.args) |args| run.addArgs(args);
+
+        const run_step = b.step(
+            b.fmt("run_{s}", .{tool.name}),
+            b.fmt("Run the {s} tool, arguments are passed after `--`", .{tool.name}),
+        );
+        run_step.dependOn(&run.step);
+    }
+}
@@ -10,6 +10,7 @@ const Library = @import(".build/Library.zig");
 const Options = @import(".build/Options.zig");
 const QemuStep = @import(".build/QemuStep.zig");
 const StepCollection = @import(".build/StepCollection.zig");
+const Tool = @import(".build/Tool.zig");
 
 const cascade_version = std.SemanticVersion{ .major = 0, .minor = 0, .patch = 1 };
 const all_targets: []const CascadeTarget = std.meta.tags(CascadeTarget);
@@ -28,4 +29,6 @@ pub fn build(b: *std.Build) !void {
     const image_steps = try ImageStep.registerImageSteps(b, step_collection, all_targets);
 
     try QemuStep.registerQemuSteps(b, image_steps, options, all_targets);
+
+    try Tool.registerTools(b, options);
 }
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = @This();
+
+const log = kernel.log.scoped(.processor);
+
+/// The maximum number of processors the kernel supports.
+///
+/// Limited to 64 to allow sets of processors to be represented as a `u64` bitmask.
+pub const maximum_number_of_processors = 64;
+
+/// Pointer to this processor.
+///
+/// Used by the architecture to retrieve the current processor with a single load.
+self_pointer: *Processor,
+
+id: Id,
+
+/// The number of nested preemption disables, preemption is only possible when this is zero.
+///
+/// Only ever modified by this processor.
+preemption_disable_count: u32 = 0,
+
+/// Cross-processor calls queued for this processor.
+cross_call: kernel.cross_call.ProcessorState = .{},
+
+/// Deferred interrupt work queued on this processor.
+deferred: kernel.deferred.ProcessorState = .{},
+
+/// Messages logged on this processor waiting to be written out.
+log_buffer: kernel.log.ProcessorState = .{},
+
+/// Whether the hardware performance counters of this processor are counting.
+performance_counters: kernel.performance_counters.ProcessorState = .{},
+
+/// Profiling samples taken on this processor.
+profiler: kernel.profiler.ProcessorState = .{},
+
+/// Read-copy-update state for this processor.
+rcu: kernel.rcu.ProcessorState = .{},
+
+/// Scheduler state for this processor.
+scheduler: kernel.scheduler.ProcessorState = .{},
+
+/// Timers armed on this processor.
+timers: kernel.timer.ProcessorState = .{},
+
+/// Tracepoint events recorded on this processor.
+trace: kernel.trace.ProcessorState = .{},
+
+/// The page table this processor is using, null until it switches to one set up by the kernel.
+///
+/// Used to only flush the TLBs of processors that may be caching translations from a page table.
+page_table: ?*const kernel.arch.paging.PageTable = null,
+
+/// The position of this processor in the cache and package hierarchy.
+topology: Topology = .{},
+
+arch: kernel.arch.ArchProcessor,
+
+pub const Id = enum(u32) {
+    bootstrap = 0,
+
+    _,
+
+    /// Returns a bitmask with only the bit for this processor set.
+    pub inline fn mask(self: Id) u64 {
+        return @as(u64, 1) << @as(u6, @intCast(@intFromEnum(self)));
+    }
+};
+
+pub const Topology = struct {
+    /// Processors with the same `core` are hardware threads of the same physical core.
+    core: u32 = 0,
+
+    /// Processors with the same `cache_domain` share a last level cache.
+    cache_domain: u32 = 0,
+
+    /// Processors with the same `package` are in the same physical package.
+    package: u32 = 0,
+};
+
+var processors: [maximum_number_of_processors]Processor = undefined;
+
+/// The number of processors that have completed their initialization.
+var number_of_online_processors: usize = 1;
+
+/// All processors in the system.
+///
+/// Initialized during `setup`.
+pub var all: []Processor = processors[0..0];
+
+/// Returns the processor with the given id.
+pub inline fn get(id: Id) *Processor {
+    return &all[@intFromEnum(id)];
+}
+
+/// Returns the current processor.
+///
+/// The caller must ensure preemption is disabled for the returned processor to remain the current processor.
+pub inline fn current() *Processor {
+    return kernel.arch.getProcessor();
+}
+
+/// Returns a bitmask with the bit for every processor in the system set.
+pub fn allProcessorsMask() u64 {
+    if (all.len == maximum_number_of_processors) return std.math.maxInt(u64);
+    return (@as(u64, 1) << @as(u6, @intCast(all.len))) - 1;
+}
+
+/// Disables preemption on the current processor.
+///
+/// Calls nest, preemption is only re-enabled once every call has been matched by a call to `enablePreemption`.
+pub inline fn disablePreemption() void {
+    kernel.arch.incrementPreemptionDisableCount();
+}
+
+/// Re-enables preemption on the current processor.
+///
+/// If this was the outermost call and preemption was requested in the meantime the current task is preempted.
+pub inline fn enablePreemption() void {
+    kernel.arch.decrementPreemptionDisableCount();
+
+    const processor = current();
+    if (@atomicLoad(bool, &processor.scheduler.preemption_requested, .Monotonic)) {
+        kernel.scheduler.preemptIfRequested();
+    }
+}
+
+/// Initializes the bootstrap processor and makes it the current processor.
+///
+/// Only called once during `setup`.
+pub fn initializeBootstrapProcessor() void {
+    all = processors[0..1];
+
+    const bootstrap_processor = get(.bootstrap);
+    bootstrap_processor.* = .{
+        .self_pointer = bootstrap_processor,
+        .id = .bootstrap,
+        .arch = kernel.arch.setup.createBootstrapArchProcessor(),
+    };
+    kernel.scheduler.initializeProcessor(bootstrap_processor);
+
+    kernel.arch.setup.loadProcessor(bootstrap_processor);
+}
+
+/// Initializes and starts every non-bootstrap processor provided by the bootloader, returning once they are all
+/// online.
+///
+/// Each processor runs `entry` on a small stack provided by the bootloader, which becomes its idle task.
+///
+/// Only called once during `setup`, after virtual memory is initialized.
+pub fn initializeNonBootstrapProcessors(comptime entry: fn (processor: *Processor) noreturn) void {
+    const descriptors = kernel.boot.processorDescriptorIterator() orelse {
+        log.warn("bootloader did not provide any processors, only the bootstrap processor will be used", .{});
+        return;
+    };
+
+    if (descriptors.count() > maximum_number_of_processors) {
+        log.warn(
+            "only {} of {} processors will be used",
+            .{ maximum_number_of_processors, descriptors.count() },
+        );
+    }
+
+    var number_of_processors: usize = 1;
+
+    var initialize_iterator = descriptors;
+    while (initialize_iterator.next()) |descriptor| {
+        if (descriptor.isBootstrap()) continue;
+        if (number_of_processors == maximum_number_of_processors) break;
+
+        const processor = &processors[number_of_processors];
+        processor.* = .{
+            .self_pointer = processor,
+            .id = @enumFromInt(number_of_processors),
+            .arch = kernel.arch.setup.createArchProcessor() catch |err| {
+                core.panicFmt("failed to create processor {}: {s}", .{ number_of_processors, @errorName(err) });
+            },
+        };
+        kernel.scheduler.initializeProcessor(processor);
+
+        number_of_processors += 1;
+    }
+
+    // every processor is initialized before any are started so that `all` never changes once they are running
+    all = processors[0..number_of_processors];
+
+    var next_id: usize = 1;
+    var boot_iterator = descriptors;
+    while (boot_iterator.next()) |descriptor| {
+        if (descriptor.isBootstrap()) continue;
+        if (next_id == number_of_processors) break;
+
+        log.debug("starting processor {}", .{next_id});
+        descriptor.boot(&processors[next_id], entry);
+
+        next_id += 1;
+    }
+
+    while (@atomicLoad(usize, &number_of_online_processors, .Acquire) != all.len) {
+        kernel.arch.spinLoopHint();
+    }
+
+    log.debug("{} processors online", .{all.len});
+}
+
+/// Marks the current processor as having completed its initialization.
+pub fn markOnline() void {
+    _ = @atomicRmw(usize, &number_of_online_processors, .Add, 1, .AcqRel);
+}
+
+comptime {
+    if (maximum_number_of_processors > @bitSizeOf(u64)) {
+        @compileError("maximum_number_of_processors must fit in a u64 bitmask");
+    }
+}
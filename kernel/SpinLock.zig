@@ -6,6 +6,8 @@ const kernel = @import("kernel");
 
 const SpinLock = @This();
 
+const trace = kernel.trace.scoped(.spinlock);
+
 /// The ticket whose turn it is to acquire the lock.
 current_ticket: usize = 1,
 
@@ -47,8 +49,29 @@ pub fn grab(self: *SpinLock) Held {
     };
 }
 
+/// Grab lock without disabling interrupts if it is not held, returns null otherwise.
+pub fn tryGrab(self: *SpinLock) ?Held {
+    const ticket = @atomicLoad(usize, &self.current_ticket, .Acquire);
+
+    // the lock is free only while no ticket has been handed out beyond the current one
+    if (@cmpxchgStrong(usize, &self.next_available_ticket, ticket, ticket + 1, .AcqRel, .Monotonic) != null) {
+        return null;
+    }
+
+    return .{
+        .enable_interrupts_on_unlock = false,
+        .spinlock = self,
+    };
+}
+
 fn internalGrab(self: *SpinLock) void {
     const ticket = @atomicRmw(usize, &self.next_available_ticket, .Add, 1, .AcqRel);
+    if (@atomicLoad(usize, &self.current_ticket, .Acquire) == ticket) return;
+
+    // only contention is traced, an uncontended grab stays a single atomic and a load
+    trace.begin(.contended, .{@intFromPtr(self)});
+    defer trace.end(.contended, .{@intFromPtr(self)});
+
     while (true) {
         if (@atomicLoad(usize, &self.current_ticket, .Acquire) == ticket) {
             return;
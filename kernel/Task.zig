@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Task = @This();
+
+/// The maximum number of tasks that can exist at once, not including the per-processor idle tasks.
+pub const maximum_number_of_tasks = 1024;
+
+/// The size of the stack of each task.
+pub const stack_size = core.Size.from(16, .kib);
+
+id: Id,
+
+/// Protects `state` and `wake_pending`.
+lock: kernel.SpinLock = .{},
+
+state: State,
+
+/// Set when the task is woken while it is not blocked, causing its next `kernel.scheduler.block` to return
+/// immediately.
+wake_pending: bool = false,
+
+/// The saved stack pointer of this task while it is not running.
+stack_pointer: usize = 0,
+
+/// The stack of this task.
+///
+/// A destroyed task keeps its stack, which is reused by the next task created in the same slot.
+///
+/// The stack of an idle task is the stack provided by the bootloader, see `kernel.scheduler.setBootloaderStack`, and
+/// is empty until it is recorded.
+stack: kernel.VirtualRange,
+
+entry: Entry = undefined,
+argument: usize = 0,
+
+/// The processor this task last ran on.
+///
+/// Used to wake the task near the cache that most likely still holds its working set.
+last_processor: ?kernel.Processor.Id = null,
+
+/// If set, this task only ever runs on the given processor.
+pinned_processor: ?kernel.Processor.Id = null,
+
+/// Link used by the task lists of the scheduler, a task is on at most one list at a time.
+next: ?*Task = null,
+
+/// The performance counter events that occurred while this task was running.
+performance_counters: kernel.performance_counters.TaskState = .{},
+
+arch: kernel.arch.ArchTask = .{},
+
+pub const Entry = *const fn (argument: usize) void;
+
+pub const Id = enum(u32) {
+    /// The id shared by the idle tasks of every processor.
+    idle = std.math.maxInt(u32),
+
+    _,
+};
+
+pub const State = enum {
+    /// Waiting in a run queue.
+    runnable,
+
+    /// Executing on a processor.
+    running,
+
+    /// Still executing on a processor but will be blocked once it has been switched away from.
+    blocking,
+
+    /// Not runnable until woken.
+    blocked,
+
+    /// Exited, will be destroyed once it has been switched away from.
+    dead,
+};
+
+var tasks: [maximum_number_of_tasks]Task = undefined;
+
+/// Protects `free_tasks` and `number_of_allocated_tasks`.
+var tasks_lock: kernel.SpinLock = .{};
+
+/// Destroyed tasks, linked through `next`.
+var free_tasks: ?*Task = null;
+
+/// The number of entries in `tasks` that have been handed out at least once.
+var number_of_allocated_tasks: usize = 0;
+
+/// Creates a new task that will call `entry` with `argument`.
+///
+/// The task is created blocked, it does not run until it is passed to `kernel.scheduler.wake`.
+pub fn create(entry: Entry, argument: usize) !*Task {
+    const task = try acquireTask();
+
+    task.state = .blocked;
+    task.wake_pending = false;
+    task.entry = entry;
+    task.argument = argument;
+    task.last_processor = null;
+    task.pinned_processor = null;
+    task.next = null;
+    task.performance_counters = .{};
+    task.arch = .{};
+
+    kernel.arch.scheduling.prepareNewTask(task, kernel.scheduler.taskEntry);
+
+    return task;
+}
+
+/// Returns `task` to the pool of free tasks.
+///
+/// Called by the scheduler once `task` has exited and been switched away from.
+pub fn destroy(task: *Task) void {
+    std.debug.assert(task.state == .dead);
+
+    const held = tasks_lock.lock();
+    defer held.unlock();
+
+    task.next = free_tasks;
+    free_tasks = task;
+}
+
+fn acquireTask() !*Task {
+    if (popFreeTask()) |task| return task;
+
+    // the stack is allocated before a slot is claimed and outside of `tasks_lock` as mapping it can take a while, this
+    // only happens until the pool has grown to the number of tasks in use
+    const stack = try kernel.vmm.allocateKernelStack(stack_size);
+    errdefer kernel.vmm.freeKernelStack(stack);
+
+    const index = blk: {
+        const held = tasks_lock.lock();
+        defer held.unlock();
+
+        if (number_of_allocated_tasks == maximum_number_of_tasks) return error.TooManyTasks;
+
+        const index = number_of_allocated_tasks;
+        number_of_allocated_tasks += 1;
+        break :blk index;
+    };
+
+    const task = &tasks[index];
+    task.* = .{
+        .id = @enumFromInt(index),
+        .state = .dead,
+        .stack = stack,
+    };
+
+    return task;
+}
+
+fn popFreeTask() ?*Task {
+    const held = tasks_lock.lock();
+    defer held.unlock();
+
+    const task = free_tasks orelse return null;
+    free_tasks = task.next;
+    return task;
+}
@@ -12,6 +12,69 @@ pub inline fn spinLoopHint() void {
     asm volatile ("isb" ::: "memory");
 }
 
+/// Reads the virtual counter.
+pub inline fn readCycleCounter() u64 {
+    return asm volatile ("mrs %[ret], CNTVCT_EL0"
+        : [ret] "=r" (-> u64),
+    );
+}
+
+/// Captures the instruction, stack and frame pointers at the point of the call.
+pub inline fn captureUnwindRegisters() kernel.debug.StackIterator.Registers {
+    var instruction_pointer: usize = undefined;
+    var stack_pointer: usize = undefined;
+    var frame_pointer: usize = undefined;
+    asm volatile (
+        \\adr %[instruction_pointer], .
+        \\mov %[stack_pointer], sp
+        \\mov %[frame_pointer], x29
+        : [instruction_pointer] "=r" (instruction_pointer),
+          [stack_pointer] "=r" (stack_pointer),
+          [frame_pointer] "=r" (frame_pointer),
+    );
+    return .{
+        .instruction_pointer = instruction_pointer,
+        .stack_pointer = stack_pointer,
+        .frame_pointer = frame_pointer,
+    };
+}
+
+pub fn crc32c(bytes: []const u8) u32 {
+    return std.hash.crc.Crc32WithPoly(.Castagnoli).hash(bytes);
+}
+
+/// Exceptions run on the stack of the interrupted task, there are no separate interrupt stacks.
+pub fn interruptStackContaining(processor: *kernel.Processor, address: kernel.VirtualAddress) ?kernel.VirtualRange {
+    _ = processor;
+    _ = address;
+    return null;
+}
+
+/// aarch64 specific per-processor data.
+pub const ArchProcessor = struct {};
+
+/// aarch64 specific per-task data.
+pub const ArchTask = struct {};
+
+/// Get the current processor.
+pub inline fn getProcessor() *kernel.Processor {
+    return asm volatile ("mrs %[ret], TPIDR_EL1"
+        : [ret] "=r" (-> *kernel.Processor),
+    );
+}
+
+/// Increments the preemption disable count of the current processor.
+pub inline fn incrementPreemptionDisableCount() void {
+    // TODO: this is not safe against migration, but there is no preemption on aarch64 yet
+    getProcessor().preemption_disable_count += 1;
+}
+
+/// Decrements the preemption disable count of the current processor.
+pub inline fn decrementPreemptionDisableCount() void {
+    // TODO: this is not safe against migration, but there is no preemption on aarch64 yet
+    getProcessor().preemption_disable_count -= 1;
+}
+
 pub const interrupts = struct {
     /// Disable interrupts and put the CPU to sleep.
     pub fn disableInterruptsAndHalt() noreturn {
@@ -35,6 +98,129 @@ pub const interrupts = struct {
     pub inline fn interruptsEnabled() bool {
         return false; // TODO: Actually figure this out https://github.com/CascadeOS/CascadeOS/issues/46
     }
+
+    /// Enable interrupts and put the CPU to sleep until the next interrupt.
+    pub inline fn enableInterruptsAndHalt() void {
+        // `wfi` wakes on a pending interrupt even while it is masked, which is then taken once unmasked
+        asm volatile ("wfi");
+        enableInterrupts();
+    }
+
+    pub fn raiseNoOperationInterrupt() void {
+        core.panic("UNIMPLEMENTED `raiseNoOperationInterrupt`"); // TODO: Implement `raiseNoOperationInterrupt`
+    }
+
+    pub fn sendCrossCallInterrupt(processor: *kernel.Processor) void {
+        _ = processor;
+        core.panic("UNIMPLEMENTED `sendCrossCallInterrupt`"); // TODO: Implement `sendCrossCallInterrupt`
+    }
+
+    pub fn logStatistics() void {
+        core.panic("UNIMPLEMENTED `logStatistics`"); // TODO: Implement `logStatistics`
+    }
+};
+
+pub const memory = struct {
+    const Page = arch.memory.Page;
+    const page_alignment = arch.paging.standard_page_size.bytes;
+
+    pub fn zeroPage(page: *align(page_alignment) Page) void {
+        _ = page;
+        core.panic("UNIMPLEMENTED `zeroPage`"); // TODO: Implement `zeroPage`
+    }
+
+    pub fn zeroPageNonTemporal(page: *align(page_alignment) Page) void {
+        _ = page;
+        core.panic("UNIMPLEMENTED `zeroPageNonTemporal`"); // TODO: Implement `zeroPageNonTemporal`
+    }
+
+    pub fn copyPage(destination: *align(page_alignment) Page, source: *align(page_alignment) const Page) void {
+        _ = source;
+        _ = destination;
+        core.panic("UNIMPLEMENTED `copyPage`"); // TODO: Implement `copyPage`
+    }
+
+    pub fn copyPageNonTemporal(
+        destination: *align(page_alignment) Page,
+        source: *align(page_alignment) const Page,
+    ) void {
+        _ = source;
+        _ = destination;
+        core.panic("UNIMPLEMENTED `copyPageNonTemporal`"); // TODO: Implement `copyPageNonTemporal`
+    }
+};
+
+pub const timer = struct {
+    pub fn setDeadline(deadline: u64) void {
+        _ = deadline;
+        core.panic("UNIMPLEMENTED `setDeadline`"); // TODO: Implement `setDeadline`
+    }
+
+    pub fn cancel() void {
+        core.panic("UNIMPLEMENTED `cancel`"); // TODO: Implement `cancel`
+    }
+};
+
+pub const performance_counters = struct {
+    pub fn isEventSupported(event: kernel.performance_counters.Event) bool {
+        _ = event;
+        return false;
+    }
+
+    pub fn enable() void {
+        core.panic("UNIMPLEMENTED `enable`"); // TODO: Implement `enable`
+    }
+
+    pub fn read(event: kernel.performance_counters.Event) u64 {
+        _ = event;
+        core.panic("UNIMPLEMENTED `read`"); // TODO: Implement `read`
+    }
+};
+
+pub const profiling = struct {
+    pub fn isAvailable() bool {
+        return false;
+    }
+
+    pub fn start(period: u64) void {
+        _ = period;
+        core.panic("UNIMPLEMENTED `start`"); // TODO: Implement `start`
+    }
+
+    pub fn stop() void {
+        core.panic("UNIMPLEMENTED `stop`"); // TODO: Implement `stop`
+    }
+};
+
+pub const scheduling = struct {
+    pub fn switchToTask(current_task: *kernel.Task, new_task: *kernel.Task) void {
+        _ = new_task;
+        _ = current_task;
+        core.panic("UNIMPLEMENTED `switchToTask`"); // TODO: Implement `switchToTask`
+    }
+
+    pub fn prepareNewTask(task: *kernel.Task, entry: *const fn (task: *kernel.Task) callconv(.C) noreturn) void {
+        _ = entry;
+        _ = task;
+        core.panic("UNIMPLEMENTED `prepareNewTask`"); // TODO: Implement `prepareNewTask`
+    }
+
+    pub fn sendSchedulerInterrupt(processor: *kernel.Processor) void {
+        _ = processor;
+        core.panic("UNIMPLEMENTED `sendSchedulerInterrupt`"); // TODO: Implement `sendSchedulerInterrupt`
+    }
+};
+
+pub const syscall = struct {
+    pub fn isAvailable() bool {
+        return false;
+    }
+
+    pub fn invoke(number: kernel.syscall.Number, arguments: kernel.syscall.Arguments) usize {
+        _ = arguments;
+        _ = number;
+        core.panic("UNIMPLEMENTED `invoke`"); // TODO: Implement `invoke`
+    }
 };
 
 pub const paging = struct {
@@ -109,6 +295,27 @@ pub const paging = struct {
         core.panic("UNIMPLEMENTED `switchToPageTable`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
     }
 
+    pub fn unmapRange(page_table: *PageTable, virtual_range: kernel.VirtualRange) void {
+        _ = virtual_range;
+        _ = page_table;
+        core.panic("UNIMPLEMENTED `unmapRange`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
+    }
+
+    pub fn translate(page_table: *PageTable, virtual_address: kernel.VirtualAddress) ?kernel.PhysicalAddress {
+        _ = virtual_address;
+        _ = page_table;
+        core.panic("UNIMPLEMENTED `translate`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
+    }
+
+    pub fn flushRange(virtual_range: kernel.VirtualRange) void {
+        _ = virtual_range;
+        core.panic("UNIMPLEMENTED `flushRange`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
+    }
+
+    pub fn flushAll() void {
+        core.panic("UNIMPLEMENTED `flushAll`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
+    }
+
     pub fn allocatePageTable() *PageTable {
         core.panic("UNIMPLEMENTED `allocatePageTable`"); // TODO: implement paging https://github.com/CascadeOS/CascadeOS/issues/23
     }
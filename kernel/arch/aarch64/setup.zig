@@ -23,10 +23,51 @@ pub fn earlyArchInitialization() void {
     core.panic("UNIMPLEMENTED `earlyArchInitialization`"); // TODO: Implement `earlyArchInitialization` https://github.com/CascadeOS/CascadeOS/issues/25
 }
 
+pub fn createBootstrapArchProcessor() aarch64.ArchProcessor {
+    return .{};
+}
+
+pub fn createArchProcessor() !aarch64.ArchProcessor {
+    return .{};
+}
+
+pub fn nonBootstrapArchInitialization(processor: *kernel.Processor) void {
+    _ = processor;
+    core.panic("UNIMPLEMENTED `nonBootstrapArchInitialization`"); // TODO: Implement `nonBootstrapArchInitialization`
+}
+
+pub fn initializeLocalInterruptController(processor: *kernel.Processor) void {
+    _ = processor;
+    core.panic("UNIMPLEMENTED `initializeLocalInterruptController`"); // TODO: Implement `initializeLocalInterruptController`
+}
+
+pub fn initializeDevices() void {
+    core.panic("UNIMPLEMENTED `initializeDevices`"); // TODO: Implement `initializeDevices`
+}
+
+pub fn captureProcessorTopology(processor: *kernel.Processor) void {
+    _ = processor;
+    core.panic("UNIMPLEMENTED `captureProcessorTopology`"); // TODO: Implement `captureProcessorTopology`
+}
+
+pub fn loadProcessor(processor: *kernel.Processor) void {
+    asm volatile ("msr TPIDR_EL1, %[processor]"
+        :
+        : [processor] "r" (processor),
+    );
+}
+
 pub fn captureSystemInformation() void {
     core.panic("UNIMPLEMENTED `captureSystemInformation`"); // TODO: Implement `captureSystemInformation` https://github.com/CascadeOS/CascadeOS/issues/26
 }
 
+/// Reads the frequency of the virtual counter.
+pub fn cycleCounterFrequency() u64 {
+    return asm volatile ("mrs %[ret], CNTFRQ_EL0"
+        : [ret] "=r" (-> u64),
+    );
+}
+
 pub fn configureSystemFeatures() void {
     core.panic("UNIMPLEMENTED `configureSystemFeatures`"); // TODO: Implement `configureSystemFeatures` https://github.com/CascadeOS/CascadeOS/issues/27
 }
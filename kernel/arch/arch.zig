@@ -23,6 +23,61 @@ pub inline fn spinLoopHint() void {
     current.spinLoopHint();
 }
 
+/// Reads a monotonically increasing counter suitable for measuring short intervals.
+///
+/// The frequency of the counter is architecture specific, on x86_64 this is the timestamp counter.
+pub inline fn readCycleCounter() u64 {
+    return current.readCycleCounter();
+}
+
+/// Captures the registers needed to walk the stack from the point of the call, see `kernel.debug.StackIterator`.
+pub inline fn captureUnwindRegisters() kernel.debug.StackIterator.Registers {
+    return current.captureUnwindRegisters();
+}
+
+/// Returns the stack of `processor` used for interrupts and exceptions that contains `address`, if any.
+///
+/// Interrupts that do not switch stacks run on the stack of the interrupted task, which is not included.
+pub inline fn interruptStackContaining(
+    processor: *kernel.Processor,
+    address: kernel.VirtualAddress,
+) ?kernel.VirtualRange {
+    return current.interruptStackContaining(processor, address);
+}
+
+/// Computes the CRC-32C (Castagnoli) checksum of `bytes` with the best implementation for the executing processor.
+pub inline fn crc32c(bytes: []const u8) u32 {
+    return current.crc32c(bytes);
+}
+
+/// Architecture specific per-processor data.
+pub const ArchProcessor = current.ArchProcessor;
+
+/// Architecture specific per-task data.
+pub const ArchTask = current.ArchTask;
+
+/// Get the current processor.
+///
+/// Supports being called with interrupts and preemption enabled, but the caller must ensure preemption is disabled
+/// for the returned processor to remain the current processor.
+pub inline fn getProcessor() *kernel.Processor {
+    return current.getProcessor();
+}
+
+/// Increments the preemption disable count of the current processor.
+///
+/// Must be safe against the executing task being migrated to another processor part way through.
+pub inline fn incrementPreemptionDisableCount() void {
+    current.incrementPreemptionDisableCount();
+}
+
+/// Decrements the preemption disable count of the current processor.
+///
+/// Must be safe against the executing task being migrated to another processor part way through.
+pub inline fn decrementPreemptionDisableCount() void {
+    current.decrementPreemptionDisableCount();
+}
+
 /// Functionality that is intended to be used during system setup only.
 pub const setup = struct {
     /// Attempt to set up some form of early output.
@@ -45,6 +100,55 @@ pub const setup = struct {
         current.setup.earlyArchInitialization();
     }
 
+    /// Creates the architecture specific data for the bootstrap processor.
+    pub inline fn createBootstrapArchProcessor() ArchProcessor {
+        return current.setup.createBootstrapArchProcessor();
+    }
+
+    /// Creates the architecture specific data for a non-bootstrap processor.
+    ///
+    /// Called after virtual memory is initialized.
+    pub inline fn createArchProcessor() !ArchProcessor {
+        return current.setup.createArchProcessor();
+    }
+
+    /// Load the provided `Processor` as the current processor.
+    ///
+    /// Called after `earlyArchInitialization` as on some architectures that would clobber the loaded processor.
+    pub inline fn loadProcessor(processor: *kernel.Processor) void {
+        current.setup.loadProcessor(processor);
+    }
+
+    /// Performs the architecture specific initialization of a non-bootstrap processor, including loading `processor`
+    /// as the current processor.
+    ///
+    /// Called on the non-bootstrap processor itself before it switches to the kernel page table.
+    pub inline fn nonBootstrapArchInitialization(processor: *kernel.Processor) void {
+        current.setup.nonBootstrapArchInitialization(processor);
+    }
+
+    /// Initializes the interrupt controller local to the executing processor.
+    ///
+    /// Called on each processor after virtual memory is initialized, the bootstrap processor is always first.
+    pub inline fn initializeLocalInterruptController(processor: *kernel.Processor) void {
+        current.setup.initializeLocalInterruptController(processor);
+    }
+
+    /// Initializes the devices that are used by the kernel itself, for example switching the early output to be
+    /// interrupt driven.
+    ///
+    /// Called once on the bootstrap processor after `initializeLocalInterruptController`.
+    pub inline fn initializeDevices() void {
+        current.setup.initializeDevices();
+    }
+
+    /// Captures the topology of the executing processor into `processor.topology`.
+    ///
+    /// Called on each processor after `captureSystemInformation`.
+    pub inline fn captureProcessorTopology(processor: *kernel.Processor) void {
+        current.setup.captureProcessorTopology(processor);
+    }
+
     /// Capture any system information that is required for the architecture.
     ///
     /// For example, on x86_64 this should capture the CPUID information.
@@ -52,6 +156,13 @@ pub const setup = struct {
         current.setup.captureSystemInformation();
     }
 
+    /// Returns the frequency of `readCycleCounter` in Hz, calibrating it if required.
+    ///
+    /// Called once after `configureSystemFeatures`.
+    pub inline fn cycleCounterFrequency() u64 {
+        return current.setup.cycleCounterFrequency();
+    }
+
     /// Configure any system features.
     ///
     /// For example, on x86_64 this should enable any CPU features that are required.
@@ -80,6 +191,152 @@ pub const interrupts = struct {
     pub inline fn interruptsEnabled() bool {
         return current.interrupts.interruptsEnabled();
     }
+
+    /// Enable interrupts and put the CPU to sleep until the next interrupt.
+    ///
+    /// Enabling interrupts and sleeping is atomic, so an interrupt that becomes pending while interrupts are still
+    /// disabled wakes the CPU rather than being handled before it sleeps.
+    pub inline fn enableInterruptsAndHalt() void {
+        current.interrupts.enableInterruptsAndHalt();
+    }
+
+    /// Raises an interrupt on the current processor whose handler does nothing.
+    ///
+    /// Used to measure the cost of interrupt entry and exit.
+    pub inline fn raiseNoOperationInterrupt() void {
+        current.interrupts.raiseNoOperationInterrupt();
+    }
+
+    /// Interrupts `processor` to handle the cross-processor calls queued for it.
+    pub inline fn sendCrossCallInterrupt(processor: *kernel.Processor) void {
+        current.interrupts.sendCrossCallInterrupt(processor);
+    }
+
+    /// Logs the number of interrupts and the time spent handling them, per vector and processor.
+    pub inline fn logStatistics() void {
+        current.interrupts.logStatistics();
+    }
+};
+
+pub const memory = struct {
+    /// A page of `paging.standard_page_size` bytes.
+    pub const Page = [paging.standard_page_size.bytes]u8;
+
+    /// Fills `page` with zeroes.
+    pub inline fn zeroPage(page: *align(paging.standard_page_size.bytes) Page) void {
+        current.memory.zeroPage(page);
+    }
+
+    /// Fills `page` with zeroes without caching it, for a page that will not be accessed soon.
+    pub inline fn zeroPageNonTemporal(page: *align(paging.standard_page_size.bytes) Page) void {
+        current.memory.zeroPageNonTemporal(page);
+    }
+
+    /// Copies `source` to `destination`.
+    pub inline fn copyPage(
+        destination: *align(paging.standard_page_size.bytes) Page,
+        source: *align(paging.standard_page_size.bytes) const Page,
+    ) void {
+        current.memory.copyPage(destination, source);
+    }
+
+    /// Copies `source` to `destination` without caching `destination`, for a page that will not be accessed soon.
+    pub inline fn copyPageNonTemporal(
+        destination: *align(paging.standard_page_size.bytes) Page,
+        source: *align(paging.standard_page_size.bytes) const Page,
+    ) void {
+        current.memory.copyPageNonTemporal(destination, source);
+    }
+};
+
+pub const timer = struct {
+    /// Arms the one-shot timer of the current processor to call `kernel.timer.expire` at `deadline`, in ticks of
+    /// `readCycleCounter`, replacing any deadline it was armed with.
+    ///
+    /// A deadline in the past fires immediately.
+    pub inline fn setDeadline(deadline: u64) void {
+        current.timer.setDeadline(deadline);
+    }
+
+    /// Disarms the one-shot timer of the current processor.
+    pub inline fn cancel() void {
+        current.timer.cancel();
+    }
+};
+
+pub const performance_counters = struct {
+    /// Returns true if `event` is counted by the hardware once `enable` has been called.
+    ///
+    /// Never called for `.cycles`, which is always counted by `readCycleCounter`.
+    pub inline fn isEventSupported(event: kernel.performance_counters.Event) bool {
+        return current.performance_counters.isEventSupported(event);
+    }
+
+    /// Starts counting every supported event on the current processor, from zero.
+    pub inline fn enable() void {
+        current.performance_counters.enable();
+    }
+
+    /// Reads the count of `event` on the current processor.
+    ///
+    /// `event` must be supported and `enable` must have been called on the current processor.
+    pub inline fn read(event: kernel.performance_counters.Event) u64 {
+        return current.performance_counters.read(event);
+    }
+};
+
+pub const profiling = struct {
+    /// Returns true if `start` can be used.
+    pub inline fn isAvailable() bool {
+        return current.profiling.isAvailable();
+    }
+
+    /// Starts interrupting the current processor roughly every `period` ticks of `readCycleCounter` it spends
+    /// executing, calling `kernel.profiler.recordSample` with the interrupted state.
+    ///
+    /// The interrupt should not be maskable, so that code running with interrupts disabled is sampled.
+    pub inline fn start(period: u64) void {
+        current.profiling.start(period);
+    }
+
+    /// Stops the interrupts started by `start` on the current processor.
+    pub inline fn stop() void {
+        current.profiling.stop();
+    }
+};
+
+pub const scheduling = struct {
+    /// Switches from `current_task` to `new_task`, returning once `current_task` is switched back to.
+    ///
+    /// Must be called with interrupts disabled.
+    pub inline fn switchToTask(current_task: *kernel.Task, new_task: *kernel.Task) void {
+        current.scheduling.switchToTask(current_task, new_task);
+    }
+
+    /// Prepares the stack of `task` so that the first switch to it calls `entry` with `task` as its only argument.
+    pub inline fn prepareNewTask(
+        task: *kernel.Task,
+        entry: *const fn (task: *kernel.Task) callconv(.C) noreturn,
+    ) void {
+        current.scheduling.prepareNewTask(task, entry);
+    }
+
+    /// Interrupts `processor`, making it re-evaluate which task it should be running.
+    pub inline fn sendSchedulerInterrupt(processor: *kernel.Processor) void {
+        current.scheduling.sendSchedulerInterrupt(processor);
+    }
+};
+
+pub const syscall = struct {
+    /// Returns true if `invoke` can be used.
+    pub inline fn isAvailable() bool {
+        return current.syscall.isAvailable();
+    }
+
+    /// Performs the system call `number` with `arguments` and returns its result.
+    pub inline fn invoke(number: kernel.syscall.Number, arguments: kernel.syscall.Arguments) usize {
+        return current.syscall.invoke(number, arguments);
+    }
 };
 
 pub const paging = struct {
@@ -146,4 +403,26 @@ pub const paging = struct {
     pub inline fn switchToPageTable(page_table: *const PageTable) void {
         current.paging.switchToPageTable(page_table);
     }
+
+    /// Unmaps the standard sized pages in `virtual_range`, pages that are not mapped are skipped.
+    ///
+    /// Neither the page tables nor the physical pages are freed and the TLB is not flushed.
+    pub inline fn unmapRange(page_table: *PageTable, virtual_range: kernel.VirtualRange) void {
+        current.paging.unmapRange(page_table, virtual_range);
+    }
+
+    /// Returns the physical address `virtual_address` is mapped to by a standard sized page, null if it is not mapped.
+    pub inline fn translate(page_table: *PageTable, virtual_address: kernel.VirtualAddress) ?kernel.PhysicalAddress {
+        return current.paging.translate(page_table, virtual_address);
+    }
+
+    /// Invalidates the TLB entries of the executing processor for `virtual_range`.
+    pub inline fn flushRange(virtual_range: kernel.VirtualRange) void {
+        current.paging.flushRange(virtual_range);
+    }
+
+    /// Invalidates every TLB entry of the executing processor, including global ones.
+    pub inline fn flushAll() void {
+        current.paging.flushAll();
+    }
 };
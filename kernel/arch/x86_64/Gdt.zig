@@ -11,8 +11,8 @@ pub const Gdt = extern struct {
         0x0000000000000000, // Null
         0x00A09A0000000000, // 64 bit code
         0x0000920000000000, // 64 bit data
-        0x00A09A0000000000 | (3 << 45), // Userspace 64 bit code
         0x0000920000000000 | (3 << 45), // Userspace 64 bit data
+        0x00A09A0000000000 | (3 << 45), // Userspace 64 bit code
         0, // TSS
         0,
     },
@@ -20,8 +20,9 @@ pub const Gdt = extern struct {
     pub const null_selector: u16 = 0x00;
     pub const kernel_code_selector: u16 = 0x08;
     pub const kernel_data_selector: u16 = 0x10;
-    pub const user_code_selector: u16 = 0x18 | 3;
-    pub const user_data_selector: u16 = 0x20 | 3;
+    // the user data selector must directly precede the user code selector for `SYSRET`
+    pub const user_data_selector: u16 = 0x18 | 3;
+    pub const user_code_selector: u16 = 0x20 | 3;
     pub const tss_selector: u16 = 0x28;
 
     const mask_u8: u64 = std.math.maxInt(u8);
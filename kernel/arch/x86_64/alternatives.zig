@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+
+//! Selects the best implementation of hot routines for the executing processor once during boot.
+//!
+//! Each routine is called through a function pointer that starts out at a baseline implementation every x86_64
+//! processor supports, so the routine can be called at any point during boot. `apply` replaces the pointers once the
+//! cpuid information is captured, after which calling a routine costs an indirect call rather than a feature check.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.alternatives);
+
+/// A processor feature an implementation can require.
+pub const Feature = enum {
+    erms,
+    fsrm,
+    sse4_2,
+
+    pub fn isPresent(self: Feature) bool {
+        return switch (self) {
+            .erms => x86_64.info.has_erms,
+            .fsrm => x86_64.info.has_fsrm,
+            .sse4_2 => x86_64.info.has_sse4_2,
+        };
+    }
+};
+
+/// A routine with several implementations, called through `function`.
+pub fn Alternative(comptime Function: type) type {
+    return struct {
+        /// The implementation to call, only written by `apply`.
+        function: *const Function,
+
+        /// The implementations that require a processor feature, in order of preference.
+        candidates: []const Candidate,
+
+        const Self = @This();
+
+        pub const Candidate = struct {
+            name: []const u8,
+            requires: []const Feature,
+            function: *const Function,
+        };
+
+        pub fn init(baseline: *const Function, candidates: []const Candidate) Self {
+            return .{
+                .function = baseline,
+                .candidates = candidates,
+            };
+        }
+
+        fn select(self: *Self, comptime name: []const u8) void {
+            for (self.candidates) |candidate| {
+                const supported = for (candidate.requires) |feature| {
+                    if (!feature.isPresent()) break false;
+                } else true;
+
+                if (!supported) continue;
+
+                self.function = candidate.function;
+                log.debug(name ++ ": {s}", .{candidate.name});
+                return;
+            }
+
+            log.debug(name ++ ": baseline", .{});
+        }
+    };
+}
+
+/// Every routine with alternatives, by name.
+const routines = .{
+    .{ "copy", &x86_64.memory.copy_alternative },
+    .{ "fill", &x86_64.memory.fill_alternative },
+    .{ "zero page", &x86_64.memory.zero_page_alternative },
+    .{ "crc32c", &x86_64.checksum.crc32c_alternative },
+};
+
+/// Selects the implementation of every routine.
+///
+/// Must be called on the bootstrap processor after `cpuid.capture` and before any other processor is started.
+pub fn apply() void {
+    inline for (routines) |routine| routine[1].select(routine[0]);
+}
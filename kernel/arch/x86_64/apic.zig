@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: MIT
+
+//! Local APIC driver.
+//!
+//! x2APIC mode is used when available, its registers are MSRs which makes EOI and IPIs single `wrmsr` instructions
+//! rather than uncached MMIO accesses, and an IPI no longer requires polling for delivery.
+//!
+//! The timer uses TSC-deadline mode when available, arming it is a single `wrmsr` of the absolute deadline.
+//! Otherwise the one-shot mode is used with its tick rate calibrated against the timestamp counter, so deadlines are
+//! expressed in timestamp counter ticks either way.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.apic);
+
+const IdtVector = x86_64.interrupts.IdtVector;
+
+const Mode = enum {
+    xapic,
+    x2apic,
+};
+
+const TimerMode = enum {
+    one_shot,
+    tsc_deadline,
+};
+
+var mode: Mode = .xapic;
+var timer_mode: TimerMode = .one_shot;
+
+/// The virtual address of the xAPIC MMIO registers, only valid in xAPIC mode.
+var xapic_base: kernel.VirtualAddress = undefined;
+
+/// The number of local APIC timer ticks per timestamp counter tick as a 32.32 fixed point number, only valid when the
+/// timer is in one-shot mode.
+var timer_ticks_per_cycle: u64 = 0;
+
+/// The number of timestamp counter ticks the one-shot timer is calibrated over.
+const calibration_cycles = 1 << 24;
+
+/// Initializes the local APIC of the executing processor.
+///
+/// The first call also selects the mode, which every processor then uses, and calibrates the timer if required.
+///
+/// Must be called on every processor after virtual memory is initialized.
+pub fn init(processor: *kernel.Processor) void {
+    const first_call = processor.id == .bootstrap;
+
+    if (first_call) {
+        if (!x86_64.info.has_apic) core.panic("local APIC not present");
+
+        mode = if (x86_64.info.has_x2apic) .x2apic else .xapic;
+        timer_mode = if (x86_64.info.has_tsc_deadline) .tsc_deadline else .one_shot;
+
+        log.debug("using {s} mode with the {s} timer", .{ @tagName(mode), @tagName(timer_mode) });
+    }
+
+    var apic_base = x86_64.registers.IA32_APIC_BASE.read();
+    apic_base.apic_global_enable = true;
+    // the enable bits must be set in two steps, enabling both at once from disabled is invalid
+    x86_64.registers.IA32_APIC_BASE.write(apic_base);
+    if (mode == .x2apic) {
+        apic_base.x2apic_enable = true;
+        x86_64.registers.IA32_APIC_BASE.write(apic_base);
+    }
+
+    if (first_call and mode == .xapic) {
+        xapic_base = apic_base.baseAddress().toNonCachedDirectMap();
+    }
+
+    // accept all interrupts
+    writeRegister(.task_priority, 0);
+
+    writeRegister(.lvt_lint0, lvt_masked);
+    writeRegister(.lvt_lint1, lvt_masked);
+    writeRegister(.lvt_error, @intFromEnum(IdtVector.local_apic_error));
+
+    // the error status register must be written before being read
+    writeRegister(.error_status, 0);
+    writeRegister(.error_status, 0);
+
+    writeRegister(
+        .spurious_interrupt,
+        @intFromEnum(IdtVector.spurious_interrupt) | spurious_interrupt_software_enable,
+    );
+
+    initializeTimer(first_call);
+
+    // acknowledge anything left pending by the bootloader
+    endOfInterrupt();
+}
+
+/// Signals the end of the current interrupt.
+///
+/// Must be called by the handler of every interrupt delivered by the local APIC, other than the spurious interrupt.
+pub inline fn endOfInterrupt() void {
+    writeRegister(.end_of_interrupt, 0);
+}
+
+pub const IpiDestination = union(enum) {
+    apic_id: u32,
+    all_excluding_self,
+};
+
+/// Sends a fixed interrupt with the given vector.
+pub fn sendIpi(destination: IpiDestination, vector: IdtVector) void {
+    var command: u64 = @intFromEnum(vector) | icr_assert_level;
+
+    switch (destination) {
+        .apic_id => |apic_id| command |= @as(u64, apic_id) << switch (mode) {
+            .x2apic => 32,
+            .xapic => 56,
+        },
+        .all_excluding_self => command |= icr_destination_all_excluding_self,
+    }
+
+    switch (mode) {
+        .x2apic => {
+            // `wrmsr` to the x2APIC registers is not serializing, so without a full fence the IPI could be received
+            // before preceding stores are visible, for example the task an idle processor is being kicked to run
+            asm volatile (
+                \\mfence
+                \\lfence
+                ::: "memory");
+
+            x86_64.registers.MSR(u64, x2apicMsr(.interrupt_command_low)).write(command);
+        },
+        .xapic => {
+            const interrupts_enabled = x86_64.interrupts.interruptsEnabled();
+            x86_64.interrupts.disableInterrupts();
+            defer if (interrupts_enabled) x86_64.interrupts.enableInterrupts();
+
+            // only one IPI can be in flight at a time
+            while (readRegister(.interrupt_command_low) & icr_delivery_pending != 0) {
+                x86_64.instructions.pause();
+            }
+
+            writeRegister(.interrupt_command_high, @truncate(command >> 32));
+            writeRegister(.interrupt_command_low, @truncate(command));
+        },
+    }
+}
+
+/// Arms the timer of the executing processor to fire at the given timestamp counter value, replacing any previously
+/// armed deadline.
+///
+/// A deadline in the past fires immediately.
+pub fn setTimerDeadline(deadline: u64) void {
+    switch (timer_mode) {
+        .tsc_deadline => x86_64.registers.IA32_TSC_DEADLINE.write(deadline),
+        .one_shot => {
+            const now = x86_64.instructions.readTimestampCounter();
+            const cycles = if (deadline > now) deadline - now else 0;
+
+            const ticks = std.math.mulWide(u64, cycles, timer_ticks_per_cycle) >> 32;
+
+            // an initial count of zero disarms the timer
+            writeRegister(.timer_initial_count, @intCast(std.math.clamp(ticks, 1, std.math.maxInt(u32))));
+        },
+    }
+}
+
+/// Disarms the timer of the executing processor.
+pub fn cancelTimer() void {
+    switch (timer_mode) {
+        .tsc_deadline => x86_64.registers.IA32_TSC_DEADLINE.write(0),
+        .one_shot => writeRegister(.timer_initial_count, 0),
+    }
+}
+
+fn initializeTimer(first_call: bool) void {
+    switch (timer_mode) {
+        .tsc_deadline => {
+            writeRegister(.lvt_timer, @intFromEnum(IdtVector.local_apic_timer) | lvt_timer_mode_tsc_deadline);
+
+            // the switch to TSC-deadline mode must be ordered before any write to the deadline
+            asm volatile ("mfence" ::: "memory");
+        },
+        .one_shot => {
+            writeRegister(.timer_divide_configuration, timer_divide_by_16);
+
+            if (first_call) calibrateTimer();
+
+            writeRegister(.lvt_timer, @intFromEnum(IdtVector.local_apic_timer) | lvt_timer_mode_one_shot);
+        },
+    }
+
+    cancelTimer();
+}
+
+/// Measures the number of timer ticks per timestamp counter tick.
+///
+/// The rate is assumed to be the same on every processor.
+fn calibrateTimer() void {
+    writeRegister(.lvt_timer, lvt_masked | lvt_timer_mode_one_shot);
+
+    const start = x86_64.instructions.readTimestampCounter();
+    writeRegister(.timer_initial_count, std.math.maxInt(u32));
+
+    while (x86_64.instructions.readTimestampCounter() - start < calibration_cycles) {
+        x86_64.instructions.pause();
+    }
+
+    const ticks = std.math.maxInt(u32) - readRegister(.timer_current_count);
+    const cycles = x86_64.instructions.readTimestampCounter() - start;
+
+    writeRegister(.timer_initial_count, 0);
+
+    if (ticks == 0) core.panic("local APIC timer is not counting");
+
+    timer_ticks_per_cycle = (@as(u64, ticks) << 32) / cycles;
+
+    log.debug("timer runs at {} ticks per {} cycles", .{ ticks, cycles });
+}
+
+/// Delivers performance counter overflows on the executing processor as non-maskable interrupts.
+///
+/// The local APIC masks the entry when it delivers one, so this must be called again to receive the next.
+pub fn enablePerformanceCounterInterrupt() void {
+    writeRegister(.lvt_performance_counter, lvt_delivery_mode_nmi);
+}
+
+/// Stops delivering performance counter overflows on the executing processor.
+pub fn disablePerformanceCounterInterrupt() void {
+    writeRegister(.lvt_performance_counter, lvt_masked);
+}
+
+/// Handles the local APIC timer expiring.
+pub fn timerInterruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+    endOfInterrupt();
+    kernel.timer.expire();
+}
+
+/// Handles the spurious interrupt, which must not be acknowledged.
+pub fn spuriousInterruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+}
+
+pub fn errorInterruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+
+    // the error status register must be written before being read
+    writeRegister(.error_status, 0);
+    const error_status = readRegister(.error_status);
+
+    endOfInterrupt();
+
+    log.warn("local APIC error: 0x{x}", .{error_status});
+}
+
+const lvt_masked: u32 = 1 << 16;
+const lvt_delivery_mode_nmi: u32 = 0b100 << 8;
+const lvt_timer_mode_one_shot: u32 = 0b00 << 17;
+const lvt_timer_mode_tsc_deadline: u32 = 0b10 << 17;
+
+const spurious_interrupt_software_enable: u32 = 1 << 8;
+
+const timer_divide_by_16: u32 = 0b0011;
+
+const icr_delivery_pending: u32 = 1 << 12;
+const icr_assert_level: u64 = 1 << 14;
+const icr_destination_all_excluding_self: u64 = 0b11 << 18;
+
+/// Local APIC registers, the value is the offset of the register in the xAPIC MMIO region.
+const Register = enum(u32) {
+    id = 0x20,
+    version = 0x30,
+    task_priority = 0x80,
+    end_of_interrupt = 0xB0,
+    spurious_interrupt = 0xF0,
+    error_status = 0x280,
+    interrupt_command_low = 0x300,
+    interrupt_command_high = 0x310,
+    lvt_timer = 0x320,
+    lvt_performance_counter = 0x340,
+    lvt_lint0 = 0x350,
+    lvt_lint1 = 0x360,
+    lvt_error = 0x370,
+    timer_initial_count = 0x380,
+    timer_current_count = 0x390,
+    timer_divide_configuration = 0x3E0,
+};
+
+/// Returns the x2APIC MSR for the given register.
+///
+/// In x2APIC mode the interrupt command register is a single 64-bit MSR at the address of `interrupt_command_low`.
+fn x2apicMsr(comptime register: Register) u32 {
+    return 0x800 + (@intFromEnum(register) >> 4);
+}
+
+inline fn readRegister(comptime register: Register) u32 {
+    return switch (mode) {
+        .x2apic => x86_64.registers.MSR(u32, x2apicMsr(register)).read(),
+        .xapic => xapicRegister(register).*,
+    };
+}
+
+inline fn writeRegister(comptime register: Register, value: u32) void {
+    switch (mode) {
+        .x2apic => x86_64.registers.MSR(u32, x2apicMsr(register)).write(value),
+        .xapic => xapicRegister(register).* = value,
+    }
+}
+
+inline fn xapicRegister(comptime register: Register) *volatile u32 {
+    return xapic_base.moveForward(core.Size.from(@intFromEnum(register), .byte)).toPtr(*volatile u32);
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+
+//! Checksums with an implementation selected by `alternatives.apply`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const Alternative = x86_64.alternatives.Alternative;
+
+const Crc32cFunction = fn (bytes: []const u8) u32;
+
+pub var crc32c_alternative = Alternative(Crc32cFunction).init(&crc32cTable, &.{
+    .{ .name = "crc32 instruction", .requires = &.{.sse4_2}, .function = &crc32cInstruction },
+});
+
+/// Computes the CRC-32C (Castagnoli) checksum of `bytes`.
+pub inline fn crc32c(bytes: []const u8) u32 {
+    return crc32c_alternative.function(bytes);
+}
+
+fn crc32cTable(bytes: []const u8) u32 {
+    return std.hash.crc.Crc32WithPoly(.Castagnoli).hash(bytes);
+}
+
+/// Uses the SSE4.2 `crc32` instruction, which only uses general purpose registers so needs no extended state.
+fn crc32cInstruction(bytes: []const u8) u32 {
+    var crc: u64 = 0xFFFFFFFF;
+
+    var remaining = bytes;
+    while (remaining.len >= 8) : (remaining = remaining[8..]) {
+        crc = asm ("crc32q %[quadword], %[crc]"
+            : [result] "={rax}" (-> u64),
+            : [crc] "{rax}" (crc),
+              [quadword] "r" (std.mem.readIntLittle(u64, remaining[0..8])),
+        );
+    }
+
+    var crc32: u32 = @truncate(crc);
+    for (remaining) |byte| {
+        crc32 = asm ("crc32b %[byte], %[crc]"
+            : [result] "={eax}" (-> u32),
+            : [crc] "{eax}" (crc32),
+              [byte] "r" (byte),
+        );
+    }
+
+    return ~crc32;
+}
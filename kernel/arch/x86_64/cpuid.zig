@@ -23,9 +23,208 @@ pub fn capture() void {
     log.debug("largest extended function: 0x{x}", .{max_extended_leaf});
 
     handleSimpleLeafs(max_standard_leaf, max_extended_leaf);
+
+    captureTopology(max_standard_leaf);
+
+    captureExtendedState(max_standard_leaf);
+
+    captureTimestampCounterFrequency(max_standard_leaf);
+
+    capturePerformanceMonitoring(max_standard_leaf);
+}
+
+/// Captures the architectural performance monitoring capabilities.
+fn capturePerformanceMonitoring(max_standard_leaf: u32) void {
+    if (max_standard_leaf < 0xA) return;
+
+    const leaf = raw_cpuid(0xA, 0);
+
+    x86_64.info.performance_monitoring_version = @truncate(leaf.eax);
+    x86_64.info.number_of_performance_counters = @truncate(leaf.eax >> 8);
+    x86_64.info.performance_counter_width = @truncate(leaf.eax >> 16);
+
+    // each set bit of ebx marks an architectural event as unavailable, only the first `eax[31:24]` bits are valid
+    const number_of_events: u5 = @intCast(@min(leaf.eax >> 24, 31));
+    const valid_events = (@as(u32, 1) << number_of_events) - 1;
+    x86_64.info.architectural_events = ~leaf.ebx & valid_events;
+
+    log.debug("performance monitoring version: {}", .{x86_64.info.performance_monitoring_version});
+    log.debug("performance counters: {}", .{x86_64.info.number_of_performance_counters});
+    log.debug("performance counter width: {}", .{x86_64.info.performance_counter_width});
+    log.debug("architectural events: 0b{b}", .{x86_64.info.architectural_events});
+}
+
+/// Captures the frequency of the timestamp counter and the base frequency of the processor if the processor enumerates
+/// them.
+fn captureTimestampCounterFrequency(max_standard_leaf: u32) void {
+    if (max_standard_leaf >= 0x16) {
+        x86_64.info.processor_base_frequency = @as(u64, raw_cpuid(0x16, 0).eax & 0xFFFF) * 1_000_000;
+        log.debug("processor base frequency: {} Hz", .{x86_64.info.processor_base_frequency});
+    }
+
+    if (max_standard_leaf < 0x15) return;
+
+    // the timestamp counter runs at `crystal * numerator / denominator`
+    const leaf = raw_cpuid(0x15, 0);
+    const denominator = leaf.eax;
+    const numerator = leaf.ebx;
+    if (denominator == 0 or numerator == 0) return;
+
+    var crystal_frequency: u64 = leaf.ecx;
+
+    // some processors do not enumerate the crystal frequency, but it can be derived from the base frequency
+    if (crystal_frequency == 0 and max_standard_leaf >= 0x16) {
+        const base_frequency_mhz: u64 = raw_cpuid(0x16, 0).eax & 0xFFFF;
+        crystal_frequency = base_frequency_mhz * 1_000_000 * denominator / numerator;
+    }
+
+    if (crystal_frequency == 0) return;
+
+    x86_64.info.timestamp_counter_frequency = crystal_frequency * numerator / denominator;
+    log.debug("timestamp counter frequency: {} Hz", .{x86_64.info.timestamp_counter_frequency});
+}
+
+/// Captures which extended state components to enable and the size of the area required to save them.
+fn captureExtendedState(max_standard_leaf: u32) void {
+    if (!x86_64.info.has_xsave or max_standard_leaf < 0xD) {
+        // the legacy FXSAVE area
+        x86_64.info.extended_state_size = 512;
+        log.debug("extended state size: {}", .{x86_64.info.extended_state_size});
+        return;
+    }
+
+    const leaf = raw_cpuid(0xD, 0);
+    const supported_features = (@as(u64, leaf.edx) << 32) | leaf.eax;
+
+    const XCR0 = x86_64.registers.XCR0;
+
+    var features = supported_features & (XCR0.x87 | XCR0.sse | XCR0.avx);
+    // the AVX-512 components must be enabled together
+    if (supported_features & XCR0.avx512 == XCR0.avx512) features |= XCR0.avx512;
+
+    x86_64.info.xsave_features = features;
+
+    // legacy region and XSAVE header
+    var size: u32 = 576;
+
+    // components 0 and 1 are in the legacy region
+    var component: u6 = 2;
+    while (component < 63) : (component += 1) {
+        if (features & (@as(u64, 1) << component) == 0) continue;
+
+        const component_leaf = raw_cpuid(0xD, component);
+        size = @max(size, component_leaf.ebx + component_leaf.eax);
+    }
+
+    x86_64.info.extended_state_size = size;
+
+    log.debug("xsave features: 0x{x}", .{x86_64.info.xsave_features});
+    log.debug("extended state size: {}", .{x86_64.info.extended_state_size});
+}
+
+/// Returns the APIC id of the executing processor.
+///
+/// Must be called after `capture`.
+pub fn apicId() u32 {
+    if (x86_64.info.has_extended_topology) return raw_cpuid(0xB, 0).edx;
+    return raw_cpuid(0x1, 0).ebx >> 24;
+}
+
+/// Captures how APIC ids are split into hardware thread, cache and package fields.
+///
+/// Assumes every processor in the system has the same topology as the bootstrap processor.
+fn captureTopology(max_standard_leaf: u32) void {
+    if (max_standard_leaf >= 0xB and raw_cpuid(0xB, 0).ebx != 0) {
+        x86_64.info.has_extended_topology = true;
+
+        var sub_leaf: u32 = 0;
+        while (true) : (sub_leaf += 1) {
+            const leaf = raw_cpuid(0xB, sub_leaf);
+
+            const level_type: u8 = @truncate(leaf.ecx >> 8);
+            if (level_type == 0) break;
+
+            const shift: u5 = @truncate(leaf.eax);
+
+            // level type 1 is SMT, the shift of the last valid level covers the entire package
+            if (level_type == 1) x86_64.info.smt_shift = shift;
+            x86_64.info.package_shift = shift;
+        }
+    } else if (max_standard_leaf >= 0x4) {
+        const logical_processors_per_package = (raw_cpuid(0x1, 0).ebx >> 16) & 0xFF;
+        const cores_per_package = (raw_cpuid(0x4, 0).eax >> 26) + 1;
+
+        x86_64.info.package_shift = log2Ceil(logical_processors_per_package);
+        x86_64.info.smt_shift = log2Ceil(logical_processors_per_package / cores_per_package);
+    }
+
+    // assume the last level cache is shared by the entire package unless the deterministic cache leaf says otherwise
+    x86_64.info.last_level_cache_shift = x86_64.info.package_shift;
+
+    if (max_standard_leaf >= 0x4) {
+        var highest_cache_level: u32 = 0;
+
+        var sub_leaf: u32 = 0;
+        while (true) : (sub_leaf += 1) {
+            const leaf = raw_cpuid(0x4, sub_leaf);
+
+            const cache_type = leaf.eax & 0x1F;
+            if (cache_type == 0) break;
+
+            const cache_level = (leaf.eax >> 5) & 0x7;
+            if (cache_level < highest_cache_level) continue;
+            highest_cache_level = cache_level;
+
+            const processors_sharing_cache = ((leaf.eax >> 14) & 0xFFF) + 1;
+            x86_64.info.last_level_cache_shift = log2Ceil(processors_sharing_cache);
+        }
+    }
+
+    log.debug("extended topology: {}", .{x86_64.info.has_extended_topology});
+    log.debug("smt shift: {}", .{x86_64.info.smt_shift});
+    log.debug("last level cache shift: {}", .{x86_64.info.last_level_cache_shift});
+    log.debug("package shift: {}", .{x86_64.info.package_shift});
+}
+
+fn log2Ceil(value: u32) u5 {
+    if (value <= 1) return 0;
+    return @intCast(std.math.log2_int_ceil(u32, value));
 }
 
 const simple_leaf_handlers: []const SimpleLeafHandler = &.{
+    .{
+        .leaf = .{ .type = .standard, .value = 0x1 },
+        .handlers = &.{
+            .{ .name = "apic", .register = .edx, .mask_bit = 9, .target = &x86_64.info.has_apic },
+            .{ .name = "fxsave", .register = .edx, .mask_bit = 24, .target = &x86_64.info.has_fxsave },
+            .{ .name = "monitor/mwait", .register = .ecx, .mask_bit = 3, .target = &x86_64.info.has_monitor_mwait },
+            .{ .name = "pcid", .register = .ecx, .mask_bit = 17, .target = &x86_64.info.has_pcid },
+            .{ .name = "sse4.2", .register = .ecx, .mask_bit = 20, .target = &x86_64.info.has_sse4_2 },
+            .{ .name = "x2apic", .register = .ecx, .mask_bit = 21, .target = &x86_64.info.has_x2apic },
+            .{ .name = "tsc deadline", .register = .ecx, .mask_bit = 24, .target = &x86_64.info.has_tsc_deadline },
+            .{ .name = "xsave", .register = .ecx, .mask_bit = 26, .target = &x86_64.info.has_xsave },
+            .{ .name = "avx", .register = .ecx, .mask_bit = 28, .target = &x86_64.info.has_avx },
+        },
+    },
+    .{
+        .leaf = .{ .type = .standard, .value = 0x7 },
+        .handlers = &.{
+            .{ .name = "avx2", .register = .ebx, .mask_bit = 5, .target = &x86_64.info.has_avx2 },
+            .{ .name = "erms", .register = .ebx, .mask_bit = 9, .target = &x86_64.info.has_erms },
+            .{ .name = "invpcid", .register = .ebx, .mask_bit = 10, .target = &x86_64.info.has_invpcid },
+            .{ .name = "avx-512 foundation", .register = .ebx, .mask_bit = 16, .target = &x86_64.info.has_avx512f },
+            .{ .name = "clflushopt", .register = .ebx, .mask_bit = 23, .target = &x86_64.info.has_clflushopt },
+            .{ .name = "clwb", .register = .ebx, .mask_bit = 24, .target = &x86_64.info.has_clwb },
+            .{ .name = "fsrm", .register = .edx, .mask_bit = 4, .target = &x86_64.info.has_fsrm },
+        },
+    },
+    .{
+        .leaf = .{ .type = .standard, .value = 0xD, .sub_leaf = 1 },
+        .handlers = &.{
+            .{ .name = "xsaveopt", .register = .eax, .mask_bit = 0, .target = &x86_64.info.has_xsaveopt },
+            .{ .name = "xsaves", .register = .eax, .mask_bit = 3 },
+        },
+    },
     .{
         .leaf = .{ .type = .extended, .value = 0x80000001 },
         .handlers = &.{
@@ -36,6 +235,12 @@ const simple_leaf_handlers: []const SimpleLeafHandler = &.{
             .{ .name = "64-bit", .register = .edx, .mask_bit = 29 },
         },
     },
+    .{
+        .leaf = .{ .type = .extended, .value = 0x80000007 },
+        .handlers = &.{
+            .{ .name = "invariant tsc", .register = .edx, .mask_bit = 8, .target = &x86_64.info.has_invariant_tsc },
+        },
+    },
 };
 
 /// Handles simple CPUID leaves.
@@ -59,7 +264,7 @@ fn handleSimpleLeafs(max_standard_leaf: u32, max_extended_leaf: u32) void {
             break :blk;
         }
 
-        const cpuid_result = raw_cpuid(leaf_handler.leaf.value, 0);
+        const cpuid_result = raw_cpuid(leaf_handler.leaf.value, leaf_handler.leaf.sub_leaf);
 
         inline for (leaf_handler.handlers) |handler| {
             const register = switch (handler.register) {
@@ -86,6 +291,7 @@ const SimpleLeafHandler = struct {
         /// Specifies whether this is a standard or extended CPUID leaf.
         type: LeafType,
         value: u32,
+        sub_leaf: u32 = 0,
 
         pub const LeafType = enum {
             standard,
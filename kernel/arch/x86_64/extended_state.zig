@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: MIT
+
+//! Lazy switching of the extended (x87/SSE/AVX) state of tasks.
+//!
+//! The kernel itself never touches the extended state, so most tasks never use it and their task switches should not
+//! pay for saving or restoring it.
+//!
+//! `CR0.TS` is kept set while the task whose state is loaded on the processor is not running, causing the first
+//! extended state instruction of any other task to raise a device not available exception which loads that task's
+//! state.
+//!
+//! The state of a task is only saved when it is switched away from after having used the extended state since it
+//! was switched to, using `XSAVEOPT` when available so only modified components are written.
+//! After being saved the state stays loaded, so if no other task uses the extended state in the meantime the task
+//! continues with nothing more than a `clts`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.extended_state);
+
+/// The alignment required by `XSAVE`, `FXSAVE` only requires 16.
+pub const area_alignment = 64;
+
+/// Per-task extended state.
+pub const TaskState = struct {
+    /// The area the state of the task is saved to, null for tasks that must never use the extended state.
+    area: ?[*]align(area_alignment) u8 = null,
+
+    /// The processor the state of the task was last loaded onto.
+    loaded_on: ?*kernel.Processor = null,
+};
+
+/// Per-processor extended state.
+pub const ProcessorState = struct {
+    /// The task whose state is loaded on the processor.
+    owner: ?*kernel.Task = null,
+
+    /// Mirrors `CR0.TS`, to avoid reading or writing CR0 on the switch path when it already has the right value.
+    task_switched: bool = true,
+};
+
+const SaveInstruction = enum {
+    fxsave,
+    xsave,
+    xsaveopt,
+};
+
+var save_instruction: SaveInstruction = .fxsave;
+
+/// Enables the extended state on the executing processor, with `CR0.TS` set so that the first use traps.
+///
+/// Must be called on every processor after `x86_64.cpuid.capture`.
+pub fn enable() void {
+    if (!x86_64.info.has_fxsave) core.panic("fxsave is not supported");
+
+    var cr4 = x86_64.registers.Cr4.read();
+    cr4.os_fxsave_fxrstor_support = true;
+    cr4.os_unmasked_simd_floating_point_exceptions = true;
+    if (x86_64.info.has_xsave) cr4.os_xsave_enable = true;
+    cr4.write();
+
+    if (x86_64.info.has_xsave) {
+        x86_64.registers.XCR0.write(x86_64.info.xsave_features);
+        save_instruction = if (x86_64.info.has_xsaveopt) .xsaveopt else .xsave;
+    }
+
+    var cr0 = x86_64.registers.Cr0.read();
+    cr0.monitor_coprocessor = true;
+    cr0.emulate_coprocessor = false;
+    cr0.numeric_error = true;
+    cr0.task_switched = true;
+    cr0.write();
+
+    log.debug("extended state enabled using {s}", .{@tagName(save_instruction)});
+}
+
+/// Carves the extended state save area of `task` from the top of its stack and sets it to the initial state.
+///
+/// Returns the new top of the stack.
+pub fn prepareTask(task: *kernel.Task) usize {
+    const area_address = std.mem.alignBackward(
+        usize,
+        task.stack.end().value - x86_64.info.extended_state_size,
+        area_alignment,
+    );
+    const area: [*]align(area_alignment) u8 = @ptrFromInt(area_address);
+
+    // an area with a zero XSAVE header restores every component to its initial state, the legacy region is only used
+    // as is by `FXRSTOR` so it is given the default control words
+    @memset(area[0..@min(x86_64.info.extended_state_size, 576)], 0);
+    std.mem.writeIntNative(u16, area[0..2], 0x037F); // x87 control word
+    std.mem.writeIntNative(u32, area[24..28], 0x1F80); // MXCSR
+
+    task.arch.extended_state = .{ .area = area };
+
+    return area_address;
+}
+
+/// Called on the switch path before switching away from `current_task`.
+///
+/// Saves the state of `current_task` only if it has used the extended state since it was switched to, in which case
+/// `CR0.TS` is set again so the next task traps on its first use.
+pub inline fn switchTasks(processor: *kernel.Processor, current_task: *kernel.Task) void {
+    const state = &processor.arch.extended_state;
+
+    // `CR0.TS` is only ever clear while the owner is running, meaning it used the extended state
+    if (state.task_switched) return;
+
+    std.debug.assert(state.owner == current_task);
+    save(current_task.arch.extended_state.area.?);
+
+    // even if the next task is the owner it has to trap on its first use, otherwise we could not tell whether it
+    // needs saving when it is switched away from
+    setTaskSwitched();
+    state.task_switched = true;
+}
+
+/// Handles the device not available exception raised by the first use of the extended state while `CR0.TS` is set.
+pub fn handleDeviceNotAvailable(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = context;
+    const processor = kernel.Processor.current();
+    const state = &processor.arch.extended_state;
+    const task = processor.scheduler.current_task;
+
+    const area = task.arch.extended_state.area orelse {
+        core.panicFmt("extended state used by a task without a save area at 0x{x}", .{interrupt_frame.rip});
+    };
+
+    clearTaskSwitched();
+    state.task_switched = false;
+
+    if (state.owner == task and task.arch.extended_state.loaded_on == processor) return;
+
+    // the state of the previous owner was saved when it was switched away from
+    restore(area);
+
+    state.owner = task;
+    task.arch.extended_state.loaded_on = processor;
+}
+
+inline fn save(area: [*]align(area_alignment) u8) void {
+    switch (save_instruction) {
+        .fxsave => asm volatile ("fxsave64 (%[area])"
+            :
+            : [area] "r" (area),
+            : "memory"
+        ),
+        .xsave => asm volatile ("xsave64 (%[area])"
+            :
+            : [area] "r" (area),
+              [low] "{eax}" (@as(u32, 0xFFFFFFFF)),
+              [high] "{edx}" (@as(u32, 0xFFFFFFFF)),
+            : "memory"
+        ),
+        .xsaveopt => asm volatile ("xsaveopt64 (%[area])"
+            :
+            : [area] "r" (area),
+              [low] "{eax}" (@as(u32, 0xFFFFFFFF)),
+              [high] "{edx}" (@as(u32, 0xFFFFFFFF)),
+            : "memory"
+        ),
+    }
+}
+
+inline fn restore(area: [*]align(area_alignment) u8) void {
+    switch (save_instruction) {
+        .fxsave => asm volatile ("fxrstor64 (%[area])"
+            :
+            : [area] "r" (area),
+            : "memory"
+        ),
+        .xsave, .xsaveopt => asm volatile ("xrstor64 (%[area])"
+            :
+            : [area] "r" (area),
+              [low] "{eax}" (@as(u32, 0xFFFFFFFF)),
+              [high] "{edx}" (@as(u32, 0xFFFFFFFF)),
+            : "memory"
+        ),
+    }
+}
+
+inline fn clearTaskSwitched() void {
+    asm volatile ("clts" ::: "memory");
+}
+
+inline fn setTaskSwitched() void {
+    var cr0 = x86_64.registers.Cr0.read();
+    cr0.task_switched = true;
+    cr0.write();
+}
@@ -8,3 +8,77 @@ const x86_64 = @import("x86_64.zig");
 pub var has_syscall: bool = false;
 pub var has_execute_disable: bool = false;
 pub var has_gib_pages: bool = false;
+
+/// Whether the extended topology leaf (0xB) is available, which provides the 32-bit x2APIC id.
+pub var has_extended_topology: bool = false;
+
+/// The number of low bits of an APIC id that select the hardware thread within a core.
+pub var smt_shift: u5 = 0;
+
+/// The number of low bits of an APIC id that select the processor within a group sharing the last level cache.
+pub var last_level_cache_shift: u5 = 0;
+
+/// The number of low bits of an APIC id that select the processor within a package.
+pub var package_shift: u5 = 0;
+
+pub var has_fxsave: bool = false;
+pub var has_xsave: bool = false;
+pub var has_xsaveopt: bool = false;
+
+/// The state components enabled in XCR0, only valid if `has_xsave` is true.
+pub var xsave_features: u64 = 0;
+
+/// The size in bytes of the area required to save the extended (x87/SSE/AVX) state of a task.
+pub var extended_state_size: u32 = 0;
+
+pub var has_avx: bool = false;
+pub var has_avx2: bool = false;
+
+/// Whether the AVX-512 foundation instructions are supported.
+pub var has_avx512f: bool = false;
+
+/// Whether the SSE4.2 instructions are supported, which include the `crc32` instruction.
+pub var has_sse4_2: bool = false;
+
+/// Whether `rep movsb` and `rep stosb` are enhanced to be the fastest way to copy and fill memory.
+pub var has_erms: bool = false;
+
+/// Whether `rep movsb` is fast even for short copies.
+pub var has_fsrm: bool = false;
+
+pub var has_clflushopt: bool = false;
+pub var has_clwb: bool = false;
+
+/// Whether process-context identifiers are supported.
+pub var has_pcid: bool = false;
+pub var has_invpcid: bool = false;
+
+pub var has_monitor_mwait: bool = false;
+
+pub var has_apic: bool = false;
+pub var has_x2apic: bool = false;
+
+/// Whether the local APIC timer supports TSC-deadline mode.
+pub var has_tsc_deadline: bool = false;
+
+/// Whether the timestamp counter runs at a constant rate in all power states.
+pub var has_invariant_tsc: bool = false;
+
+/// The frequency of the timestamp counter in Hz as enumerated by cpuid, zero if it is not enumerated.
+pub var timestamp_counter_frequency: u64 = 0;
+
+/// The base frequency of the processor in Hz as enumerated by cpuid, zero if it is not enumerated.
+pub var processor_base_frequency: u64 = 0;
+
+/// The version of architectural performance monitoring, zero if it is not supported.
+pub var performance_monitoring_version: u8 = 0;
+
+/// The number of general purpose performance counters of each processor.
+pub var number_of_performance_counters: u8 = 0;
+
+/// The width in bits of the general purpose performance counters.
+pub var performance_counter_width: u8 = 0;
+
+/// The architectural performance monitoring events that can be counted, bit `n` is set if event `n` of
+/// `pmu.ArchitecturalEvent` is available.
+pub var architectural_events: u32 = 0;
@@ -2,6 +2,7 @@
 
 const std = @import("std");
 const core = @import("core");
+const kernel = @import("kernel");
 const x86_64 = @import("x86_64.zig");
 
 /// Issues a PAUSE instruction.
@@ -11,6 +12,58 @@ pub inline fn pause() void {
     asm volatile ("pause" ::: "memory");
 }
 
+/// Reads the timestamp counter.
+pub inline fn readTimestampCounter() u64 {
+    var low: u32 = undefined;
+    var high: u32 = undefined;
+    asm volatile ("rdtsc"
+        : [_] "={eax}" (low),
+          [_] "={edx}" (high),
+    );
+    return (@as(u64, high) << 32) | low;
+}
+
+/// Reads general purpose performance counter `index`.
+pub inline fn readPerformanceCounter(index: u32) u64 {
+    var low: u32 = undefined;
+    var high: u32 = undefined;
+    asm volatile ("rdpmc"
+        : [_] "={eax}" (low),
+          [_] "={edx}" (high),
+        : [_] "{ecx}" (index),
+    );
+    return (@as(u64, high) << 32) | low;
+}
+
+/// Captures the instruction, stack and frame pointers at the point of the call.
+pub inline fn captureUnwindRegisters() kernel.debug.StackIterator.Registers {
+    var instruction_pointer: usize = undefined;
+    var stack_pointer: usize = undefined;
+    var frame_pointer: usize = undefined;
+    asm volatile (
+        \\lea (%%rip), %[instruction_pointer]
+        \\mov %%rsp, %[stack_pointer]
+        \\mov %%rbp, %[frame_pointer]
+        : [instruction_pointer] "=r" (instruction_pointer),
+          [stack_pointer] "=r" (stack_pointer),
+          [frame_pointer] "=r" (frame_pointer),
+    );
+    return .{
+        .instruction_pointer = instruction_pointer,
+        .stack_pointer = stack_pointer,
+        .frame_pointer = frame_pointer,
+    };
+}
+
+/// Invalidates any TLB entries for the page containing `address` on the executing processor.
+pub inline fn invalidatePage(address: kernel.VirtualAddress) void {
+    asm volatile ("invlpg (%[address])"
+        :
+        : [address] "r" (address.value),
+        : "memory"
+    );
+}
+
 /// Reads a byte from the given I/O port.
 pub inline fn portReadU8(port: u16) u8 {
     return asm volatile ("inb %[port],%[ret]"
@@ -44,6 +97,17 @@ pub inline fn portWriteU8(port: u16, value: u8) void {
     );
 }
 
+/// Writes every byte of `bytes` to the given I/O port with a single `rep outsb`.
+pub inline fn portWriteBytes(port: u16, bytes: []const u8) void {
+    asm volatile ("rep outsb"
+        :
+        : [port] "{dx}" (port),
+          [source] "{rsi}" (bytes.ptr),
+          [count] "{rcx}" (bytes.len),
+        : "rsi", "rcx", "memory"
+    );
+}
+
 /// Writes a word (16 bits) to the given I/O port.
 pub inline fn portWriteU16(port: u16, value: u16) void {
     asm volatile ("outw %[value],%[port]"
@@ -10,15 +10,33 @@ const Idt = @import("Idt.zig");
 pub const number_of_handlers = Idt.number_of_handlers;
 
 const log = kernel.log.scoped(.interrupts_x86_64);
+const trace = kernel.trace.scoped(.interrupts);
 
 var idt: Idt = undefined;
 const raw_handlers = makeRawHandlers();
-var handlers = [_]InterruptHandler{unhandledInterrupt} ** number_of_handlers;
+var handlers = [_]Handler{.{ .function = unhandledInterrupt }} ** number_of_handlers;
 
-/// This function will load the IDT and fill the entries with raw handlers.
+/// Protects `allocated_vectors`.
+var allocation_lock: kernel.SpinLock = .{};
+
+/// Vectors in the allocatable range that have been handed out by `allocateVector`.
+var allocated_vectors = std.StaticBitSet(number_of_handlers).initEmpty();
+
+/// The range of vectors handed out by `allocateVector`, everything between the exceptions and the fixed vectors.
+const first_allocatable_vector = @intFromEnum(IdtVector._reserved8) + 1;
+const last_allocatable_vector = @intFromEnum(IdtVector.local_apic_timer) - 1;
+
+/// Loads the IDT on the current processor.
+///
+/// The IDT is shared by all processors.
 pub fn loadIdt() void {
     idt.load();
+}
 
+/// Fills the IDT entries with raw handlers.
+///
+/// Only called once on the bootstrap processor.
+pub fn initializeIdt() void {
     log.debug("mapping idt entries to raw handlers", .{});
     for (raw_handlers, 0..) |raw_handler, i| {
         idt.handlers[i].init(
@@ -32,11 +50,59 @@ pub fn loadIdt() void {
 pub const InterruptStackSelector = enum(u3) {
     exception = 0,
     double_fault = 1,
-    interrupt = 2,
-    non_maskable_interrupt = 3,
+    non_maskable_interrupt = 2,
 };
 
-pub const InterruptHandler = *const fn (interrupt_frame: *InterruptFrame) void;
+/// `context` is the pointer the handler was registered with.
+pub const InterruptHandler = *const fn (interrupt_frame: *InterruptFrame, context: ?*anyopaque) void;
+
+const Handler = struct {
+    function: InterruptHandler,
+    context: ?*anyopaque = null,
+};
+
+/// Sets the handler for the given interrupt vector.
+pub fn setHandler(vector: IdtVector, handler: InterruptHandler, context: ?*anyopaque) void {
+    handlers[@intFromEnum(vector)] = .{ .function = handler, .context = context };
+}
+
+/// Allocates a free vector and registers `handler` for it, for use by devices with configurable interrupt vectors
+/// such as MSI and MSI-X.
+///
+/// The lowest free vector is returned.
+pub fn allocateVector(handler: InterruptHandler, context: ?*anyopaque) error{NoFreeVectors}!IdtVector {
+    const held = allocation_lock.lock();
+    defer held.unlock();
+
+    for (first_allocatable_vector..last_allocatable_vector + 1) |vector_number| {
+        if (allocated_vectors.isSet(vector_number)) continue;
+
+        allocated_vectors.set(vector_number);
+
+        const vector: IdtVector = @enumFromInt(vector_number);
+        setHandler(vector, handler, context);
+        return vector;
+    }
+
+    return error.NoFreeVectors;
+}
+
+/// Frees a vector returned by `allocateVector`.
+///
+/// The device must no longer be able to raise the vector.
+pub fn freeVector(vector: IdtVector) void {
+    const vector_number = @intFromEnum(vector);
+
+    const held = allocation_lock.lock();
+    defer held.unlock();
+
+    if (!allocated_vectors.isSet(vector_number)) {
+        core.panicFmt("vector {d} freed but not allocated", .{vector_number});
+    }
+
+    setHandler(vector, unhandledInterrupt, null);
+    allocated_vectors.unset(vector_number);
+}
 
 /// Sets the interrupt stack for the given interrupt vector.
 pub fn setVectorStack(vector: IdtVector, stack_selector: InterruptStackSelector) void {
@@ -44,7 +110,8 @@ pub fn setVectorStack(vector: IdtVector, stack_selector: InterruptStackSelector)
 }
 
 /// Handles all interrupts by printing the vector and then panicking.
-fn unhandledInterrupt(interrupt_frame: *const InterruptFrame) void {
+fn unhandledInterrupt(interrupt_frame: *InterruptFrame, context: ?*anyopaque) void {
+    _ = context;
     const idt_vector = interrupt_frame.getIdtVector();
 
     // TODO: print specific things for each exception, especially page fault https://github.com/CascadeOS/CascadeOS/issues/32
@@ -55,7 +122,45 @@ fn unhandledInterrupt(interrupt_frame: *const InterruptFrame) void {
     core.panicFmt("interrupt {d}", .{@intFromEnum(idt_vector)}) catch unreachable;
 }
 
+/// Vectors whose raw handler calls their handler directly, skipping the lookup in `handlers`.
+///
+/// Used for the most frequent interrupts.
+const direct_handlers = [_]struct { vector: IdtVector, handler: InterruptHandler }{
+    .{ .vector = .local_apic_timer, .handler = x86_64.apic.timerInterruptHandler },
+    .{ .vector = .scheduler, .handler = x86_64.scheduling.schedulerInterruptHandler },
+    .{ .vector = .cross_call, .handler = crossCallInterruptHandler },
+    .{ .vector = .no_operation, .handler = noOperationHandler },
+};
+
+fn noOperationHandler(interrupt_frame: *InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+}
+
+/// Interrupts `processor` to handle the cross-processor calls queued for it.
+pub fn sendCrossCallInterrupt(processor: *kernel.Processor) void {
+    x86_64.apic.sendIpi(.{ .apic_id = processor.arch.apic_id }, .cross_call);
+}
+
+fn crossCallInterruptHandler(interrupt_frame: *InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+    x86_64.apic.endOfInterrupt();
+    kernel.cross_call.handleInterrupt();
+}
+
+/// Raises the `no_operation` vector, for measuring the cost of interrupt entry and exit.
+pub inline fn raiseNoOperationInterrupt() void {
+    asm volatile (std.fmt.comptimePrint("int ${d}", .{@intFromEnum(IdtVector.no_operation)}) ::: "memory");
+}
+
 /// Creates an array of raw interrupt handlers, one for each vector.
+///
+/// The raw handler of each vector pushes the vector number, and a dummy error code if the cpu does not push one, so
+/// every vector has the same frame layout.
+///
+/// Exceptions then jump to `exceptionTrampoline` and other interrupts to `interruptTrampoline`, vectors in
+/// `direct_handlers` instead save the registers and call their handler themselves.
 fn makeRawHandlers() [number_of_handlers](*const fn () callconv(.Naked) void) {
     var raw_handlers_temp: [number_of_handlers](*const fn () callconv(.Naked) void) = undefined;
 
@@ -64,83 +169,127 @@ fn makeRawHandlers() [number_of_handlers](*const fn () callconv(.Naked) void) {
         const vector_number: u8 = @intCast(i);
         const idt_vector: IdtVector = @enumFromInt(vector_number);
 
-        // if the cpu does not push an error code, we push a dummy error code to ensure the stack
-        // is always aligned in the same way for every vector
-        const need_to_push_dummy_error_code = comptime !idt_vector.hasErrorCode();
-
-        const error_code_asm = if (need_to_push_dummy_error_code) "push $0\n" else "";
-        const vector_number_asm = std.fmt.comptimePrint("push ${d}", .{vector_number});
-        const data_selector_asm = std.fmt.comptimePrint("mov ${d}, %%ax", .{x86_64.Gdt.kernel_data_selector});
+        const error_code_asm = if (comptime idt_vector.hasErrorCode()) "" else "push $0\n";
+        const vector_number_asm = std.fmt.comptimePrint("push ${d}\n", .{vector_number});
 
-        // we need to ensure that we have the same stack position upon `iret` as upon entry
-        // as we might push an error code the amount we need to bump the stack pointer by can change.
-        const pop_error_code_and_vector_asm = std.fmt.comptimePrint(
-            "add ${d}, %%rsp",
-            .{if (need_to_push_dummy_error_code) 2 * @sizeOf(usize) else @sizeOf(usize)},
-        );
+        const direct_handler: ?InterruptHandler = comptime blk: {
+            for (direct_handlers) |direct_handler| {
+                if (direct_handler.vector == idt_vector) break :blk direct_handler.handler;
+            }
+            break :blk null;
+        };
 
-        const rawInterruptHandler = struct {
+        raw_handlers_temp[vector_number] = if (direct_handler) |handler| struct {
+            fn rawInterruptHandler() callconv(.Naked) void {
+                asm volatile (error_code_asm ++ vector_number_asm ++ save_registers_asm ++
+                        \\call %[handler:P]
+                        \\
+                    ++ restore_registers_asm
+                    :
+                    : [handler] "X" (&DirectInterruptHandler(vector_number, handler).directInterruptHandler),
+                );
+            }
+        }.rawInterruptHandler else if (comptime idt_vector.isException() or idt_vector == .non_maskable_interrupt) struct {
+            fn rawInterruptHandler() callconv(.Naked) void {
+                asm volatile (error_code_asm ++ vector_number_asm ++
+                        \\jmp %[trampoline:P]
+                    :
+                    : [trampoline] "X" (&exceptionTrampoline),
+                );
+            }
+        }.rawInterruptHandler else struct {
             fn rawInterruptHandler() callconv(.Naked) void {
-                asm volatile (error_code_asm ++
-                        vector_number_asm ++ "\n" ++
-                        \\push %%rax
-                        \\push %%rbx
-                        \\push %%rcx
-                        \\push %%rdx
-                        \\push %%rbp
-                        \\push %%rsi
-                        \\push %%rdi
-                        \\push %%r8
-                        \\push %%r9
-                        \\push %%r10
-                        \\push %%r11
-                        \\push %%r12
-                        \\push %%r13
-                        \\push %%r14
-                        \\push %%r15
-                        \\mov %%ds, %%rax
-                        \\push %%rax
-                        \\mov %%es, %%rax
-                        \\push %%rax
-                        \\mov %%rsp, %%rdi
-                    ++ "\n" ++ data_selector_asm ++ "\n" ++
-                        \\mov %%ax, %%es
-                        \\mov %%ax, %%ds
-                        \\call interruptHandler
-                        \\pop %%rax
-                        \\mov %%rax, %%es
-                        \\pop %%rax
-                        \\mov %%rax, %%ds
-                        \\pop %%r15
-                        \\pop %%r14
-                        \\pop %%r13
-                        \\pop %%r12
-                        \\pop %%r11
-                        \\pop %%r10
-                        \\pop %%r9
-                        \\pop %%r8
-                        \\pop %%rdi
-                        \\pop %%rsi
-                        \\pop %%rbp
-                        \\pop %%rdx
-                        \\pop %%rcx
-                        \\pop %%rbx
-                        \\pop %%rax
-                    ++ "\n" ++ pop_error_code_and_vector_asm ++ "\n" ++
-                        \\iretq
+                asm volatile (error_code_asm ++ vector_number_asm ++
+                        \\jmp %[trampoline:P]
+                    :
+                    : [trampoline] "X" (&interruptTrampoline),
                 );
             }
         }.rawInterruptHandler;
-
-        raw_handlers_temp[vector_number] = rawInterruptHandler;
     }
 
     return raw_handlers_temp;
 }
 
+/// Shared by the raw handlers of exceptions and the non-maskable interrupt, which never switch tasks.
+fn exceptionTrampoline() callconv(.Naked) void {
+    asm volatile (save_registers_asm ++
+            \\call %[handler:P]
+            \\
+        ++ restore_registers_asm
+        :
+        : [handler] "X" (&exceptionHandler),
+    );
+}
+
+/// Shared by the raw handlers of every other interrupt.
+fn interruptTrampoline() callconv(.Naked) void {
+    asm volatile (save_registers_asm ++
+            \\call %[handler:P]
+            \\
+        ++ restore_registers_asm
+        :
+        : [handler] "X" (&interruptHandler),
+    );
+}
+
+/// Completes the `InterruptFrame` below the vector number and error code, then passes it as the first argument.
+///
+/// The segment registers are not touched, in 64-bit mode `ds` and `es` are ignored and the null selector the cpu
+/// loads into `ss` is valid.
+///
+/// `swapgs` is only needed when coming from user mode, which is checked using the privilege level of the saved `cs`.
+const save_registers_asm = std.fmt.comptimePrint(
+    \\testb $3, {d}(%%rsp)
+    \\jz 1f
+    \\swapgs
+    \\1:
+    \\push %%rax
+    \\push %%rbx
+    \\push %%rcx
+    \\push %%rdx
+    \\push %%rbp
+    \\push %%rsi
+    \\push %%rdi
+    \\push %%r8
+    \\push %%r9
+    \\push %%r10
+    \\push %%r11
+    \\push %%r12
+    \\push %%r13
+    \\push %%r14
+    \\push %%r15
+    \\mov %%rsp, %%rdi
+    \\
+, .{@offsetOf(InterruptFrame, "cs") - @offsetOf(InterruptFrame, "padded_vector_number")});
+
+/// Restores the registers saved by `save_registers_asm`, pops the vector number and error code then returns from the
+/// interrupt.
+const restore_registers_asm = std.fmt.comptimePrint(
+    \\pop %%r15
+    \\pop %%r14
+    \\pop %%r13
+    \\pop %%r12
+    \\pop %%r11
+    \\pop %%r10
+    \\pop %%r9
+    \\pop %%r8
+    \\pop %%rdi
+    \\pop %%rsi
+    \\pop %%rbp
+    \\pop %%rdx
+    \\pop %%rcx
+    \\pop %%rbx
+    \\pop %%rax
+    \\testb $3, {d}(%%rsp)
+    \\jz 1f
+    \\swapgs
+    \\1:
+    \\add $16, %%rsp
+    \\iretq
+, .{@offsetOf(InterruptFrame, "cs") - @offsetOf(InterruptFrame, "padded_vector_number")});
+
 pub const InterruptFrame = extern struct {
-    es: u64,
-    ds: u64,
     r15: u64,
     r14: u64,
     r13: u64,
@@ -188,12 +337,10 @@ pub const InterruptFrame = extern struct {
         try writer.writeAll("InterruptFrame{\n");
 
         try writer.print(padding ++ "Error Code: {},\n", .{value.error_code});
-        try writer.print(padding ++ "Vector Number: {},\n", .{value.vector_number});
+        try writer.print(padding ++ "Vector Number: {},\n", .{value.padded_vector_number});
 
         try writer.print(padding ++ "cs: {},\n", .{value.cs});
         try writer.print(padding ++ "ss: {},\n", .{value.ss});
-        try writer.print(padding ++ "ds: {},\n", .{value.ds});
-        try writer.print(padding ++ "es: {},\n", .{value.es});
         try writer.print(padding ++ "rsp: 0x{x},\n", .{value.rsp});
         try writer.print(padding ++ "rip: 0x{x},\n", .{value.rip});
         try writer.print(padding ++ "rax: 0x{x},\n", .{value.rax});
@@ -229,23 +376,105 @@ pub const InterruptFrame = extern struct {
     }
 };
 
-/// The main interrupt handler for the kernel.
-export fn interruptHandler(interrupt_frame: *InterruptFrame) void {
-    if (interrupt_frame.isUser()) {
-        // interrupt is from user code
-        asm volatile ("swapgs");
-    }
+/// Handles exceptions and the non-maskable interrupt.
+///
+/// These can occur at any point, including with preemption disabled or in the middle of a task switch, so they never
+/// switch tasks.
+///
+/// No statistics are recorded, exceptions can occur before the current processor is loaded.
+fn exceptionHandler(interrupt_frame: *InterruptFrame) callconv(.C) void {
+    const handler = handlers[@intFromEnum(interrupt_frame.getIdtVector())];
+    handler.function(interrupt_frame, handler.context);
+}
+
+/// Handles every interrupt that is not an exception or in `direct_handlers`.
+fn interruptHandler(interrupt_frame: *InterruptFrame) callconv(.C) void {
+    const vector_number = @intFromEnum(interrupt_frame.getIdtVector());
+    const handler = handlers[vector_number];
+    callHandlerWithStatistics(vector_number, handler.function, handler.context, interrupt_frame);
+    finishInterrupt(interrupt_frame);
+}
+
+fn DirectInterruptHandler(comptime vector_number: u8, comptime handler: InterruptHandler) type {
+    return struct {
+        fn directInterruptHandler(interrupt_frame: *InterruptFrame) callconv(.C) void {
+            callHandlerWithStatistics(vector_number, handler, null, interrupt_frame);
+            finishInterrupt(interrupt_frame);
+        }
+    };
+}
 
-    handlers[@as(u8, @intCast(interrupt_frame.padded_vector_number))](interrupt_frame);
+/// Calls `handler`, counting the interrupt and the cycles spent in the handler against the current processor.
+///
+/// Interrupts are disabled on entry and the task cannot be switched until `finishInterrupt`, so the statistics
+/// belong to the executing processor for the whole call and can be updated without atomics.
+inline fn callHandlerWithStatistics(
+    vector_number: u8,
+    handler: InterruptHandler,
+    context: ?*anyopaque,
+    interrupt_frame: *InterruptFrame,
+) void {
+    const statistics = &x86_64.getProcessor().arch.interrupt_statistics[vector_number];
+
+    trace.begin(.handler, .{vector_number});
+    defer trace.end(.handler, .{vector_number});
+
+    const start = x86_64.instructions.readTimestampCounter();
+    handler(interrupt_frame, context);
+    statistics.cycles += x86_64.instructions.readTimestampCounter() - start;
+    statistics.count += 1;
+}
 
-    x86_64.interrupts.disableInterrupts();
+/// Per-processor, per-vector interrupt statistics.
+///
+/// Only updated by the processor they belong to, reads from other processors may see slightly stale values.
+pub const VectorStatistics = struct {
+    /// The number of times the vector has been handled.
+    count: u64 = 0,
+
+    /// The total timestamp counter ticks spent in the handler of the vector.
+    cycles: u64 = 0,
+};
 
-    if (interrupt_frame.isUser()) {
-        // returning to user code
-        asm volatile ("swapgs");
+pub const ProcessorStatistics = [number_of_handlers]VectorStatistics;
+
+/// Logs the statistics of every vector that has been handled, per processor.
+pub fn logStatistics() void {
+    for (0..number_of_handlers) |vector_number| {
+        for (kernel.Processor.all) |*processor| {
+            const statistics = &processor.arch.interrupt_statistics[vector_number];
+
+            const count = @atomicLoad(u64, &statistics.count, .Monotonic);
+            if (count == 0) continue;
+            const cycles = @atomicLoad(u64, &statistics.cycles, .Monotonic);
+
+            log.info("vector 0x{x:0>2} on processor {}: {} interrupts, {} cycles, {} cycles per interrupt", .{
+                vector_number,
+                @intFromEnum(processor.id),
+                count,
+                cycles,
+                cycles / count,
+            });
+        }
     }
 }
 
+/// Interrupts run on the stack of the interrupted task, so they can run deferred work and switch tasks before
+/// returning.
+///
+/// Only done if the interrupted code had interrupts enabled, a vector raised by an `int` instruction, such as
+/// `no_operation`, is delivered regardless and may have interrupted a critical section.
+inline fn finishInterrupt(interrupt_frame: *const InterruptFrame) void {
+    // in case the handler enabled interrupts
+    disableInterrupts();
+
+    if (!interrupt_frame.rflags.interrupt) return;
+
+    kernel.deferred.runFromInterrupt();
+
+    kernel.scheduler.preemptFromInterrupt();
+}
+
 pub const IdtVector = enum(u8) {
     /// Occurs when dividing any number by 0 using the DIV or IDIV instruction, or when the division result is too
     /// large to be represented in the destination.
@@ -411,6 +640,26 @@ pub const IdtVector = enum(u8) {
 
     _reserved8 = 0x1F,
 
+    /// Raised by the local APIC timer when it expires.
+    local_apic_timer = 0xEC,
+
+    /// Sent to a processor to make it handle the cross-processor calls queued for it.
+    cross_call = 0xFB,
+
+    /// Raised by `raiseNoOperationInterrupt`, does nothing.
+    no_operation = 0xFC,
+
+    /// Sent to a processor to make it re-evaluate which task it should be running.
+    scheduler = 0xFD,
+
+    /// Raised by the local APIC when it detects an error.
+    local_apic_error = 0xFE,
+
+    /// Raised by the local APIC when an interrupt is withdrawn before it could be delivered.
+    ///
+    /// Must not be acknowledged with an end of interrupt.
+    spurious_interrupt = 0xFF,
+
     _,
 
     /// Checks if the given interrupt vector is an exception.
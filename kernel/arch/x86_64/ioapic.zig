@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+
+//! I/O APIC driver.
+//!
+//! Only what is needed to route legacy ISA interrupts is implemented. As the MADT is not yet parsed, a single I/O APIC
+//! is assumed to be at the standard address handling global system interrupts from zero, with ISA interrupts mapped
+//! to the global system interrupt of the same number.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.ioapic);
+
+const IdtVector = x86_64.interrupts.IdtVector;
+
+const standard_base = kernel.PhysicalAddress.fromInt(0xFEC0_0000);
+
+/// The virtual address of the I/O APIC MMIO registers.
+var base: kernel.VirtualAddress = undefined;
+
+/// The number of redirection entries, zero if there is no I/O APIC.
+var number_of_entries: u32 = 0;
+
+/// Serializes access to the register select and window registers.
+var lock: kernel.SpinLock = .{};
+
+/// Masks every interrupt of the I/O APIC and the legacy PICs.
+///
+/// Only called once during `setup`, after virtual memory is initialized.
+pub fn init() void {
+    maskLegacyPics();
+
+    base = standard_base.toNonCachedDirectMap();
+
+    const version = readRegister(register_version);
+    if (version == std.math.maxInt(u32)) {
+        log.warn("no I/O APIC at {}", .{standard_base});
+        return;
+    }
+
+    number_of_entries = ((version >> 16) & 0xFF) + 1;
+
+    for (0..number_of_entries) |entry| writeRedirectionEntry(@intCast(entry), redirection_masked);
+
+    log.debug("I/O APIC has {} redirection entries", .{number_of_entries});
+}
+
+/// Returns true if `init` found an I/O APIC.
+pub fn isAvailable() bool {
+    return number_of_entries != 0;
+}
+
+/// Routes the ISA interrupt `isa_interrupt` to `vector` on the processor with the APIC id `apic_id` and unmasks it.
+///
+/// ISA interrupts are edge triggered and active high.
+pub fn routeIsaInterrupt(isa_interrupt: u8, vector: IdtVector, apic_id: u32) void {
+    if (isa_interrupt >= number_of_entries) {
+        core.panicFmt("ISA interrupt {} is not handled by the I/O APIC", .{isa_interrupt});
+    }
+
+    // physical destination mode only has room for an 8-bit APIC id
+    if (apic_id > std.math.maxInt(u8)) core.panicFmt("APIC id {} cannot be an I/O APIC destination", .{apic_id});
+
+    writeRedirectionEntry(isa_interrupt, @as(u64, apic_id) << 56 | @intFromEnum(vector));
+}
+
+fn writeRedirectionEntry(entry: u8, value: u64) void {
+    const register = register_redirection_table + @as(u32, entry) * 2;
+
+    // the high half holds the destination, written first so the entry is never unmasked with a stale destination
+    writeRegister(register + 1, @truncate(value >> 32));
+    writeRegister(register, @truncate(value));
+}
+
+fn readRegister(register: u32) u32 {
+    const held = lock.lock();
+    defer held.unlock();
+
+    registerSelect().* = register;
+    return registerWindow().*;
+}
+
+fn writeRegister(register: u32, value: u32) void {
+    const held = lock.lock();
+    defer held.unlock();
+
+    registerSelect().* = register;
+    registerWindow().* = value;
+}
+
+inline fn registerSelect() *volatile u32 {
+    return base.toPtr(*volatile u32);
+}
+
+inline fn registerWindow() *volatile u32 {
+    return base.moveForward(core.Size.from(0x10, .byte)).toPtr(*volatile u32);
+}
+
+/// Masks every interrupt of the legacy PICs, so they cannot raise the vectors they were left on by the firmware.
+fn maskLegacyPics() void {
+    x86_64.instructions.portWriteU8(0x21, 0xFF);
+    x86_64.instructions.portWriteU8(0xA1, 0xFF);
+}
+
+const register_version = 0x01;
+const register_redirection_table = 0x10;
+
+const redirection_masked: u64 = 1 << 16;
@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: MIT
+
+//! Memory copy and fill routines, including the `memcpy` and `memset` called by compiler generated code.
+//!
+//! Each routine has a baseline implementation and implementations for processors with faster string instructions,
+//! selected by `alternatives.apply`.
+//!
+//! The kernel does not use vector registers, so copies and fills larger than `short_length` always use string
+//! instructions, which move a cache line at a time on every processor with ERMS.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const Alternative = x86_64.alternatives.Alternative;
+
+const page_size = x86_64.paging.small_page_size.bytes;
+
+pub const Page = [page_size]u8;
+
+const CopyFunction = fn (destination: usize, source: usize, length: usize) void;
+const FillFunction = fn (destination: usize, value: u8, length: usize) void;
+const ZeroPageFunction = fn (page: *align(page_size) Page) void;
+
+pub var copy_alternative = Alternative(CopyFunction).init(&copyQuadwords, &.{
+    .{ .name = "rep movsb", .requires = &.{.fsrm}, .function = &copyBytes },
+    .{ .name = "rep movsb above short length", .requires = &.{.erms}, .function = &copyBytesAboveShortLength },
+});
+
+pub var fill_alternative = Alternative(FillFunction).init(&fillQuadwords, &.{
+    .{ .name = "rep stosb above short length", .requires = &.{.erms}, .function = &fillBytesAboveShortLength },
+});
+
+pub var zero_page_alternative = Alternative(ZeroPageFunction).init(&zeroPageQuadwords, &.{
+    .{ .name = "rep stosb", .requires = &.{.erms}, .function = &zeroPageBytes },
+});
+
+export fn memcpy(noalias destination: ?[*]u8, noalias source: ?[*]const u8, length: usize) callconv(.C) ?[*]u8 {
+    copy_alternative.function(@intFromPtr(destination), @intFromPtr(source), length);
+    return destination;
+}
+
+export fn memset(destination: ?[*]u8, value: u8, length: usize) callconv(.C) ?[*]u8 {
+    fill_alternative.function(@intFromPtr(destination), value, length);
+    return destination;
+}
+
+/// Fills `page` with zeroes.
+pub inline fn zeroPage(page: *align(page_size) Page) void {
+    zero_page_alternative.function(page);
+}
+
+/// Copies `source` to `destination`.
+pub inline fn copyPage(destination: *align(page_size) Page, source: *align(page_size) const Page) void {
+    copy_alternative.function(@intFromPtr(destination), @intFromPtr(source), page_size);
+}
+
+/// Fills `page` with zeroes using non-temporal stores, which bypass the cache.
+///
+/// Avoids evicting data in use for a page that will not be accessed soon, but is slower to access afterwards than a
+/// page zeroed by `zeroPage`.
+pub fn zeroPageNonTemporal(page: *align(page_size) Page) void {
+    asm volatile (
+        \\1:
+        \\movnti %%rax, 0(%%rdi)
+        \\movnti %%rax, 8(%%rdi)
+        \\movnti %%rax, 16(%%rdi)
+        \\movnti %%rax, 24(%%rdi)
+        \\movnti %%rax, 32(%%rdi)
+        \\movnti %%rax, 40(%%rdi)
+        \\movnti %%rax, 48(%%rdi)
+        \\movnti %%rax, 56(%%rdi)
+        \\add $64, %%rdi
+        \\sub $64, %%rcx
+        \\jnz 1b
+        \\sfence
+        :
+        : [destination] "{rdi}" (page),
+          [value] "{rax}" (@as(u64, 0)),
+          [length] "{rcx}" (@as(usize, page_size)),
+        : "rdi", "rcx", "cc", "memory"
+    );
+}
+
+/// Copies `source` to `destination` using non-temporal stores, which bypass the cache.
+///
+/// Avoids evicting data in use for a page that will not be accessed soon, but is slower to access afterwards than a
+/// page copied by `copyPage`.
+pub fn copyPageNonTemporal(destination: *align(page_size) Page, source: *align(page_size) const Page) void {
+    asm volatile (
+        \\1:
+        \\mov 0(%%rsi), %%r8
+        \\mov 8(%%rsi), %%r9
+        \\mov 16(%%rsi), %%r10
+        \\mov 24(%%rsi), %%r11
+        \\movnti %%r8, 0(%%rdi)
+        \\movnti %%r9, 8(%%rdi)
+        \\movnti %%r10, 16(%%rdi)
+        \\movnti %%r11, 24(%%rdi)
+        \\mov 32(%%rsi), %%r8
+        \\mov 40(%%rsi), %%r9
+        \\mov 48(%%rsi), %%r10
+        \\mov 56(%%rsi), %%r11
+        \\movnti %%r8, 32(%%rdi)
+        \\movnti %%r9, 40(%%rdi)
+        \\movnti %%r10, 48(%%rdi)
+        \\movnti %%r11, 56(%%rdi)
+        \\add $64, %%rsi
+        \\add $64, %%rdi
+        \\sub $64, %%rcx
+        \\jnz 1b
+        \\sfence
+        :
+        : [destination] "{rdi}" (destination),
+          [source] "{rsi}" (source),
+          [length] "{rcx}" (@as(usize, page_size)),
+        : "rdi", "rsi", "rcx", "r8", "r9", "r10", "r11", "cc", "memory"
+    );
+}
+
+/// Copies and fills of at most this many bytes use `copyShort` and `fillShort` rather than string instructions,
+/// which have a startup cost that dominates short lengths unless the processor has FSRM.
+const short_length = 32;
+
+/// Copies at most `short_length` bytes with a pair of possibly overlapping loads and stores for each power of two.
+inline fn copyShort(destination: usize, source: usize, length: usize) void {
+    if (length >= 16) {
+        const head_low = load(u64, source);
+        const head_high = load(u64, source + 8);
+        const tail_low = load(u64, source + length - 16);
+        const tail_high = load(u64, source + length - 8);
+        store(u64, destination, head_low);
+        store(u64, destination + 8, head_high);
+        store(u64, destination + length - 16, tail_low);
+        store(u64, destination + length - 8, tail_high);
+    } else if (length >= 8) {
+        const head = load(u64, source);
+        const tail = load(u64, source + length - 8);
+        store(u64, destination, head);
+        store(u64, destination + length - 8, tail);
+    } else if (length >= 4) {
+        const head = load(u32, source);
+        const tail = load(u32, source + length - 4);
+        store(u32, destination, head);
+        store(u32, destination + length - 4, tail);
+    } else if (length >= 2) {
+        const head = load(u16, source);
+        const tail = load(u16, source + length - 2);
+        store(u16, destination, head);
+        store(u16, destination + length - 2, tail);
+    } else if (length == 1) {
+        store(u8, destination, load(u8, source));
+    }
+}
+
+/// Fills at most `short_length` bytes with possibly overlapping stores.
+inline fn fillShort(destination: usize, value: u8, length: usize) void {
+    const quadword = @as(u64, value) * 0x0101010101010101;
+
+    if (length >= 16) {
+        store(u64, destination, quadword);
+        store(u64, destination + 8, quadword);
+        store(u64, destination + length - 16, quadword);
+        store(u64, destination + length - 8, quadword);
+    } else if (length >= 8) {
+        store(u64, destination, quadword);
+        store(u64, destination + length - 8, quadword);
+    } else if (length >= 4) {
+        store(u32, destination, @truncate(quadword));
+        store(u32, destination + length - 4, @truncate(quadword));
+    } else if (length >= 2) {
+        store(u16, destination, @truncate(quadword));
+        store(u16, destination + length - 2, @truncate(quadword));
+    } else if (length == 1) {
+        store(u8, destination, value);
+    }
+}
+
+inline fn load(comptime T: type, address: usize) T {
+    return @as(*align(1) const T, @ptrFromInt(address)).*;
+}
+
+inline fn store(comptime T: type, address: usize, value: T) void {
+    @as(*align(1) T, @ptrFromInt(address)).* = value;
+}
+
+fn copyBytesAboveShortLength(destination: usize, source: usize, length: usize) void {
+    if (length <= short_length) return copyShort(destination, source, length);
+    copyBytes(destination, source, length);
+}
+
+fn fillBytesAboveShortLength(destination: usize, value: u8, length: usize) void {
+    if (length <= short_length) return fillShort(destination, value, length);
+    fillBytes(destination, value, length);
+}
+
+/// Copies short lengths with `copyShort`, otherwise eight bytes at a time then the remaining bytes one at a time.
+fn copyQuadwords(destination: usize, source: usize, length: usize) void {
+    if (length <= short_length) return copyShort(destination, source, length);
+
+    asm volatile (
+        \\rep movsq
+        \\mov %[remainder], %%rcx
+        \\rep movsb
+        :
+        : [destination] "{rdi}" (destination),
+          [source] "{rsi}" (source),
+          [quadwords] "{rcx}" (length / 8),
+          [remainder] "r" (length % 8),
+        : "rdi", "rsi", "rcx", "memory"
+    );
+}
+
+/// Copies with a single `rep movsb`, which processors with ERMS perform a cache line at a time and processors with
+/// FSRM start quickly enough to use for every length.
+fn copyBytes(destination: usize, source: usize, length: usize) void {
+    asm volatile ("rep movsb"
+        :
+        : [destination] "{rdi}" (destination),
+          [source] "{rsi}" (source),
+          [length] "{rcx}" (length),
+        : "rdi", "rsi", "rcx", "memory"
+    );
+}
+
+/// Fills short lengths with `fillShort`, otherwise eight bytes at a time then the remaining bytes one at a time.
+fn fillQuadwords(destination: usize, value: u8, length: usize) void {
+    if (length <= short_length) return fillShort(destination, value, length);
+
+    asm volatile (
+        \\rep stosq
+        \\mov %[remainder], %%rcx
+        \\rep stosb
+        :
+        : [destination] "{rdi}" (destination),
+          [value] "{rax}" (@as(u64, value) * 0x0101010101010101),
+          [quadwords] "{rcx}" (length / 8),
+          [remainder] "r" (length % 8),
+        : "rdi", "rcx", "memory"
+    );
+}
+
+/// Fills with a single `rep stosb`, which processors with ERMS perform a cache line at a time.
+fn fillBytes(destination: usize, value: u8, length: usize) void {
+    asm volatile ("rep stosb"
+        :
+        : [destination] "{rdi}" (destination),
+          [value] "{al}" (value),
+          [length] "{rcx}" (length),
+        : "rdi", "rcx", "memory"
+    );
+}
+
+fn zeroPageQuadwords(page: *align(page_size) Page) void {
+    asm volatile ("rep stosq"
+        :
+        : [destination] "{rdi}" (page),
+          [value] "{rax}" (@as(u64, 0)),
+          [quadwords] "{rcx}" (page_size / 8),
+        : "rdi", "rcx", "memory"
+    );
+}
+
+fn zeroPageBytes(page: *align(page_size) Page) void {
+    asm volatile ("rep stosb"
+        :
+        : [destination] "{rdi}" (page),
+          [value] "{al}" (@as(u8, 0)),
+          [length] "{rcx}" (@as(usize, page_size)),
+        : "rdi", "rcx", "memory"
+    );
+}
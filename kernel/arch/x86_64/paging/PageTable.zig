@@ -18,8 +18,7 @@ pub const PageTable = extern struct {
     pub const number_of_entries = 512;
 
     pub fn zero(self: *PageTable) void {
-        const bytes = std.mem.asBytes(self);
-        @memset(bytes, 0);
+        x86_64.memory.zeroPage(std.mem.asBytes(self));
     }
 
     pub fn getEntryLevel4(self: *PageTable, virtual_address: kernel.VirtualAddress) *Entry {
@@ -205,6 +205,70 @@ pub fn mapRangeUseAllPageSizes(
     );
 }
 
+/// Unmaps the 4 KiB pages in `virtual_range`, pages that are not mapped are skipped.
+///
+/// Neither the page tables nor the physical pages are freed and the TLB is not flushed.
+pub fn unmapRange(page_table: *PageTable, virtual_range: kernel.VirtualRange) void {
+    log.debug("unmapRange - {}", .{virtual_range});
+
+    var current_virtual_address = virtual_range.address;
+    const end_virtual_address = virtual_range.end();
+
+    while (current_virtual_address.lessThan(end_virtual_address)) : (current_virtual_address.moveForwardInPlace(small_page_size)) {
+        const entry = getEntry4KiB(page_table, current_virtual_address) orelse continue;
+        entry._backing = 0;
+    }
+}
+
+/// Returns the physical address `virtual_address` is mapped to by a 4 KiB page, null if it is not mapped.
+pub fn translate(page_table: *PageTable, virtual_address: kernel.VirtualAddress) ?kernel.PhysicalAddress {
+    const entry = getEntry4KiB(page_table, virtual_address) orelse return null;
+    if (!entry.present.read()) return null;
+
+    return entry.getAddress4kib().moveForward(
+        core.Size.from(virtual_address.value & (small_page_size.bytes - 1), .byte),
+    );
+}
+
+/// Returns the level 1 entry for `virtual_address`, null if a level above it is not present.
+fn getEntry4KiB(level4_table: *PageTable, virtual_address: kernel.VirtualAddress) ?*PageTable.Entry {
+    var table = level4_table;
+
+    inline for (.{ PageTable.getEntryLevel4, PageTable.getEntryLevel3, PageTable.getEntryLevel2 }) |getEntry| {
+        table = getEntry(table, virtual_address).getNextLevel() catch |err| switch (err) {
+            error.NotPresent => return null,
+            error.HugePage => core.panicFmt("{} is mapped by a large page", .{virtual_address}),
+        };
+    }
+
+    return table.getEntryLevel1(virtual_address);
+}
+
+/// Invalidates the TLB entries of the executing processor for `virtual_range`.
+pub fn flushRange(virtual_range: kernel.VirtualRange) void {
+    var current_virtual_address = virtual_range.address;
+    const end_virtual_address = virtual_range.end();
+
+    while (current_virtual_address.lessThan(end_virtual_address)) : (current_virtual_address.moveForwardInPlace(small_page_size)) {
+        x86_64.instructions.invalidatePage(current_virtual_address);
+    }
+}
+
+/// Invalidates every TLB entry of the executing processor, including global ones.
+pub fn flushAll() void {
+    var cr4 = x86_64.registers.Cr4.read();
+
+    if (cr4.page_global_enable) {
+        // toggling global pages flushes the entire TLB
+        cr4.page_global_enable = false;
+        cr4.write();
+        cr4.page_global_enable = true;
+        cr4.write();
+    } else {
+        x86_64.registers.Cr3.writeAddress(x86_64.registers.Cr3.readAddress());
+    }
+}
+
 /// Maps a 4 KiB page.
 fn mapTo4KiB(
     level4_table: *PageTable,
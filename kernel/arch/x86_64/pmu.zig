@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: MIT
+
+//! Performance monitoring unit.
+//!
+//! Only architectural performance monitoring is supported.
+//!
+//! General purpose counter 0 is used for sampling, it counts unhalted core cycles and its overflow is delivered as a
+//! non-maskable interrupt on the dedicated interrupt stack, so code running with interrupts disabled is sampled as
+//! well.
+//!
+//! The counters after it count the events of `kernel.performance_counters`, each event has a fixed counter so they can
+//! all be read without reprogramming anything.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.pmu);
+
+/// The architectural performance monitoring events, the value is the bit of the event in
+/// `x86_64.info.architectural_events`.
+pub const ArchitecturalEvent = enum(u5) {
+    unhalted_core_cycles = 0,
+    instructions_retired = 1,
+    unhalted_reference_cycles = 2,
+    last_level_cache_references = 3,
+    last_level_cache_misses = 4,
+    branch_instructions_retired = 5,
+    branch_misses_retired = 6,
+
+    pub fn isAvailable(self: ArchitecturalEvent) bool {
+        return x86_64.info.performance_monitoring_version != 0 and
+            x86_64.info.architectural_events & (@as(u32, 1) << @intFromEnum(self)) != 0;
+    }
+
+    /// The event select and unit mask of the event.
+    fn selector(self: ArchitecturalEvent) u64 {
+        return switch (self) {
+            .unhalted_core_cycles => 0x003C,
+            .instructions_retired => 0x00C0,
+            .unhalted_reference_cycles => 0x013C,
+            .last_level_cache_references => 0x4F2E,
+            .last_level_cache_misses => 0x412E,
+            .branch_instructions_retired => 0x00C4,
+            .branch_misses_retired => 0x00C5,
+        };
+    }
+};
+
+const sampling_counter = 0;
+
+/// The events counted for `kernel.performance_counters`, each uses the general purpose counter at its index plus one.
+///
+/// Events without an architectural equivalent, such as data TLB misses, are not counted.
+const counted_events = [_]struct {
+    event: kernel.performance_counters.Event,
+    architectural_event: ArchitecturalEvent,
+}{
+    .{ .event = .instructions, .architectural_event = .instructions_retired },
+    .{ .event = .last_level_cache_misses, .architectural_event = .last_level_cache_misses },
+    .{ .event = .branch_misses, .architectural_event = .branch_misses_retired },
+};
+
+/// Returns true if `startSampling` can be used.
+pub fn isSamplingAvailable() bool {
+    return x86_64.info.number_of_performance_counters > sampling_counter and
+        ArchitecturalEvent.unhalted_core_cycles.isAvailable();
+}
+
+/// Starts calling `kernel.profiler.recordSample` every `period` unhalted core cycles on the executing processor.
+///
+/// The period is limited to what can be written to the counter, `maximum_sampling_period`.
+pub fn startSampling(period: u64) void {
+    const processor = x86_64.getProcessor();
+
+    const clamped_period = std.math.clamp(period, 1, maximum_sampling_period);
+
+    x86_64.registers.IA32_PERFEVTSEL(sampling_counter).write(0);
+
+    processor.arch.sampling_period = clamped_period;
+    armSamplingCounter(clamped_period);
+
+    x86_64.apic.enablePerformanceCounterInterrupt();
+
+    x86_64.registers.IA32_PERFEVTSEL(sampling_counter).write(
+        ArchitecturalEvent.unhalted_core_cycles.selector() | event_select_user | event_select_kernel |
+            event_select_interrupt | event_select_enable,
+    );
+
+    enableGlobally(counterBit(sampling_counter));
+}
+
+/// Stops the sampling started by `startSampling` on the executing processor.
+pub fn stopSampling() void {
+    const processor = x86_64.getProcessor();
+
+    x86_64.registers.IA32_PERFEVTSEL(sampling_counter).write(0);
+    x86_64.apic.disablePerformanceCounterInterrupt();
+
+    if (x86_64.info.performance_monitoring_version >= 2) {
+        x86_64.registers.IA32_PERF_GLOBAL_OVF_CTRL.write(counterBit(sampling_counter));
+    }
+
+    processor.arch.sampling_period = 0;
+}
+
+/// Handles the non-maskable interrupt, which is only expected as the overflow of the sampling counter.
+pub fn nonMaskableInterruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = context;
+
+    const processor = x86_64.getProcessor();
+
+    const period = processor.arch.sampling_period;
+    if (period == 0 or !hasSamplingCounterOverflowed()) core.panic("unexpected non-maskable interrupt");
+
+    // the stack of user mode code cannot be trusted
+    kernel.profiler.recordSample(.{
+        .instruction_pointer = interrupt_frame.rip,
+        .stack_pointer = interrupt_frame.rsp,
+        .frame_pointer = interrupt_frame.rbp,
+    }, interrupt_frame.isKernel());
+
+    armSamplingCounter(period);
+
+    if (x86_64.info.performance_monitoring_version >= 2) {
+        x86_64.registers.IA32_PERF_GLOBAL_OVF_CTRL.write(counterBit(sampling_counter));
+    }
+
+    x86_64.apic.enablePerformanceCounterInterrupt();
+}
+
+/// Returns true if `event` is counted once `enableCounting` has been called.
+pub fn isEventSupported(event: kernel.performance_counters.Event) bool {
+    inline for (counted_events, 0..) |counted_event, i| {
+        if (counted_event.event == event) {
+            return x86_64.info.number_of_performance_counters > i + 1 and
+                counted_event.architectural_event.isAvailable();
+        }
+    }
+    return false;
+}
+
+/// Starts counting every supported event on the executing processor, from zero.
+pub fn enableCounting() void {
+    var enabled_counters: u64 = 0;
+
+    inline for (counted_events, 0..) |counted_event, i| {
+        if (isEventSupported(counted_event.event)) {
+            const counter = i + 1;
+
+            x86_64.registers.IA32_PERFEVTSEL(counter).write(0);
+            x86_64.registers.IA32_PMC(counter).write(0);
+            x86_64.registers.IA32_PERFEVTSEL(counter).write(
+                counted_event.architectural_event.selector() | event_select_user | event_select_kernel |
+                    event_select_enable,
+            );
+
+            enabled_counters |= counterBit(counter);
+        }
+    }
+
+    enableGlobally(enabled_counters);
+}
+
+/// Reads the count of `event` on the executing processor.
+///
+/// `event` must be supported and counting must be enabled.
+pub fn readCounter(event: kernel.performance_counters.Event) u64 {
+    inline for (counted_events, 0..) |counted_event, i| {
+        if (counted_event.event == event) return x86_64.instructions.readPerformanceCounter(i + 1);
+    }
+    unreachable;
+}
+
+/// Architectural performance monitoring version 2 added a global enable for each counter.
+fn enableGlobally(counters: u64) void {
+    if (x86_64.info.performance_monitoring_version < 2) return;
+    x86_64.registers.IA32_PERF_GLOBAL_CTRL.write(x86_64.registers.IA32_PERF_GLOBAL_CTRL.read() | counters);
+}
+
+/// Sets the sampling counter to overflow after `period` events.
+fn armSamplingCounter(period: u64) void {
+    // the low 32 bits written are sign extended to the width of the counter
+    x86_64.registers.IA32_PMC(sampling_counter).write(@bitCast(-@as(i64, @intCast(period))));
+}
+
+fn hasSamplingCounterOverflowed() bool {
+    if (x86_64.info.performance_monitoring_version >= 2) {
+        return x86_64.registers.IA32_PERF_GLOBAL_STATUS.read() & counterBit(sampling_counter) != 0;
+    }
+
+    // the counter was armed negative, so it has overflowed once its top bit is clear
+    const top_bit = @as(u64, 1) << @intCast(x86_64.info.performance_counter_width - 1);
+    return x86_64.registers.IA32_PMC(sampling_counter).read() & top_bit == 0;
+}
+
+/// The bit of general purpose counter `counter` in the global control and status registers.
+inline fn counterBit(comptime counter: u32) u64 {
+    return @as(u64, 1) << counter;
+}
+
+/// The largest period that can be written to a counter, see `x86_64.registers.IA32_PMC`.
+const maximum_sampling_period = std.math.maxInt(i32);
+
+const event_select_user: u64 = 1 << 16;
+const event_select_kernel: u64 = 1 << 17;
+const event_select_interrupt: u64 = 1 << 20;
+const event_select_enable: u64 = 1 << 22;
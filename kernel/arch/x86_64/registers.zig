@@ -167,6 +167,112 @@ pub const Cr3 = struct {
     }
 };
 
+pub const Cr4 = packed struct(u64) {
+    // TODO: Add field level documentation
+
+    virtual_8086_mode_extensions: bool,
+
+    protected_mode_virtual_interrupts: bool,
+
+    time_stamp_disable: bool,
+
+    debugging_extensions: bool,
+
+    page_size_extensions: bool,
+
+    physical_address_extension: bool,
+
+    machine_check_enable: bool,
+
+    page_global_enable: bool,
+
+    performance_monitoring_counter_enable: bool,
+
+    /// Enables the FXSAVE and FXRSTOR instructions to save and restore SSE state.
+    os_fxsave_fxrstor_support: bool,
+
+    /// Enables unmasked SSE exceptions to raise the SIMD floating point exception.
+    os_unmasked_simd_floating_point_exceptions: bool,
+
+    user_mode_instruction_prevention: bool,
+
+    level_5_paging: bool,
+
+    virtual_machine_extensions_enable: bool,
+
+    safer_mode_extensions_enable: bool,
+
+    _reserved15: u1,
+
+    fsgsbase_enable: bool,
+
+    pcid_enable: bool,
+
+    /// Enables the XSAVE family of instructions and the XCR0 register.
+    os_xsave_enable: bool,
+
+    _reserved19: u1,
+
+    supervisor_mode_execution_prevention: bool,
+
+    supervisor_mode_access_prevention: bool,
+
+    protection_key_enable: bool,
+
+    control_flow_enforcement_technology: bool,
+
+    protection_keys_for_supervisor_mode: bool,
+
+    _reserved25_63: u39,
+
+    pub fn read() Cr4 {
+        return @bitCast(asm ("mov %%cr4, %[value]"
+            : [value] "=r" (-> u64),
+        ));
+    }
+
+    pub fn write(self: Cr4) void {
+        asm volatile ("mov %[value], %%cr4"
+            :
+            : [value] "r" (@as(u64, @bitCast(self))),
+        );
+    }
+
+    pub const format = core.formatStructIgnoreReserved;
+};
+
+/// Extended Control Register 0 (XCR0), selects the state components managed by the XSAVE family of instructions.
+pub const XCR0 = struct {
+    pub const x87: u64 = 1 << 0;
+    pub const sse: u64 = 1 << 1;
+    pub const avx: u64 = 1 << 2;
+    pub const avx512_opmask: u64 = 1 << 5;
+    pub const avx512_zmm_high256: u64 = 1 << 6;
+    pub const avx512_high16_zmm: u64 = 1 << 7;
+
+    pub const avx512 = avx512_opmask | avx512_zmm_high256 | avx512_high16_zmm;
+
+    pub inline fn read() u64 {
+        var low: u32 = undefined;
+        var high: u32 = undefined;
+        asm volatile ("xgetbv"
+            : [low] "={eax}" (low),
+              [high] "={edx}" (high),
+            : [register] "{ecx}" (@as(u32, 0)),
+        );
+        return (@as(u64, high) << 32) | low;
+    }
+
+    pub inline fn write(value: u64) void {
+        asm volatile ("xsetbv"
+            :
+            : [register] "{ecx}" (@as(u32, 0)),
+              [low] "{eax}" (@as(u32, @truncate(value))),
+              [high] "{edx}" (@as(u32, @truncate(value >> 32))),
+        );
+    }
+};
+
 /// Extended Feature Enable Register (EFER)
 pub const EFER = packed struct(u64) {
     // TODO: Add field level documentation
@@ -218,6 +324,86 @@ pub const EFER = packed struct(u64) {
     pub const format = core.formatStructIgnoreReserved;
 };
 
+/// The local APIC base address and mode.
+pub const IA32_APIC_BASE = packed struct(u64) {
+    _reserved0_7: u8,
+
+    /// Set if this is the bootstrap processor.
+    bootstrap_processor: bool,
+
+    _reserved9: u1,
+
+    /// Enables x2APIC mode, the local APIC registers are then accessed through MSRs rather than MMIO.
+    ///
+    /// Can only be set if `apic_global_enable` is also set.
+    x2apic_enable: bool,
+
+    apic_global_enable: bool,
+
+    /// The physical page number of the xAPIC MMIO registers.
+    apic_base_page: u40,
+
+    _reserved52_63: u12,
+
+    pub inline fn read() IA32_APIC_BASE {
+        return @bitCast(msr.read());
+    }
+
+    pub inline fn write(self: IA32_APIC_BASE) void {
+        msr.write(@bitCast(self));
+    }
+
+    /// Returns the physical address of the xAPIC MMIO registers.
+    pub fn baseAddress(self: IA32_APIC_BASE) kernel.PhysicalAddress {
+        return kernel.PhysicalAddress.fromInt(@as(u64, self.apic_base_page) << 12);
+    }
+
+    const msr = MSR(u64, 0x1B);
+
+    pub const format = core.formatStructIgnoreReserved;
+};
+
+/// The timestamp counter value at which the local APIC timer fires when in TSC-deadline mode, zero disarms it.
+pub const IA32_TSC_DEADLINE = MSR(u64, 0x6E0);
+
+/// General purpose performance counter `index`.
+///
+/// Writes only set the low 32 bits, sign extended to the width of the counter.
+pub fn IA32_PMC(comptime index: u32) type {
+    return MSR(u64, 0xC1 + index);
+}
+
+/// Selects the event counted by general purpose performance counter `index`.
+pub fn IA32_PERFEVTSEL(comptime index: u32) type {
+    return MSR(u64, 0x186 + index);
+}
+
+/// The overflow status of the performance counters, architectural performance monitoring version 2 and later.
+pub const IA32_PERF_GLOBAL_STATUS = MSR(u64, 0x38E);
+
+/// Enables the performance counters, architectural performance monitoring version 2 and later.
+pub const IA32_PERF_GLOBAL_CTRL = MSR(u64, 0x38F);
+
+/// Clears bits in `IA32_PERF_GLOBAL_STATUS`, architectural performance monitoring version 2 and later.
+pub const IA32_PERF_GLOBAL_OVF_CTRL = MSR(u64, 0x390);
+
+/// The code and stack segment selectors loaded by `SYSCALL` and `SYSRET`.
+pub const STAR = MSR(u64, 0xC0000081);
+
+/// The target of `SYSCALL` in 64-bit mode.
+pub const LSTAR = MSR(u64, 0xC0000082);
+
+/// The flags cleared by `SYSCALL`.
+pub const SFMASK = MSR(u64, 0xC0000084);
+
+/// The base address of the GS segment.
+///
+/// In the kernel this holds the address of the current `kernel.Processor`.
+pub const GS_BASE = MSR(u64, 0xC0000101);
+
+/// The value that is swapped into `GS_BASE` by the `swapgs` instruction.
+pub const KERNEL_GS_BASE = MSR(u64, 0xC0000102);
+
 pub fn MSR(comptime T: type, comptime register: u32) type {
     return struct {
         pub inline fn read() T {
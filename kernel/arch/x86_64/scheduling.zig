@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+/// Switches from `current_task` to `new_task`.
+///
+/// The callee saved registers of `current_task` are pushed onto its stack and the resulting stack pointer is saved,
+/// then the same is restored for `new_task`.
+///
+/// The extended state is switched lazily, see `x86_64.extended_state`.
+///
+/// Must be called with interrupts disabled.
+pub inline fn switchToTask(current_task: *kernel.Task, new_task: *kernel.Task) void {
+    const processor = kernel.Processor.current();
+
+    x86_64.extended_state.switchTasks(processor, current_task);
+    processor.arch.kernel_stack_pointer = new_task.arch.kernel_stack_pointer;
+
+    _switchToTask(&current_task.stack_pointer, new_task.stack_pointer);
+}
+
+/// Prepares the stack of `task` so that the first switch to it calls `entry` with `task` as its only argument.
+///
+/// The extended state save area of `task` is placed at the top of its stack.
+pub fn prepareNewTask(task: *kernel.Task, entry: *const fn (task: *kernel.Task) callconv(.C) noreturn) void {
+    var stack_pointer = x86_64.extended_state.prepareTask(task);
+    task.arch.kernel_stack_pointer = stack_pointer;
+
+    // the trampoline is returned to by `_switchToTask` with the stack pointer at the top of the stack, so the
+    // `call` it performs leaves the stack correctly aligned on entry to `entry`
+    push(&stack_pointer, @intFromPtr(&_taskEntryTrampoline));
+
+    // callee saved registers in the order `_switchToTask` pushes them
+    push(&stack_pointer, 0); // rbp, zero to terminate stack traces
+    push(&stack_pointer, 0); // rbx
+    push(&stack_pointer, @intFromPtr(task)); // r12
+    push(&stack_pointer, @intFromPtr(entry)); // r13
+    push(&stack_pointer, 0); // r14
+    push(&stack_pointer, 0); // r15
+
+    task.stack_pointer = stack_pointer;
+}
+
+/// Sends the scheduler interrupt to `processor`, making it re-evaluate which task it should be running.
+pub fn sendSchedulerInterrupt(processor: *kernel.Processor) void {
+    x86_64.apic.sendIpi(.{ .apic_id = processor.arch.apic_id }, .scheduler);
+}
+
+/// Handles the scheduler interrupt, the switch itself happens on the way out of the interrupt.
+pub fn schedulerInterruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+    _ = interrupt_frame;
+    _ = context;
+    x86_64.apic.endOfInterrupt();
+    kernel.scheduler.requestPreemption();
+}
+
+inline fn push(stack_pointer: *usize, value: usize) void {
+    stack_pointer.* -= @sizeOf(usize);
+    @as(*usize, @ptrFromInt(stack_pointer.*)).* = value;
+}
+
+extern fn _switchToTask(current_stack_pointer: *usize, new_stack_pointer: usize) callconv(.C) void;
+extern fn _taskEntryTrampoline() callconv(.C) noreturn;
+
+comptime {
+    asm (
+        \\.global _switchToTask
+        \\.type _switchToTask, @function
+        \\_switchToTask:
+        \\  push %rbp
+        \\  push %rbx
+        \\  push %r12
+        \\  push %r13
+        \\  push %r14
+        \\  push %r15
+        \\  mov %rsp, (%rdi)
+        \\  mov %rsi, %rsp
+        \\  pop %r15
+        \\  pop %r14
+        \\  pop %r13
+        \\  pop %r12
+        \\  pop %rbx
+        \\  pop %rbp
+        \\  ret
+        \\
+        \\.global _taskEntryTrampoline
+        \\.type _taskEntryTrampoline, @function
+        \\_taskEntryTrampoline:
+        \\  mov %r12, %rdi
+        \\  call *%r13
+        \\  ud2
+    );
+}
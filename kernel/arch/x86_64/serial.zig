@@ -1,28 +1,60 @@
 // SPDX-License-Identifier: MIT
 
+//! 16550 UART driver.
+//!
+//! Output is written synchronously, polling the line status before every byte, until `enableInterruptDrivenOutput`
+//! is called. From then on bytes are copied into a transmit ring and moved into the 16 byte FIFO in bursts, topped up
+//! by the transmitter holding register empty interrupt, so the writer only waits on the UART if the ring is full.
+//!
+//! Writes made with interrupts disabled are still synchronous, after first draining the ring to keep the output in
+//! order, so output from the panic handler is never left sitting in the ring.
+
 const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
 const x86_64 = @import("x86_64.zig");
 
+const log = kernel.log.scoped(.serial);
+
 const portReadU8 = x86_64.instructions.portReadU8;
 const portWriteU8 = x86_64.instructions.portWriteU8;
 
-const OUTPUT_READY: u8 = 1 << 5;
+/// The size of the transmit ring, must be a power of two.
+const transmit_ring_size = 4096;
 
-// TODO: Implement a proper serial port driver https://github.com/CascadeOS/CascadeOS/issues/30
+/// The depth of the transmit FIFO.
+const fifo_size = 16;
 
 pub const SerialPort = struct {
     z_data_port: u16,
+    z_interrupt_enable_port: u16,
+    z_interrupt_identification_port: u16,
     z_line_status_port: u16,
 
-    /// Initialize the serial port at `com_port` with the baud rate `baud_rate`
-    pub fn init(com_port: COMPort, baud_rate: BaudRate) SerialPort {
-        // TODO: Check if the serial port exists before using it. https://github.com/CascadeOS/CascadeOS/issues/37
-        // Writing to then reading the scratch register `data_port_number + 7` should return the same value.
+    /// Set once output is interrupt driven, until then the transmit ring is unused.
+    z_interrupt_driven: bool = false,
+
+    /// Protects the transmit ring, the FIFO and the interrupt enable register once output is interrupt driven.
+    z_lock: kernel.SpinLock = .{},
+
+    z_transmit_ring: [transmit_ring_size]u8 = undefined,
 
+    /// The total number of bytes ever copied into `z_transmit_ring`.
+    z_transmit_head: usize = 0,
+
+    /// The total number of bytes ever moved from `z_transmit_ring` into the FIFO.
+    z_transmit_tail: usize = 0,
+
+    /// Initialize the serial port at `com_port` with the baud rate `baud_rate`.
+    ///
+    /// Returns null if there is no UART at `com_port`.
+    pub fn init(com_port: COMPort, baud_rate: BaudRate) ?SerialPort {
         const data_port_number = com_port.toPort();
 
+        // a UART with a working scratch register reads back what was written to it
+        portWriteU8(data_port_number + 7, 0xAE);
+        if (portReadU8(data_port_number + 7) != 0xAE) return null;
+
         // Disable interrupts
         portWriteU8(data_port_number + 1, 0x00);
 
@@ -37,40 +69,181 @@ pub const SerialPort = struct {
         // Enable FIFO
         portWriteU8(data_port_number + 2, 0xC7);
 
-        // Mark data terminal ready
+        // Mark data terminal ready, the OUT2 bit connects the interrupt line
         portWriteU8(data_port_number + 4, 0x0B);
 
-        // Enable interupts
-        portWriteU8(data_port_number + 1, 0x01);
-
         return .{
             .z_data_port = data_port_number,
+            .z_interrupt_enable_port = data_port_number + 1,
+            .z_interrupt_identification_port = data_port_number + 2,
             .z_line_status_port = data_port_number + 5,
         };
     }
 
-    fn waitForOutputReady(self: SerialPort) void {
-        while (portReadU8(self.z_line_status_port) & OUTPUT_READY == 0) {
-            x86_64.instructions.pause();
+    /// Switches to interrupt driven output, routing the interrupt of `com_port` to the bootstrap processor.
+    ///
+    /// Output stays synchronous if the interrupt cannot be routed.
+    ///
+    /// `self` must not move after this is called.
+    pub fn enableInterruptDrivenOutput(self: *SerialPort, com_port: COMPort) void {
+        if (!x86_64.ioapic.isAvailable()) {
+            log.warn("no I/O APIC, serial output remains synchronous", .{});
+            return;
         }
+
+        const vector = x86_64.interrupts.allocateVector(interruptHandler, self) catch {
+            log.warn("no free interrupt vector, serial output remains synchronous", .{});
+            return;
+        };
+
+        x86_64.ioapic.routeIsaInterrupt(
+            com_port.toIsaInterrupt(),
+            vector,
+            kernel.Processor.get(.bootstrap).arch.apic_id,
+        );
+
+        @atomicStore(bool, &self.z_interrupt_driven, true, .Release);
+
+        log.debug("serial output is interrupt driven on vector {}", .{@intFromEnum(vector)});
     }
 
-    pub const Writer = std.io.Writer(SerialPort, error{}, writerImpl);
-    pub inline fn writer(self: SerialPort) Writer {
+    pub const Writer = std.io.Writer(*SerialPort, error{}, writerImpl);
+    pub inline fn writer(self: *SerialPort) Writer {
         return .{ .context = self };
     }
 
     /// The impl function driving the `std.io.Writer`
-    fn writerImpl(self: SerialPort, bytes: []const u8) error{}!usize {
+    fn writerImpl(self: *SerialPort, bytes: []const u8) error{}!usize {
+        if (!@atomicLoad(bool, &self.z_interrupt_driven, .Acquire)) {
+            self.writeSynchronous(bytes);
+            return bytes.len;
+        }
+
+        if (!x86_64.interrupts.interruptsEnabled()) {
+            // the lock may be held by code this processor interrupted, or by a processor that will never release it
+            // during a panic, so rather than spinning the bytes are written without the ring
+            const held = self.z_lock.tryGrab() orelse {
+                self.writeSynchronous(bytes);
+                return bytes.len;
+            };
+            defer held.unlock();
+
+            self.drainTransmitRing();
+            self.writeSynchronous(bytes);
+
+            return bytes.len;
+        }
+
+        var remaining = bytes;
+        while (remaining.len != 0) {
+            const copied = blk: {
+                const held = self.z_lock.lock();
+                defer held.unlock();
+
+                const count = self.copyIntoTransmitRing(remaining);
+
+                self.fillFifo();
+                self.setTransmitInterrupt(self.z_transmit_head != self.z_transmit_tail);
+
+                break :blk count;
+            };
+
+            // the ring is full, wait for the UART to make space
+            if (copied == 0) x86_64.instructions.pause();
+
+            remaining = remaining[copied..];
+        }
+
+        return bytes.len;
+    }
+
+    fn writeSynchronous(self: *SerialPort, bytes: []const u8) void {
         for (bytes) |char| {
             self.waitForOutputReady();
             // TODO: Does a serial port need `\r` before `\n`? https://github.com/CascadeOS/CascadeOS/issues/31
             portWriteU8(self.z_data_port, char);
         }
-        return bytes.len;
+    }
+
+    /// Copies as much of `bytes` as fits into the transmit ring, returns the number of bytes copied.
+    ///
+    /// Must be called with `z_lock` held.
+    fn copyIntoTransmitRing(self: *SerialPort, bytes: []const u8) usize {
+        const free = transmit_ring_size - (self.z_transmit_head - self.z_transmit_tail);
+        const length = @min(bytes.len, free);
+
+        const offset = self.z_transmit_head % transmit_ring_size;
+        const first_length = @min(length, transmit_ring_size - offset);
+        @memcpy(self.z_transmit_ring[offset..][0..first_length], bytes[0..first_length]);
+        @memcpy(self.z_transmit_ring[0 .. length - first_length], bytes[first_length..length]);
+
+        self.z_transmit_head += length;
+
+        return length;
+    }
+
+    /// Moves up to a FIFO worth of bytes from the transmit ring into the FIFO, if the FIFO is empty.
+    ///
+    /// Must be called with `z_lock` held.
+    fn fillFifo(self: *SerialPort) void {
+        if (portReadU8(self.z_line_status_port) & OUTPUT_READY == 0) return;
+
+        const length = @min(self.z_transmit_head - self.z_transmit_tail, fifo_size);
+
+        for (0..length) |_| {
+            portWriteU8(self.z_data_port, self.z_transmit_ring[self.z_transmit_tail % transmit_ring_size]);
+            self.z_transmit_tail += 1;
+        }
+    }
+
+    /// Writes out everything in the transmit ring, polling for the FIFO to empty.
+    ///
+    /// Must be called with `z_lock` held.
+    fn drainTransmitRing(self: *SerialPort) void {
+        while (self.z_transmit_head != self.z_transmit_tail) {
+            self.waitForOutputReady();
+            self.fillFifo();
+        }
+
+        self.setTransmitInterrupt(false);
+    }
+
+    /// Must be called with `z_lock` held.
+    fn setTransmitInterrupt(self: *SerialPort, enable: bool) void {
+        portWriteU8(self.z_interrupt_enable_port, if (enable) TRANSMIT_EMPTY_INTERRUPT else 0);
+    }
+
+    fn waitForOutputReady(self: *const SerialPort) void {
+        while (portReadU8(self.z_line_status_port) & OUTPUT_READY == 0) {
+            x86_64.instructions.pause();
+        }
+    }
+
+    fn interruptHandler(interrupt_frame: *x86_64.interrupts.InterruptFrame, context: ?*anyopaque) void {
+        _ = interrupt_frame;
+        const self: *SerialPort = @ptrCast(@alignCast(context.?));
+
+        {
+            const held = self.z_lock.grab();
+            defer held.unlock();
+
+            // reading the interrupt identification register acknowledges the transmit interrupt
+            _ = portReadU8(self.z_interrupt_identification_port);
+
+            self.fillFifo();
+            self.setTransmitInterrupt(self.z_transmit_head != self.z_transmit_tail);
+        }
+
+        x86_64.apic.endOfInterrupt();
     }
 };
 
+/// Set in the line status register when the transmitter holding register, or the FIFO if enabled, is empty.
+const OUTPUT_READY: u8 = 1 << 5;
+
+/// Enables the interrupt raised when the transmitter holding register, or the FIFO if enabled, becomes empty.
+const TRANSMIT_EMPTY_INTERRUPT: u8 = 1 << 1;
+
 pub const COMPort = enum {
     COM1,
     COM2,
@@ -85,6 +258,13 @@ pub const COMPort = enum {
             .COM4 => 0x2E8,
         };
     }
+
+    inline fn toIsaInterrupt(com_port: COMPort) u8 {
+        return switch (com_port) {
+            .COM1, .COM3 => 4,
+            .COM2, .COM4 => 3,
+        };
+    }
 };
 
 pub const BaudRate = enum {
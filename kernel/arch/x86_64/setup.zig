@@ -3,19 +3,52 @@
 const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
+const kernel_options = @import("kernel_options");
 const x86_64 = @import("x86_64.zig");
 
 const log = kernel.log.scoped(.setup_x86_64);
 
-pub const EarlyOutputWriter = x86_64.serial.SerialPort.Writer;
-var early_output_serial_port: x86_64.serial.SerialPort = undefined;
+pub const EarlyOutputWriter = std.io.Writer(void, error{}, writeEarlyOutput);
+
+const early_output_com_port: x86_64.serial.COMPort = .COM1;
+var early_output_serial_port: ?x86_64.serial.SerialPort = null;
+
+/// The ISA debug console port provided by QEMU's `-debugcon`.
+const debugcon_port = 0xE9;
 
 pub fn setupEarlyOutput() void {
-    early_output_serial_port = x86_64.serial.SerialPort.init(.COM1, .Baud115200);
+    // the debug console needs no setup
+    if (kernel_options.debugcon) return;
+
+    early_output_serial_port = x86_64.serial.SerialPort.init(early_output_com_port, .Baud115200);
 }
 
-pub inline fn getEarlyOutputWriter() x86_64.serial.SerialPort.Writer {
-    return early_output_serial_port.writer();
+pub inline fn getEarlyOutputWriter() EarlyOutputWriter {
+    return .{ .context = {} };
+}
+
+/// Discards the output if there is no serial port.
+fn writeEarlyOutput(context: void, bytes: []const u8) error{}!usize {
+    _ = context;
+
+    if (kernel_options.debugcon) {
+        // unlike a UART the debug console accepts a whole buffer without polling
+        x86_64.instructions.portWriteBytes(debugcon_port, bytes);
+        return bytes.len;
+    }
+
+    if (early_output_serial_port) |*serial_port| return serial_port.writer().write(bytes);
+
+    return bytes.len;
+}
+
+/// Initializes the devices that are used by the kernel itself.
+///
+/// Must be called on the bootstrap processor after its local interrupt controller is initialized.
+pub fn initializeDevices() void {
+    x86_64.ioapic.init();
+
+    if (early_output_serial_port) |*serial_port| serial_port.enableInterruptDrivenOutput(early_output_com_port);
 }
 
 var gdt: x86_64.Gdt = .{};
@@ -26,29 +59,124 @@ const kernel_stack_size = page_size.multiply(4);
 
 var exception_stack align(16) = [_]u8{0} ** kernel_stack_size.bytes;
 var double_fault_stack align(16) = [_]u8{0} ** kernel_stack_size.bytes;
-var interrupt_stack align(16) = [_]u8{0} ** kernel_stack_size.bytes;
 var non_maskable_interrupt_stack align(16) = [_]u8{0} ** kernel_stack_size.bytes;
 
 pub fn earlyArchInitialization() void {
     log.debug("loading gdt", .{});
     gdt.load();
 
-    log.debug("preparing interrupt and exception stacks", .{});
+    log.debug("preparing exception stacks", .{});
     tss.setInterruptStack(.exception, &exception_stack);
     tss.setInterruptStack(.double_fault, &double_fault_stack);
-    tss.setInterruptStack(.interrupt, &interrupt_stack);
     tss.setInterruptStack(.non_maskable_interrupt, &non_maskable_interrupt_stack);
 
     log.debug("loading tss", .{});
     gdt.setTss(&tss);
 
-    log.debug("loading idt", .{});
-    x86_64.interrupts.loadIdt();
+    log.debug("initializing idt", .{});
+    x86_64.interrupts.initializeIdt();
 
     log.debug("mapping idt vectors to the prepared stacks", .{});
     mapIdtHandlers();
+
+    x86_64.interrupts.setHandler(.device_not_available, x86_64.extended_state.handleDeviceNotAvailable, null);
+    x86_64.interrupts.setHandler(.non_maskable_interrupt, x86_64.pmu.nonMaskableInterruptHandler, null);
+    x86_64.interrupts.setHandler(.local_apic_error, x86_64.apic.errorInterruptHandler, null);
+    x86_64.interrupts.setHandler(.spurious_interrupt, x86_64.apic.spuriousInterruptHandler, null);
+
+    log.debug("loading idt", .{});
+    x86_64.interrupts.loadIdt();
+}
+
+/// Creates the architecture specific data for the bootstrap processor.
+///
+/// The bootstrap processor reuses the statically allocated exception stacks used during early setup.
+pub fn createBootstrapArchProcessor() x86_64.ArchProcessor {
+    var arch_processor: x86_64.ArchProcessor = .{};
+
+    arch_processor.tss.setInterruptStack(.exception, &exception_stack);
+    arch_processor.tss.setInterruptStack(.double_fault, &double_fault_stack);
+    arch_processor.tss.setInterruptStack(.non_maskable_interrupt, &non_maskable_interrupt_stack);
+
+    return arch_processor;
+}
+
+/// Creates the architecture specific data for a non-bootstrap processor.
+///
+/// Must be called after virtual memory is initialized.
+pub fn createArchProcessor() !x86_64.ArchProcessor {
+    var arch_processor: x86_64.ArchProcessor = .{};
+
+    arch_processor.tss.setInterruptStack(.exception, try allocateStack());
+    arch_processor.tss.setInterruptStack(.double_fault, try allocateStack());
+    arch_processor.tss.setInterruptStack(.non_maskable_interrupt, try allocateStack());
+
+    return arch_processor;
 }
 
+/// Returns the interrupt stack of `processor` that contains `address`, if any.
+pub fn interruptStackContaining(processor: *kernel.Processor, address: kernel.VirtualAddress) ?kernel.VirtualRange {
+    for (processor.arch.tss.interrupt_stack_table) |stack_top| {
+        if (stack_top.equal(kernel.VirtualAddress.zero)) continue;
+
+        const stack = kernel.VirtualRange.fromAddr(stack_top.moveBackward(kernel_stack_size), kernel_stack_size);
+        if (stack.contains(address)) return stack;
+    }
+
+    return null;
+}
+
+fn allocateStack() ![]align(16) u8 {
+    const stack = try kernel.vmm.allocateKernelStack(kernel_stack_size);
+    return @alignCast(try stack.toSlice(u8));
+}
+
+/// Load the provided `Processor` as the current processor.
+///
+/// Loads the processor's own GDT and TSS, which clears `GS_BASE` so it must be written afterwards.
+pub fn loadProcessor(processor: *kernel.Processor) void {
+    processor.arch.gdt.load();
+    processor.arch.gdt.setTss(&processor.arch.tss);
+
+    x86_64.registers.KERNEL_GS_BASE.write(0);
+    x86_64.registers.GS_BASE.write(@intFromPtr(processor));
+}
+
+/// Performs the architecture specific initialization of a non-bootstrap processor.
+///
+/// Called on the non-bootstrap processor itself.
+pub fn nonBootstrapArchInitialization(processor: *kernel.Processor) void {
+    x86_64.interrupts.loadIdt();
+    loadProcessor(processor);
+    configureSystemFeatures();
+}
+
+/// Initializes the local APIC of the executing processor.
+///
+/// Must be called on `processor` itself after virtual memory is initialized.
+pub fn initializeLocalInterruptController(processor: *kernel.Processor) void {
+    x86_64.apic.init(processor);
+}
+
+/// Captures the APIC id and topology of the executing processor into `processor`.
+///
+/// Must be called on `processor` itself after `captureSystemInformation`.
+pub fn captureProcessorTopology(processor: *kernel.Processor) void {
+    const apic_id = x86_64.cpuid.apicId();
+
+    processor.arch.apic_id = apic_id;
+    processor.topology = .{
+        .core = apic_id >> x86_64.info.smt_shift,
+        .cache_domain = apic_id >> x86_64.info.last_level_cache_shift,
+        .package = apic_id >> x86_64.info.package_shift,
+    };
+
+    log.debug("processor {} has apic id {} - {}", .{ @intFromEnum(processor.id), apic_id, processor.topology });
+}
+
+/// Maps exceptions to their interrupt stacks.
+///
+/// All other vectors run on the stack of the interrupted task, which allows them to switch tasks.
 fn mapIdtHandlers() void {
     for (0..x86_64.interrupts.number_of_handlers) |vector_number| {
         const vector: x86_64.interrupts.IdtVector = @enumFromInt(vector_number);
@@ -63,12 +191,7 @@ fn mapIdtHandlers() void {
             continue;
         }
 
-        if (vector.isException()) {
-            x86_64.interrupts.setVectorStack(vector, .exception);
-            continue;
-        }
-
-        x86_64.interrupts.setVectorStack(vector, .interrupt);
+        if (vector.isException()) x86_64.interrupts.setVectorStack(vector, .exception);
     }
 }
 
@@ -76,8 +199,13 @@ fn mapIdtHandlers() void {
 pub fn captureSystemInformation() void {
     log.debug("capturing cpuid information", .{});
     x86_64.cpuid.capture();
+
+    log.debug("selecting alternatives", .{});
+    x86_64.alternatives.apply();
 }
 
+pub const cycleCounterFrequency = x86_64.tsc.frequency;
+
 /// Configures x86_64 system features.
 pub fn configureSystemFeatures() void {
     // CR0
@@ -105,4 +233,9 @@ pub fn configureSystemFeatures() void {
 
         log.debug("EFER set", .{});
     }
+
+    if (x86_64.info.has_syscall) x86_64.syscall.init();
+
+    // CR0, CR4 and XCR0 for the extended state
+    x86_64.extended_state.enable();
 }
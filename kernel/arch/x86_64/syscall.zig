@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: MIT
+
+//! SYSCALL entry.
+//!
+//! `SYSCALL` does not switch stacks, so the entry stub uses `swapgs` to reach the current `kernel.Processor` and
+//! loads the kernel stack of the current task from `ArchProcessor.kernel_stack_pointer`. The caller's registers are
+//! saved as a `SyscallFrame` and `kernel.syscall.dispatch` is called directly, none of the work of an interrupt
+//! entry is needed.
+//!
+//! As `SYSRET` always returns to ring 3, `SYSCALL` from the kernel itself (used by the benchmarks) stays on the
+//! current stack and returns with a jump, kernel callers are recognised by their return address being in the higher
+//! half.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.syscall);
+
+const Gdt = x86_64.Gdt;
+
+/// The flags cleared on entry: interrupt, direction, trap, nested task and alignment check.
+const flags_mask: u64 = (1 << 9) | (1 << 10) | (1 << 8) | (1 << 14) | (1 << 18);
+
+/// Configures `SYSCALL` on the executing processor.
+///
+/// Must be called on every processor, after `EFER.SCE` is set.
+pub fn init() void {
+    // `SYSRET` loads ss from the selector in bits 48..63 plus 8 and cs from the same selector plus 16
+    comptime {
+        std.debug.assert(Gdt.user_data_selector == (Gdt.kernel_data_selector | 3) + 8);
+        std.debug.assert(Gdt.user_code_selector == (Gdt.kernel_data_selector | 3) + 16);
+        std.debug.assert(Gdt.kernel_data_selector == Gdt.kernel_code_selector + 8);
+    }
+
+    x86_64.registers.STAR.write(
+        (@as(u64, Gdt.kernel_data_selector | 3) << 48) | (@as(u64, Gdt.kernel_code_selector) << 32),
+    );
+    x86_64.registers.LSTAR.write(@intFromPtr(&syscallEntry));
+    x86_64.registers.SFMASK.write(flags_mask);
+}
+
+pub fn isAvailable() bool {
+    return x86_64.info.has_syscall;
+}
+
+/// Performs the system call `number` with `arguments`.
+pub inline fn invoke(number: kernel.syscall.Number, arguments: kernel.syscall.Arguments) usize {
+    return asm volatile ("syscall"
+        : [ret] "={rax}" (-> usize),
+        : [number] "{rax}" (@intFromEnum(number)),
+          [arg0] "{rdi}" (arguments[0]),
+          [arg1] "{rsi}" (arguments[1]),
+          [arg2] "{rdx}" (arguments[2]),
+          [arg3] "{r10}" (arguments[3]),
+          [arg4] "{r8}" (arguments[4]),
+          [arg5] "{r9}" (arguments[5]),
+        : "rcx", "r11", "memory"
+    );
+}
+
+/// The registers of the caller, in the order pushed by `syscallEntry`.
+const SyscallFrame = extern struct {
+    number: u64,
+    arguments: kernel.syscall.Arguments,
+    rip: u64,
+    rflags: u64,
+    rbx: u64,
+    rsp: u64,
+};
+
+fn dispatch(frame: *SyscallFrame) callconv(.C) usize {
+    return kernel.syscall.dispatch(frame.number, &frame.arguments);
+}
+
+const kernel_stack_pointer_offset =
+    @offsetOf(kernel.Processor, "arch") + @offsetOf(x86_64.ArchProcessor, "kernel_stack_pointer");
+const user_stack_pointer_offset =
+    @offsetOf(kernel.Processor, "arch") + @offsetOf(x86_64.ArchProcessor, "user_stack_pointer");
+
+/// The target of `SYSCALL`, with the return address in rcx and the caller's flags in r11.
+///
+/// Interrupts are re-enabled during the dispatch if the caller had them enabled.
+fn syscallEntry() callconv(.Naked) void {
+    asm volatile (std.fmt.comptimePrint(
+            \\btq $63, %%rcx
+            \\jc 1f
+            \\swapgs
+            \\movq %%rsp, %%gs:{[user_stack_pointer]d}
+            \\movq %%gs:{[kernel_stack_pointer]d}, %%rsp
+            \\pushq %%gs:{[user_stack_pointer]d}
+            \\jmp 2f
+            \\1:
+            \\pushq %%rsp
+            \\2:
+            \\pushq %%rbx
+            \\pushq %%r11
+            \\pushq %%rcx
+            \\pushq %%r9
+            \\pushq %%r8
+            \\pushq %%r10
+            \\pushq %%rdx
+            \\pushq %%rsi
+            \\pushq %%rdi
+            \\pushq %%rax
+            \\movq %%rsp, %%rdi
+            \\movq %%rsp, %%rbx
+            \\andq $-16, %%rsp
+            \\btq $9, %%r11
+            \\jnc 3f
+            \\sti
+            \\3:
+            \\call %[dispatch:P]
+            \\cli
+            \\movq %%rbx, %%rsp
+            \\addq $8, %%rsp
+            \\popq %%rdi
+            \\popq %%rsi
+            \\popq %%rdx
+            \\popq %%r10
+            \\popq %%r8
+            \\popq %%r9
+            \\popq %%rcx
+            \\popq %%r11
+            \\popq %%rbx
+            \\popq %%rsp
+            \\btq $63, %%rcx
+            \\jc 4f
+            \\swapgs
+            \\sysretq
+            \\4:
+            \\pushq %%r11
+            \\popfq
+            \\jmp *%%rcx
+        , .{
+            .kernel_stack_pointer = kernel_stack_pointer_offset,
+            .user_stack_pointer = user_stack_pointer_offset,
+        })
+        :
+        : [dispatch] "X" (&dispatch),
+    );
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+
+//! Timestamp counter calibration.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+const x86_64 = @import("x86_64.zig");
+
+const log = kernel.log.scoped(.tsc);
+
+/// Returns the frequency of the timestamp counter in Hz.
+///
+/// Uses the frequency enumerated by cpuid if available, otherwise the timestamp counter is measured against the PIT.
+/// If that fails the base frequency of the processor is used, which the timestamp counter runs at on most processors
+/// with an invariant timestamp counter.
+///
+/// Must be called after `x86_64.cpuid.capture`.
+pub fn frequency() u64 {
+    if (!x86_64.info.has_invariant_tsc) {
+        log.warn("timestamp counter is not invariant, time will drift if the processor changes frequency", .{});
+    }
+
+    if (x86_64.info.timestamp_counter_frequency != 0) {
+        log.debug("using the timestamp counter frequency enumerated by cpuid", .{});
+        return x86_64.info.timestamp_counter_frequency;
+    }
+
+    log.debug("calibrating the timestamp counter against the PIT", .{});
+    if (calibrateAgainstPit()) |calibrated_frequency| return calibrated_frequency;
+
+    if (x86_64.info.processor_base_frequency != 0) {
+        log.warn("assuming the timestamp counter runs at the processor base frequency", .{});
+        return x86_64.info.processor_base_frequency;
+    }
+
+    core.panic("unable to determine the timestamp counter frequency, it is not enumerated by cpuid and the PIT is not usable");
+}
+
+const pit_frequency = 1_193_182;
+
+/// The number of PIT ticks each calibration attempt measures, 10ms.
+const calibration_pit_ticks = pit_frequency / 100;
+
+const number_of_calibration_attempts = 3;
+
+/// A calibrated frequency outside of this range means the PIT is missing or not counting at its nominal rate.
+const minimum_plausible_frequency = 100_000_000;
+const maximum_plausible_frequency = 10_000_000_000;
+
+/// An attempt is abandoned after this many timestamp counter ticks, twice as long as the attempt would take at the
+/// maximum plausible frequency.
+const attempt_timeout_cycles = 2 * maximum_plausible_frequency / pit_frequency * calibration_pit_ticks;
+
+/// Returns null if the PIT is not usable.
+fn calibrateAgainstPit() ?u64 {
+    // anything interfering with an attempt can only make it take more cycles, so the shortest is the most accurate
+    var cycles: u64 = std.math.maxInt(u64);
+    for (0..number_of_calibration_attempts) |_| {
+        const attempt_cycles = measureCyclesOverPitTicks(calibration_pit_ticks) orelse {
+            log.warn("PIT channel 2 did not count down, unable to calibrate the timestamp counter", .{});
+            return null;
+        };
+        cycles = @min(cycles, attempt_cycles);
+    }
+
+    const calibrated_frequency = cycles * pit_frequency / calibration_pit_ticks;
+
+    if (calibrated_frequency < minimum_plausible_frequency or calibrated_frequency > maximum_plausible_frequency) {
+        log.warn("timestamp counter calibrated against the PIT to an implausible {} Hz", .{calibrated_frequency});
+        return null;
+    }
+
+    return calibrated_frequency;
+}
+
+/// Measures the number of timestamp counter ticks taken for PIT channel 2 to count down `pit_ticks`, returns null if it
+/// has not finished after `attempt_timeout_cycles`.
+///
+/// Channel 2 is used as its gate and output are controlled and observed through port 0x61 without needing an
+/// interrupt.
+fn measureCyclesOverPitTicks(pit_ticks: u16) ?u64 {
+    const interrupts_enabled = x86_64.interrupts.interruptsEnabled();
+    x86_64.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) x86_64.interrupts.enableInterrupts();
+
+    // enable the channel 2 gate and disconnect the speaker
+    const control = x86_64.instructions.portReadU8(port_control);
+    x86_64.instructions.portWriteU8(port_control, (control & ~control_speaker_enable) | control_channel_2_gate);
+
+    // channel 2, low then high byte, mode 0 (interrupt on terminal count), binary
+    x86_64.instructions.portWriteU8(port_command, 0b10_11_000_0);
+    x86_64.instructions.portWriteU8(port_channel_2, @truncate(pit_ticks));
+    x86_64.instructions.portWriteU8(port_channel_2, @truncate(pit_ticks >> 8));
+
+    const start = x86_64.instructions.readTimestampCounter();
+
+    // the output of channel 2 goes high once the count reaches zero
+    while (x86_64.instructions.portReadU8(port_control) & control_channel_2_output == 0) {
+        if (x86_64.instructions.readTimestampCounter() - start > attempt_timeout_cycles) return null;
+    }
+
+    return x86_64.instructions.readTimestampCounter() - start;
+}
+
+const port_channel_2 = 0x42;
+const port_command = 0x43;
+const port_control = 0x61;
+
+const control_channel_2_gate: u8 = 1 << 0;
+const control_speaker_enable: u8 = 1 << 1;
+const control_channel_2_output: u8 = 1 << 5;
@@ -7,17 +7,30 @@ const kernel = @import("kernel");
 comptime {
     // make sure any interrupt handlers are referenced
     _ = interrupts;
+
+    // make sure `memcpy` and `memset` are exported
+    _ = memory;
 }
 
+pub const alternatives = @import("alternatives.zig");
+pub const apic = @import("apic.zig");
+pub const checksum = @import("checksum.zig");
 pub const cpuid = @import("cpuid.zig");
+pub const extended_state = @import("extended_state.zig");
 pub const Gdt = @import("Gdt.zig").Gdt;
 pub const info = @import("info.zig");
 pub const instructions = @import("instructions.zig");
 pub const interrupts = @import("interrupts/interrupts.zig");
+pub const ioapic = @import("ioapic.zig");
+pub const memory = @import("memory.zig");
 pub const paging = @import("paging/paging.zig");
+pub const pmu = @import("pmu.zig");
 pub const registers = @import("registers.zig");
+pub const scheduling = @import("scheduling.zig");
 pub const serial = @import("serial.zig");
 pub const setup = @import("setup.zig");
+pub const syscall = @import("syscall.zig");
+pub const tsc = @import("tsc.zig");
 pub const Tss = @import("Tss.zig").Tss;
 
 pub const PrivilegeLevel = enum(u2) {
@@ -49,6 +62,102 @@ pub const PrivilegeLevel = enum(u2) {
 
 pub const spinLoopHint = instructions.pause;
 
+pub const readCycleCounter = instructions.readTimestampCounter;
+
+pub const captureUnwindRegisters = instructions.captureUnwindRegisters;
+
+pub const interruptStackContaining = setup.interruptStackContaining;
+
+pub const crc32c = checksum.crc32c;
+
+pub const timer = struct {
+    pub const setDeadline = apic.setTimerDeadline;
+    pub const cancel = apic.cancelTimer;
+};
+
+pub const performance_counters = struct {
+    pub const isEventSupported = pmu.isEventSupported;
+    pub const enable = pmu.enableCounting;
+    pub const read = pmu.readCounter;
+};
+
+pub const profiling = struct {
+    pub const isAvailable = pmu.isSamplingAvailable;
+    pub const start = pmu.startSampling;
+    pub const stop = pmu.stopSampling;
+};
+
+/// x86_64 specific per-processor data.
+pub const ArchProcessor = struct {
+    /// The APIC id of this processor.
+    ///
+    /// Captured by `setup.captureProcessorTopology` on the processor itself.
+    apic_id: u32 = 0,
+
+    gdt: Gdt = .{},
+    tss: Tss = .{},
+
+    extended_state: extended_state.ProcessorState = .{},
+
+    /// The top of the kernel stack of the current task, loaded by the `SYSCALL` entry.
+    ///
+    /// Updated on every task switch.
+    kernel_stack_pointer: usize = 0,
+
+    /// Holds the user stack pointer while the `SYSCALL` entry switches to `kernel_stack_pointer`.
+    user_stack_pointer: usize = 0,
+
+    /// The number of cycles between profiling samples, zero if this processor is not sampling.
+    ///
+    /// See `pmu.startSampling`.
+    sampling_period: u64 = 0,
+
+    /// Updated only by this processor, see `interrupts.callHandlerWithStatistics`.
+    interrupt_statistics: interrupts.ProcessorStatistics =
+        [_]interrupts.VectorStatistics{.{}} ** interrupts.number_of_handlers,
+};
+
+/// x86_64 specific per-task data.
+pub const ArchTask = struct {
+    extended_state: extended_state.TaskState = .{},
+
+    /// The top of the usable part of the stack of the task, below the extended state save area.
+    kernel_stack_pointer: usize = 0,
+};
+
+/// Get the current processor.
+///
+/// The `GS_BASE` MSR points at the current `kernel.Processor` whose `self_pointer` field is read with a single
+/// instruction, so this is safe to call with preemption enabled.
+pub inline fn getProcessor() *kernel.Processor {
+    return asm volatile (std.fmt.comptimePrint(
+            "movq %%gs:{d}, %[ret]",
+            .{@offsetOf(kernel.Processor, "self_pointer")},
+        )
+        : [ret] "=r" (-> *kernel.Processor),
+    );
+}
+
+/// Increments the preemption disable count of the current processor.
+///
+/// A single `gs` relative instruction is used so the executing task cannot be migrated part way through.
+pub inline fn incrementPreemptionDisableCount() void {
+    asm volatile (std.fmt.comptimePrint(
+            "incl %%gs:{d}",
+            .{@offsetOf(kernel.Processor, "preemption_disable_count")},
+        ) ::: "memory", "flags");
+}
+
+/// Decrements the preemption disable count of the current processor.
+///
+/// A single `gs` relative instruction is used so the executing task cannot be migrated part way through.
+pub inline fn decrementPreemptionDisableCount() void {
+    asm volatile (std.fmt.comptimePrint(
+            "decl %%gs:{d}",
+            .{@offsetOf(kernel.Processor, "preemption_disable_count")},
+        ) ::: "memory", "flags");
+}
+
 comptime {
     if (kernel.info.arch != .x86_64) {
         @compileError("x86_64 implementation has been referenced when building " ++ @tagName(kernel.info.arch));
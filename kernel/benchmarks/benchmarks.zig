@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+
+//! In-kernel benchmarks, run after system setup when the kernel is built with `-Dbenchmarks`.
+//!
+//! Results are reported in ticks of `kernel.arch.readCycleCounter`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+pub const context_switch = @import("context_switch.zig");
+pub const interrupts = @import("interrupts.zig");
+pub const memory = @import("memory.zig");
+pub const scheduler = @import("scheduler.zig");
+pub const syscall = @import("syscall.zig");
+
+const log = kernel.log.scoped(.benchmarks);
+
+/// Starts a task that runs every benchmark.
+pub fn start() void {
+    _ = kernel.scheduler.spawn(runAll, 0) catch |err| {
+        core.panicFmt("failed to start benchmarks: {s}", .{@errorName(err)});
+    };
+}
+
+fn runAll(argument: usize) void {
+    _ = argument;
+
+    // so benchmarks can report hardware events alongside cycles
+    kernel.performance_counters.enable();
+
+    context_switch.run();
+    interrupts.run();
+    memory.run();
+    scheduler.run();
+    syscall.run();
+
+    kernel.arch.interrupts.logStatistics();
+
+    log.info("benchmarks complete", .{});
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+const Task = kernel.Task;
+
+const log = kernel.log.scoped(.benchmark_context_switch);
+
+/// The number of yields performed by each side of the benchmark.
+const number_of_yields = 10_000;
+
+pub fn run() void {
+    yieldPingPong();
+}
+
+/// Measures the cost of a task switch.
+///
+/// Two tasks pinned to the bootstrap processor yield back and forth, so every yield is a switch to the other task.
+fn yieldPingPong() void {
+    var ping_pong: PingPong = .{ .waiter = kernel.scheduler.currentTask() };
+
+    var tasks: [2]*Task = undefined;
+    for (&tasks) |*task| {
+        task.* = Task.create(PingPong.yieldTask, @intFromPtr(&ping_pong)) catch |err| {
+            core.panicFmt("failed to create task: {s}", .{@errorName(err)});
+        };
+        task.*.pinned_processor = .bootstrap;
+    }
+
+    for (tasks) |task| kernel.scheduler.wake(task);
+
+    while (@atomicLoad(usize, &ping_pong.finished, .Acquire) != tasks.len) kernel.scheduler.block();
+
+    const cycles = ping_pong.end - ping_pong.start;
+    const number_of_switches = tasks.len * number_of_yields;
+
+    log.info("context switch: {} switches in {} cycles, {} cycles per switch", .{
+        number_of_switches,
+        cycles,
+        cycles / number_of_switches,
+    });
+}
+
+const PingPong = struct {
+    /// The number of tasks that have started yielding.
+    started: usize = 0,
+
+    /// The cycle count at which both tasks had started.
+    start: u64 = 0,
+
+    /// The cycle count at which the first task finished.
+    end: u64 = 0,
+
+    /// The number of tasks that have completed all of their yields.
+    finished: usize = 0,
+
+    /// The task waiting for the benchmark to complete.
+    waiter: *Task,
+
+    fn yieldTask(argument: usize) void {
+        const ping_pong: *PingPong = @ptrFromInt(argument);
+
+        // both tasks run on the same processor but either can be preempted part way through an update, and the waiter
+        // reads `ping_pong` from another processor once `finished` has been incremented, so every access is atomic
+
+        // wait for the other task so that only switches between the two are measured
+        _ = @atomicRmw(usize, &ping_pong.started, .Add, 1, .AcqRel);
+        while (@atomicLoad(usize, &ping_pong.started, .Acquire) != 2) kernel.scheduler.yield();
+        _ = @cmpxchgStrong(u64, &ping_pong.start, 0, kernel.arch.readCycleCounter(), .AcqRel, .Monotonic);
+
+        for (0..number_of_yields) |_| kernel.scheduler.yield();
+
+        _ = @cmpxchgStrong(u64, &ping_pong.end, 0, kernel.arch.readCycleCounter(), .AcqRel, .Monotonic);
+
+        // `ping_pong` must not be accessed once `finished` is incremented as the waiter may have moved on
+        const waiter = ping_pong.waiter;
+
+        _ = @atomicRmw(usize, &ping_pong.finished, .Add, 1, .AcqRel);
+        kernel.scheduler.wake(waiter);
+    }
+};
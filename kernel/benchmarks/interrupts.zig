@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.benchmark_interrupts);
+
+/// The number of interrupts raised.
+const number_of_interrupts = 100_000;
+
+pub fn run() void {
+    roundTrip();
+}
+
+/// Measures the cost of entering and returning from an interrupt whose handler does nothing.
+fn roundTrip() void {
+    var minimum_cycles: u64 = std.math.maxInt(u64);
+
+    const region = kernel.performance_counters.Region.begin();
+    const start = kernel.arch.readCycleCounter();
+
+    for (0..number_of_interrupts) |_| {
+        const interrupt_start = kernel.arch.readCycleCounter();
+        kernel.arch.interrupts.raiseNoOperationInterrupt();
+        minimum_cycles = @min(minimum_cycles, kernel.arch.readCycleCounter() - interrupt_start);
+    }
+
+    const cycles = kernel.arch.readCycleCounter() - start;
+    const counts = region.end();
+
+    log.info("interrupt round trip: {} interrupts in {} cycles, {} cycles per interrupt, minimum {} cycles", .{
+        number_of_interrupts,
+        cycles,
+        cycles / number_of_interrupts,
+        minimum_cycles,
+    });
+    log.info("interrupt round trip: {}", .{counts});
+}
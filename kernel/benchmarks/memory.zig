@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.benchmark_memory);
+
+const page_size = kernel.arch.paging.standard_page_size;
+const Page = kernel.arch.memory.Page;
+
+/// Copies and fills are measured at every power of two from `smallest_size` to `largest_size`.
+const smallest_size = core.Size.from(8, .byte);
+const largest_size = core.Size.from(2, .mib);
+
+/// Each size is copied or filled until this many bytes have been processed, so every size takes a similar time.
+const bytes_per_size = core.Size.from(64, .mib);
+
+/// The number of times every page of a buffer is zeroed or copied.
+const page_repetitions = 16;
+
+const Buffer = []align(page_size.bytes) u8;
+
+pub fn run() void {
+    const source = allocateBuffer() orelse return;
+    defer kernel.vmm.freeKernelBuffer(u8, source);
+
+    const destination = allocateBuffer() orelse return;
+    defer kernel.vmm.freeKernelBuffer(u8, destination);
+
+    for (source, 0..) |*byte, i| byte.* = @truncate(i);
+
+    copy(destination, source);
+    fill(destination);
+
+    pageRoutine(.zero_page, destination, source);
+    pageRoutine(.zero_page_non_temporal, destination, source);
+    pageRoutine(.copy_page, destination, source);
+    pageRoutine(.copy_page_non_temporal, destination, source);
+}
+
+/// Allocates a buffer of `largest_size`, freed with `kernel.vmm.freeKernelBuffer`.
+fn allocateBuffer() ?Buffer {
+    return kernel.vmm.allocateKernelBuffer(u8, largest_size.bytes) catch |err| {
+        log.info("failed to allocate a buffer, skipping: {s}", .{@errorName(err)});
+        return null;
+    };
+}
+
+/// Measures `memcpy` at every size.
+fn copy(destination: Buffer, source: Buffer) void {
+    var size = smallest_size;
+    while (size.lessThanOrEqual(largest_size)) : (size.multiplyInPlace(2)) {
+        const iterations = bytes_per_size.divide(size);
+
+        const start = kernel.arch.readCycleCounter();
+
+        for (0..iterations) |_| {
+            @memcpy(destination[0..size.bytes], source[0..size.bytes]);
+            compilerBarrier();
+        }
+
+        logResult("memcpy", size, iterations, kernel.arch.readCycleCounter() - start);
+    }
+}
+
+/// Measures `memset` at every size.
+fn fill(destination: Buffer) void {
+    var size = smallest_size;
+    while (size.lessThanOrEqual(largest_size)) : (size.multiplyInPlace(2)) {
+        const iterations = bytes_per_size.divide(size);
+
+        const start = kernel.arch.readCycleCounter();
+
+        for (0..iterations) |i| {
+            @memset(destination[0..size.bytes], @as(u8, @truncate(i)));
+            compilerBarrier();
+        }
+
+        logResult("memset", size, iterations, kernel.arch.readCycleCounter() - start);
+    }
+}
+
+const PageRoutine = enum {
+    zero_page,
+    zero_page_non_temporal,
+    copy_page,
+    copy_page_non_temporal,
+};
+
+/// Measures `routine` over every page of the buffers, which do not fit in most caches, so the non-temporal routines
+/// are compared against the cost of the cached routines evicting other data.
+fn pageRoutine(comptime routine: PageRoutine, destination: Buffer, source: Buffer) void {
+    const number_of_pages = largest_size.divide(page_size);
+    const destination_pages: [*]align(page_size.bytes) Page = @ptrCast(destination.ptr);
+    const source_pages: [*]align(page_size.bytes) const Page = @ptrCast(source.ptr);
+
+    const region = kernel.performance_counters.Region.begin();
+    const start = kernel.arch.readCycleCounter();
+
+    for (0..page_repetitions) |_| {
+        for (0..number_of_pages) |i| {
+            switch (routine) {
+                .zero_page => kernel.arch.memory.zeroPage(&destination_pages[i]),
+                .zero_page_non_temporal => kernel.arch.memory.zeroPageNonTemporal(&destination_pages[i]),
+                .copy_page => kernel.arch.memory.copyPage(&destination_pages[i], &source_pages[i]),
+                .copy_page_non_temporal => kernel.arch.memory.copyPageNonTemporal(
+                    &destination_pages[i],
+                    &source_pages[i],
+                ),
+            }
+        }
+    }
+
+    const cycles = kernel.arch.readCycleCounter() - start;
+    const counts = region.end();
+
+    logResult(@tagName(routine), page_size, page_repetitions * number_of_pages, cycles);
+    log.info(@tagName(routine) ++ ": {}", .{counts});
+}
+
+fn logResult(comptime name: []const u8, size: core.Size, iterations: usize, cycles: u64) void {
+    const nanoseconds = @max(kernel.time.cyclesToNanoseconds(cycles), 1);
+
+    log.info(name ++ " {}: {} operations in {} cycles, {} cycles per operation, {} MB/s", .{
+        size,
+        iterations,
+        cycles,
+        cycles / iterations,
+        size.bytes * iterations * std.time.ns_per_us / nanoseconds,
+    });
+}
+
+/// Prevents the compiler from merging or removing the repeated copies and fills of the same memory.
+inline fn compilerBarrier() void {
+    asm volatile ("" ::: "memory");
+}
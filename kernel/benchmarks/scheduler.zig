@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+const Task = kernel.Task;
+
+const log = kernel.log.scoped(.benchmark_scheduler);
+
+/// The number of tasks spawned at once by the throughput benchmark, kept well below `Task.maximum_number_of_tasks`.
+const tasks_per_batch = 512;
+
+const number_of_batches = 32;
+
+/// The number of wakeups performed by each side of the wakeup latency benchmark.
+const number_of_wakeups = 1000;
+
+pub fn run() void {
+    spawnThroughput();
+    wakeupLatency();
+}
+
+/// Measures how quickly many short tasks can be spawned, run and destroyed across all processors.
+fn spawnThroughput() void {
+    var batch: Batch = undefined;
+
+    const start = kernel.arch.readCycleCounter();
+
+    for (0..number_of_batches) |_| {
+        batch = .{ .remaining = tasks_per_batch, .waiter = kernel.scheduler.currentTask() };
+
+        for (0..tasks_per_batch) |_| {
+            _ = kernel.scheduler.spawn(Batch.shortTask, @intFromPtr(&batch)) catch |err| {
+                core.panicFmt("failed to spawn task: {s}", .{@errorName(err)});
+            };
+        }
+
+        while (@atomicLoad(usize, &batch.remaining, .Acquire) != 0) kernel.scheduler.block();
+    }
+
+    const cycles = kernel.arch.readCycleCounter() - start;
+    const number_of_tasks = tasks_per_batch * number_of_batches;
+
+    log.info("spawn throughput: {} tasks on {} processors in {} cycles, {} cycles per task", .{
+        number_of_tasks,
+        Processor.all.len,
+        cycles,
+        cycles / number_of_tasks,
+    });
+}
+
+const Batch = struct {
+    remaining: usize,
+    waiter: *Task,
+
+    fn shortTask(argument: usize) void {
+        const batch: *Batch = @ptrFromInt(argument);
+
+        // `batch` must not be accessed once `remaining` reaches zero as the waiter may have moved on
+        const waiter = batch.waiter;
+
+        if (@atomicRmw(usize, &batch.remaining, .Sub, 1, .AcqRel) == 1) kernel.scheduler.wake(waiter);
+    }
+};
+
+/// Measures the time from a task being woken to it running, with the waker and wakee on different processors.
+///
+/// Two tasks pinned to different processors wake each other back and forth.
+fn wakeupLatency() void {
+    if (Processor.all.len < 2) {
+        log.info("wakeup latency: skipped, requires at least two processors", .{});
+        return;
+    }
+
+    const remote_processor = selectRemoteProcessor(Processor.get(.bootstrap));
+
+    var ping_pong: PingPong = .{ .waiter = kernel.scheduler.currentTask() };
+
+    for (&ping_pong.tasks, [_]Processor.Id{ .bootstrap, remote_processor.id }) |*task, processor_id| {
+        task.* = Task.create(PingPong.pingPongTask, @intFromPtr(&ping_pong)) catch |err| {
+            core.panicFmt("failed to create task: {s}", .{@errorName(err)});
+        };
+        task.*.pinned_processor = processor_id;
+    }
+
+    // start both tasks, they immediately block waiting for their first wakeup
+    for (ping_pong.tasks) |task| kernel.scheduler.wake(task);
+
+    ping_pong.woken_at = kernel.arch.readCycleCounter();
+    kernel.scheduler.wake(ping_pong.tasks[0]);
+
+    while (@atomicLoad(usize, &ping_pong.finished, .Acquire) != ping_pong.tasks.len) kernel.scheduler.block();
+
+    const number_of_samples = ping_pong.tasks.len * number_of_wakeups;
+
+    log.info("wakeup latency: processor {} <-> {}, average {} cycles, maximum {} cycles over {} wakeups", .{
+        @intFromEnum(Processor.Id.bootstrap),
+        @intFromEnum(remote_processor.id),
+        ping_pong.total_cycles / number_of_samples,
+        ping_pong.maximum_cycles,
+        number_of_samples,
+    });
+}
+
+/// Selects a processor as far away from `processor` as possible, preferring one in another cache domain and then one
+/// on another core.
+fn selectRemoteProcessor(processor: *Processor) *Processor {
+    for (Processor.all) |*candidate| {
+        if (candidate.topology.cache_domain != processor.topology.cache_domain) return candidate;
+    }
+
+    for (Processor.all) |*candidate| {
+        if (candidate.topology.core != processor.topology.core) return candidate;
+    }
+
+    for (Processor.all) |*candidate| {
+        if (candidate != processor) return candidate;
+    }
+
+    unreachable;
+}
+
+const PingPong = struct {
+    tasks: [2]*Task = undefined,
+
+    /// The cycle count at which the most recent wakeup was issued.
+    woken_at: u64 = 0,
+
+    total_cycles: u64 = 0,
+    maximum_cycles: u64 = 0,
+
+    /// The number of tasks that have completed all of their wakeups.
+    finished: usize = 0,
+
+    /// The task waiting for the benchmark to complete.
+    waiter: *Task,
+
+    fn pingPongTask(argument: usize) void {
+        const ping_pong: *PingPong = @ptrFromInt(argument);
+
+        const current_task = kernel.scheduler.currentTask();
+        const index: usize = if (current_task == ping_pong.tasks[0]) 0 else 1;
+        const other_task = ping_pong.tasks[1 - index];
+
+        for (0..number_of_wakeups) |i| {
+            kernel.scheduler.block();
+
+            const cycles = kernel.arch.readCycleCounter() - ping_pong.woken_at;
+            ping_pong.total_cycles += cycles;
+            ping_pong.maximum_cycles = @max(ping_pong.maximum_cycles, cycles);
+
+            // the second task does not wake the first after its last wakeup as the first has already finished
+            if (index == 1 and i == number_of_wakeups - 1) break;
+
+            ping_pong.woken_at = kernel.arch.readCycleCounter();
+            kernel.scheduler.wake(other_task);
+        }
+
+        // `ping_pong` must not be accessed once `finished` is incremented as the waiter may have moved on
+        const waiter = ping_pong.waiter;
+
+        _ = @atomicRmw(usize, &ping_pong.finished, .Add, 1, .AcqRel);
+        kernel.scheduler.wake(waiter);
+    }
+};
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.benchmark_syscall);
+
+/// The number of system calls performed.
+const number_of_syscalls = 100_000;
+
+pub fn run() void {
+    if (!kernel.arch.syscall.isAvailable()) {
+        log.info("system calls not available, skipping", .{});
+        return;
+    }
+
+    nullSyscall();
+}
+
+/// Measures the cost of entering the system call dispatcher and returning from it.
+///
+/// There is no user mode yet, so the privilege level changes are not included.
+fn nullSyscall() void {
+    var minimum_cycles: u64 = std.math.maxInt(u64);
+
+    const region = kernel.performance_counters.Region.begin();
+    const start = kernel.arch.readCycleCounter();
+
+    for (0..number_of_syscalls) |_| {
+        const syscall_start = kernel.arch.readCycleCounter();
+        _ = kernel.arch.syscall.invoke(.null, .{ 0, 0, 0, 0, 0, 0 });
+        minimum_cycles = @min(minimum_cycles, kernel.arch.readCycleCounter() - syscall_start);
+    }
+
+    const cycles = kernel.arch.readCycleCounter() - start;
+    const counts = region.end();
+
+    log.info("null system call: {} system calls in {} cycles, {} cycles per system call, minimum {} cycles", .{
+        number_of_syscalls,
+        cycles,
+        cycles / number_of_syscalls,
+        minimum_cycles,
+    });
+    log.info("null system call: {}", .{counts});
+}
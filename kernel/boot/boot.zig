@@ -20,8 +20,24 @@ const limine_requests = struct {
     export var hhdm: limine.HHDM = .{};
     export var kernel_address: limine.KernelAddress = .{};
     export var memmap: limine.Memmap = .{};
+    export var smp: limine.SMP = .{};
+    export var modules: limine.Module = .{
+        .internal_module_count = internal_modules.len,
+        .internal_modules = @constCast(&internal_modules),
+    };
+
+    const internal_modules = [_]*const limine.Module.InternalModule{&symbol_table_module};
+
+    /// The symbol table generated at build time, installed next to the kernel.
+    const symbol_table_module: limine.Module.InternalModule = .{
+        .path = "symbols",
+        .cmdline = symbol_table_cmdline,
+        .flags = .{},
+    };
 };
 
+const symbol_table_cmdline = "symbols";
+
 /// Returns the direct map address provided by the bootloader, if any.
 pub fn directMapAddress() ?u64 {
     if (limine_requests.hhdm.response) |resp| {
@@ -54,6 +70,27 @@ pub fn kernelFile() ?kernel.VirtualRange {
     return null;
 }
 
+/// Returns the contents of the symbol table module, if loaded by the bootloader.
+pub fn symbolTable() ?[]const u8 {
+    const resp = limine_requests.modules.response orelse return null;
+
+    for (resp.getModules()) |module| {
+        const cmdline = module.cmdline orelse continue;
+        if (std.mem.eql(u8, std.mem.sliceTo(cmdline, 0), symbol_table_cmdline)) return module.getContents();
+    }
+
+    return null;
+}
+
+/// Returns the kernel command line, if provided by the bootloader.
+pub fn kernelCommandLine() ?[]const u8 {
+    if (limine_requests.kernel_file.response) |resp| {
+        const command_line = resp.kernel_file.cmdline orelse return null;
+        return std.mem.sliceTo(command_line, 0);
+    }
+    return null;
+}
+
 /// Returns an iterator over the memory map entries, iterating in the given direction.
 pub fn memoryMapIterator(direction: Direction) MemoryMapIterator {
     const memmap_response = limine_requests.memmap.response orelse core.panic("no memory map from the bootloader");
@@ -169,3 +206,133 @@ const LimineMemoryMapIterator = struct {
         };
     }
 };
+
+/// The minimum size of the stack provided by the bootloader to every processor.
+const bootloader_stack_size = core.Size.from(64, .kib);
+
+/// Returns the part of the stack provided by the bootloader to the current processor that is known to be mapped.
+///
+/// `stack_pointer` must be captured in one of the first functions to run on the processor. The bootloader allocates
+/// stacks as whole pages, so the top of the stack is found by aligning `stack_pointer` forward to a page, which
+/// misses the top page if `stack_pointer` is already more than a page below it.
+pub fn bootloaderStack(stack_pointer: usize) kernel.VirtualRange {
+    const stack_top = kernel.VirtualAddress.fromInt(
+        std.mem.alignForward(usize, stack_pointer, kernel.arch.paging.standard_page_size.bytes),
+    );
+
+    return kernel.VirtualRange.fromAddr(stack_top.moveBackward(bootloader_stack_size), bootloader_stack_size);
+}
+
+/// Returns an iterator over the processors provided by the bootloader, if any.
+///
+/// The iterator includes the bootstrap processor.
+pub fn processorDescriptorIterator() ?ProcessorDescriptorIterator {
+    if (limine_requests.smp.response) |resp| {
+        return .{
+            .limine = .{
+                .index = 0,
+                .smp = resp,
+            },
+        };
+    }
+    return null;
+}
+
+/// An iterator over the processors provided by the bootloader.
+pub const ProcessorDescriptorIterator = union(enum) {
+    limine: LimineProcessorDescriptorIterator,
+
+    /// Returns the total number of processors, including the bootstrap processor.
+    pub fn count(self: ProcessorDescriptorIterator) usize {
+        return switch (self) {
+            inline else => |i| i.count(),
+        };
+    }
+
+    /// Returns the next processor descriptor from the iterator, if any remain.
+    pub fn next(self: *ProcessorDescriptorIterator) ?ProcessorDescriptor {
+        return switch (self.*) {
+            inline else => |*i| i.next(),
+        };
+    }
+};
+
+/// A processor provided by the bootloader.
+pub const ProcessorDescriptor = union(enum) {
+    limine: LimineProcessorDescriptor,
+
+    /// Returns true if this is the processor the kernel was started on.
+    pub fn isBootstrap(self: ProcessorDescriptor) bool {
+        return switch (self) {
+            inline else => |d| d.isBootstrap(),
+        };
+    }
+
+    /// Starts the processor, `entry` is called on the new processor with the given `processor` as its argument.
+    ///
+    /// The processor starts on a small stack provided by the bootloader using the bootloader's page table.
+    pub fn boot(
+        self: ProcessorDescriptor,
+        processor: *kernel.Processor,
+        comptime entry: fn (processor: *kernel.Processor) noreturn,
+    ) void {
+        return switch (self) {
+            inline else => |d| d.boot(processor, entry),
+        };
+    }
+};
+
+const LimineProcessorDescriptorIterator = struct {
+    index: usize,
+    smp: *const limine.SMP.Response,
+
+    pub fn count(self: LimineProcessorDescriptorIterator) usize {
+        return self.smp.cpu_count;
+    }
+
+    pub fn next(self: *LimineProcessorDescriptorIterator) ?ProcessorDescriptor {
+        if (self.index >= self.smp.cpu_count) return null;
+
+        const smp_info = self.smp.cpus[self.index];
+        self.index += 1;
+
+        return .{
+            .limine = .{
+                .smp_info = smp_info,
+                .smp = self.smp,
+            },
+        };
+    }
+};
+
+const LimineProcessorDescriptor = struct {
+    smp_info: *limine.SMP.Response.SMPInfo,
+    smp: *const limine.SMP.Response,
+
+    pub fn isBootstrap(self: LimineProcessorDescriptor) bool {
+        return switch (kernel.info.arch) {
+            .x86_64 => self.smp_info.lapic_id == self.smp.bsp_lapic_id,
+            .aarch64 => self.smp_info.mpidr == self.smp.bsp_mpidr,
+        };
+    }
+
+    pub fn boot(
+        self: LimineProcessorDescriptor,
+        processor: *kernel.Processor,
+        comptime entry: fn (processor: *kernel.Processor) noreturn,
+    ) void {
+        const trampoline = struct {
+            fn trampoline(smp_info: *const limine.SMP.Response.SMPInfo) callconv(.C) noreturn {
+                entry(@ptrFromInt(smp_info.extra_argument));
+            }
+        }.trampoline;
+
+        @atomicStore(u64, &self.smp_info.extra_argument, @intFromPtr(processor), .Release);
+        @atomicStore(
+            ?*const fn (smp_info: *const limine.SMP.Response.SMPInfo) callconv(.C) noreturn,
+            &self.smp_info.goto_address,
+            &trampoline,
+            .Release,
+        );
+    }
+};
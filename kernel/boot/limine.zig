@@ -225,7 +225,7 @@ pub const PagingMode = extern struct {
 pub const SMP = extern struct {
     id: [4]u64 align(8) = LIMINE_COMMON_MAGIC ++ [_]u64{ 0x95a67b819a1b857e, 0xa0b61b723b6a73e0 },
     revision: u64 = 0,
-    response: Response = .{ .x86_64 = null }, // it doesn't matter what tag we use here for the default value
+    response: ?*const Response = null,
 
     flags: Flags = .{},
 
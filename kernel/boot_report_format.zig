@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: MIT
+
+//! The format of the boot report logged at the end of `kernel.setup`, shared by the kernel that logs it and the build
+//! step that checks it for regressions.
+//!
+//! Each line of the report starts with `line_marker`:
+//!
+//!   @boot phase <duration in nanoseconds> <percentage of the total> <name>
+//!   @boot total <duration in nanoseconds>
+//!   @boot end
+//!
+//! Phases are listed in the order they ran, `end` is always the last line of the report.
+
+pub const line_marker = "@boot ";
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+
+//! Cross-processor function calls.
+//!
+//! `call` runs a function on a set of processors, with interrupts disabled. Each processor has a lock-free list of
+//! incoming calls, a request is pushed onto the list of every target before any are interrupted and a target is
+//! only interrupted if its list was empty, so calls made in quick succession are handled by a single interrupt.
+//!
+//! The caller owns the `Request` and must keep it alive until `Request.isComplete` returns true, either by calling
+//! `wait` or by polling.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+
+const log = kernel.log.scoped(.cross_call);
+
+/// Called on each target processor with interrupts disabled, must not block.
+pub const Function = *const fn (context: usize) void;
+
+pub const Request = struct {
+    function: Function = undefined,
+    context: usize = 0,
+
+    /// The number of targets that have not yet finished calling `function`.
+    remaining: usize = 0,
+
+    /// One entry per processor, only the entries of the targets are used.
+    entries: [Processor.maximum_number_of_processors]Entry = undefined,
+
+    /// Returns true once every target has finished calling `function`.
+    pub fn isComplete(self: *const Request) bool {
+        return @atomicLoad(usize, &self.remaining, .Acquire) == 0;
+    }
+};
+
+const Entry = struct {
+    next: ?*Entry,
+    request: *Request,
+};
+
+/// Per-processor cross-processor call state.
+pub const ProcessorState = struct {
+    /// Calls queued for this processor, linked through `Entry.next` in reverse order.
+    incoming: ?*Entry = null,
+};
+
+/// Calls `function` with `context` on every processor in `targets`, a bitmask of processor ids, and waits for them
+/// all to finish.
+///
+/// The current processor is included if it is in `targets`.
+pub fn callAndWait(targets: u64, function: Function, context: usize) void {
+    var request: Request = .{};
+    call(&request, targets, function, context);
+    wait(&request);
+}
+
+/// Starts calling `function` with `context` on every processor in `targets`, a bitmask of processor ids.
+///
+/// If the current processor is in `targets` the function is called on it before this returns, the remote calls may
+/// still be in progress.
+///
+/// `request` must not be in use by another call.
+pub fn call(request: *Request, targets: u64, function: Function, context: usize) void {
+    std.debug.assert(request.isComplete());
+
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const current_processor = Processor.current();
+
+    const valid_targets = targets & Processor.allProcessorsMask();
+    const remote_targets = valid_targets & ~current_processor.id.mask();
+
+    request.function = function;
+    request.context = context;
+    request.remaining = @popCount(remote_targets);
+
+    // every target is queued before any are interrupted, so a target already handling its list picks this request
+    // up without needing an interrupt of its own
+    var targets_to_interrupt: u64 = 0;
+
+    var remaining_targets = remote_targets;
+    while (remaining_targets != 0) : (remaining_targets &= remaining_targets - 1) {
+        const id: Processor.Id = @enumFromInt(@ctz(remaining_targets));
+
+        const entry = &request.entries[@intFromEnum(id)];
+        entry.request = request;
+
+        if (push(Processor.get(id), entry)) targets_to_interrupt |= id.mask();
+    }
+
+    while (targets_to_interrupt != 0) : (targets_to_interrupt &= targets_to_interrupt - 1) {
+        const id: Processor.Id = @enumFromInt(@ctz(targets_to_interrupt));
+        kernel.arch.interrupts.sendCrossCallInterrupt(Processor.get(id));
+    }
+
+    if (valid_targets & current_processor.id.mask() != 0) function(context);
+}
+
+/// Waits for every target of `request` to finish.
+///
+/// Calls queued for the current processor are handled while waiting, so two processors waiting on each other with
+/// interrupts disabled do not deadlock.
+pub fn wait(request: *const Request) void {
+    while (!request.isComplete()) {
+        {
+            const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+            kernel.arch.interrupts.disableInterrupts();
+            defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+            runIncoming(Processor.current());
+        }
+
+        kernel.arch.spinLoopHint();
+    }
+}
+
+/// Handles every call queued for the current processor.
+///
+/// Called by the architecture from the cross-processor call interrupt.
+pub fn handleInterrupt() void {
+    runIncoming(Processor.current());
+}
+
+/// Pushes `entry` onto the incoming list of `processor`.
+///
+/// Returns true if the list was empty, meaning `processor` must be interrupted to handle it.
+fn push(processor: *Processor, entry: *Entry) bool {
+    var head = @atomicLoad(?*Entry, &processor.cross_call.incoming, .Monotonic);
+
+    while (true) {
+        entry.next = head;
+        head = @cmpxchgWeak(
+            ?*Entry,
+            &processor.cross_call.incoming,
+            head,
+            entry,
+            .Release,
+            .Monotonic,
+        ) orelse return entry.next == null;
+    }
+}
+
+/// Must be called with interrupts disabled.
+fn runIncoming(processor: *Processor) void {
+    var entry_opt = @atomicRmw(?*Entry, &processor.cross_call.incoming, .Xchg, null, .Acquire);
+
+    // the incoming list is in reverse order of queueing
+    var reversed: ?*Entry = null;
+    while (entry_opt) |entry| {
+        entry_opt = entry.next;
+        entry.next = reversed;
+        reversed = entry;
+    }
+
+    while (reversed) |entry| {
+        reversed = entry.next;
+
+        const request = entry.request;
+        request.function(request.context);
+
+        // `request` must not be accessed once `remaining` is decremented as the caller may have moved on
+        _ = @atomicRmw(usize, &request.remaining, .Sub, 1, .Release);
+    }
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+
+//! Walks a kernel stack, yielding the return address of every frame.
+//!
+//! Frames are unwound with the unwind entries of the symbol table, which are computed at build time from the call
+//! frame information of the kernel, so the kernel does not need to keep frame pointers. Addresses without an unwind
+//! entry, or every address if the symbol table is not loaded, fall back to following frame pointers unless the kernel
+//! was built without them.
+//!
+//! Every read is checked to be within the stack the walk started on, the stack of the current task or one of the
+//! interrupt stacks of the current processor, so that a corrupt stack ends the walk rather than faulting, which allows
+//! walking the stack from a profiling interrupt. A walk that does not start on a known stack ends immediately.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const symbol_map = @import("symbol_map.zig");
+
+const StackIterator = @This();
+
+registers: Registers,
+
+/// Set once `registers.instruction_pointer` is a return address rather than the address of an instruction that was
+/// executing.
+is_return_address: bool = false,
+
+/// Return addresses are only yielded from this address onwards, if set.
+first_address: ?usize,
+
+/// The stack being walked, every read from the stack is within it.
+stack: ?kernel.VirtualRange,
+
+/// The registers needed to unwind a frame.
+pub const Registers = struct {
+    instruction_pointer: usize,
+    stack_pointer: usize,
+    frame_pointer: usize,
+};
+
+/// Starts a walk from the frame of the caller.
+pub inline fn initCurrent(first_address: ?usize) StackIterator {
+    return init(kernel.arch.captureUnwindRegisters(), first_address);
+}
+
+/// Starts a walk from `registers`, such as those of an interrupted frame.
+pub fn init(registers: Registers, first_address: ?usize) StackIterator {
+    return .{
+        .registers = registers,
+        .first_address = first_address,
+        .stack = stackContaining(kernel.VirtualAddress.fromInt(registers.stack_pointer)),
+    };
+}
+
+/// Returns the stack of the current processor that contains `stack_pointer`, if it is known.
+fn stackContaining(stack_pointer: kernel.VirtualAddress) ?kernel.VirtualRange {
+    // the current processor is not available until the bootstrap processor is initialized
+    if (kernel.Processor.all.len == 0) return null;
+
+    const processor = kernel.Processor.current();
+
+    const task_stack = processor.scheduler.current_task.stack;
+    if (task_stack.contains(stack_pointer)) return task_stack;
+
+    return kernel.arch.interruptStackContaining(processor, stack_pointer);
+}
+
+/// Returns the next return address on the stack, or null once the walk has ended.
+pub fn next(self: *StackIterator) ?usize {
+    while (true) {
+        const address = self.unwind() orelse return null;
+
+        if (self.first_address) |first_address| {
+            if (address != first_address) continue;
+            self.first_address = null;
+        }
+
+        return address;
+    }
+}
+
+/// Unwinds the current frame, returning the return address of the caller.
+fn unwind(self: *StackIterator) ?usize {
+    const registers = self.registers;
+
+    // a return address is the instruction after the call, which may belong to the next function
+    const lookup_address = if (self.is_return_address)
+        registers.instruction_pointer -% 1
+    else
+        registers.instruction_pointer;
+
+    const caller_registers = if (unwindEntryFor(lookup_address)) |entry|
+        self.unwindWithEntry(entry)
+    else if (builtin.omit_frame_pointer)
+        // the frame pointer register holds arbitrary values, following it would only find plausible garbage
+        return null
+    else
+        self.unwindWithFramePointer();
+
+    const caller = caller_registers orelse return null;
+
+    // frames only ever move towards the base of the stack, this also ends the walk at the zero return address that
+    // terminates every stack
+    if (caller.instruction_pointer == 0 or caller.stack_pointer <= registers.stack_pointer) return null;
+
+    self.registers = caller;
+    self.is_return_address = true;
+
+    return caller.instruction_pointer;
+}
+
+fn unwindEntryFor(address: usize) ?*const symbol_map.UnwindEntry {
+    if (address < kernel.arch.paging.higher_half.value) return null;
+
+    // the unwind entries use the addresses the kernel was linked at
+    return symbol_map.getUnwindEntry(address -% kernel.info.kernel_load_offset.bytes);
+}
+
+fn unwindWithEntry(self: *const StackIterator, entry: *const symbol_map.UnwindEntry) ?Registers {
+    const registers = self.registers;
+
+    const base = switch (entry.cfa_register) {
+        .stack_pointer => registers.stack_pointer,
+        .frame_pointer => registers.frame_pointer,
+        .none => return null,
+    };
+
+    const canonical_frame_address = addOffset(base, entry.cfa_offset);
+
+    // the return address is still in a register, only possible for the interrupted frame of a leaf function
+    if (entry.return_address_offset == 0) return null;
+
+    const return_address = self.readStack(
+        addOffset(canonical_frame_address, entry.return_address_offset),
+    ) orelse return null;
+
+    const frame_pointer = if (entry.frame_pointer_offset == 0)
+        registers.frame_pointer
+    else
+        self.readStack(addOffset(canonical_frame_address, entry.frame_pointer_offset)) orelse return null;
+
+    return .{
+        .instruction_pointer = return_address,
+        .stack_pointer = canonical_frame_address,
+        .frame_pointer = frame_pointer,
+    };
+}
+
+/// Both x86_64 and aarch64 save the frame pointer of the caller at the frame pointer with the return address after
+/// it.
+fn unwindWithFramePointer(self: *const StackIterator) ?Registers {
+    const frame_pointer = self.registers.frame_pointer;
+
+    return .{
+        .instruction_pointer = self.readStack(frame_pointer +% @sizeOf(usize)) orelse return null,
+        .stack_pointer = frame_pointer +% 2 * @sizeOf(usize),
+        .frame_pointer = self.readStack(frame_pointer) orelse return null,
+    };
+}
+
+/// Reads the word at `address` if it is part of the frame being unwound.
+fn readStack(self: *const StackIterator, address: usize) ?usize {
+    const stack = self.stack orelse return null;
+
+    if (!std.mem.isAligned(address, @alignOf(usize))) return null;
+
+    // frames are above the stack pointer of the frame being unwound
+    if (address < self.registers.stack_pointer) return null;
+
+    if (address < stack.address.value) return null;
+    if (address > stack.end().value - @sizeOf(usize)) return null;
+
+    return @as(*const usize, @ptrFromInt(address)).*;
+}
+
+inline fn addOffset(address: usize, offset: anytype) usize {
+    return address +% @as(usize, @bitCast(@as(isize, offset)));
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+
+//! The symbol table generated from the kernel at build time and loaded as a module by the bootloader.
+//!
+//! Symbols, source locations and unwind entries are found by a binary search, without allocating, so addresses can be
+//! symbolized and stacks unwound outside of a panic.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const format = @import("symbol_table_format.zig");
+const symbol_map = @import("symbol_map.zig");
+
+const SymbolTable = @This();
+
+symbols: []const format.SymbolEntry,
+lines: []const format.LineEntry,
+unwind_entries: []const format.UnwindEntry,
+string_pool: []const u8,
+
+pub fn init(bytes: []const u8) !SymbolTable {
+    if (bytes.len < @sizeOf(format.Header)) return error.Truncated;
+    if (!std.mem.isAligned(@intFromPtr(bytes.ptr), @alignOf(format.SymbolEntry))) return error.Misaligned;
+
+    const header: *const format.Header = @ptrCast(@alignCast(bytes.ptr));
+    if (!std.mem.eql(u8, &header.magic, &format.magic)) return error.InvalidMagic;
+    if (header.version != format.version) return error.UnsupportedVersion;
+
+    const symbols_offset = @sizeOf(format.Header);
+    const lines_offset = symbols_offset + @as(usize, header.number_of_symbols) * @sizeOf(format.SymbolEntry);
+    const unwind_entries_offset = lines_offset + @as(usize, header.number_of_lines) * @sizeOf(format.LineEntry);
+    const string_pool_offset = unwind_entries_offset +
+        @as(usize, header.number_of_unwind_entries) * @sizeOf(format.UnwindEntry);
+
+    const end_offset = string_pool_offset + header.string_pool_size;
+    if (bytes.len < end_offset) return error.Truncated;
+
+    if (kernel.arch.crc32c(bytes[symbols_offset..end_offset]) != header.checksum) return error.ChecksumMismatch;
+
+    const symbols_ptr: [*]const format.SymbolEntry = @ptrCast(@alignCast(bytes.ptr + symbols_offset));
+    const lines_ptr: [*]const format.LineEntry = @ptrCast(@alignCast(bytes.ptr + lines_offset));
+    const unwind_entries_ptr: [*]const format.UnwindEntry = @ptrCast(@alignCast(bytes.ptr + unwind_entries_offset));
+
+    return .{
+        .symbols = symbols_ptr[0..header.number_of_symbols],
+        .lines = lines_ptr[0..header.number_of_lines],
+        .unwind_entries = unwind_entries_ptr[0..header.number_of_unwind_entries],
+        .string_pool = bytes[string_pool_offset..][0..header.string_pool_size],
+    };
+}
+
+/// Gets the symbol for the given address. Returns null if no symbol was found.
+pub fn getSymbol(self: *const SymbolTable, address: usize) ?symbol_map.Symbol {
+    const symbol = findLast(format.SymbolEntry, self.symbols, address) orelse return null;
+    if (address - symbol.address >= symbol.size) return null;
+
+    const name = self.getString(symbol.name) orelse return null;
+
+    const location: ?symbol_map.Symbol.Location = location: {
+        const line = findLast(format.LineEntry, self.lines, address) orelse break :location null;
+        if (line.line == 0) break :location null;
+
+        break :location .{
+            .is_line_expected_to_be_precise = true,
+            .file_name = self.getString(line.file) orelse break :location null,
+            .line = line.line,
+            .column = if (line.column != 0) line.column else null,
+        };
+    };
+
+    return .{
+        .address = address,
+        .name = name,
+        .location = location,
+    };
+}
+
+/// Gets the unwind entry covering the given address. Returns null if the address cannot be unwound.
+pub fn getUnwindEntry(self: *const SymbolTable, address: usize) ?*const format.UnwindEntry {
+    const entry = findLast(format.UnwindEntry, self.unwind_entries, address) orelse return null;
+    if (entry.cfa_register == .none) return null;
+    return entry;
+}
+
+fn getString(self: *const SymbolTable, reference: format.StringReference) ?[]const u8 {
+    if (@as(usize, reference.offset) + reference.length > self.string_pool.len) return null;
+    return self.string_pool[reference.offset..][0..reference.length];
+}
+
+/// Returns the last entry with an address less than or equal to `address`.
+fn findLast(comptime Entry: type, entries: []const Entry, address: usize) ?*const Entry {
+    // the number of entries with an address less than or equal to `address`
+    var low: usize = 0;
+    var high: usize = entries.len;
+
+    while (low < high) {
+        const middle = low + (high - low) / 2;
+        if (entries[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return if (low == 0) null else &entries[low - 1];
+}
@@ -4,7 +4,9 @@ const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
 
-const symbol_map = @import("symbol_map.zig");
+const embedded_source_format = @import("embedded_source_format.zig");
+pub const StackIterator = @import("StackIterator.zig");
+pub const symbol_map = @import("symbol_map.zig");
 
 pub const PanicState = enum(u8) {
     no_op = 0,
@@ -52,6 +54,9 @@ fn simplePanic(
     stack_trace: ?*const std.builtin.StackTrace,
     ret_addr: usize,
 ) void {
+    // messages logged before the panic are likely to explain it
+    kernel.log.flush();
+
     const writer = kernel.arch.setup.getEarlyOutputWriter();
 
     writer.print("\nPANIC: {s}\n\n", .{msg}) catch unreachable;
@@ -91,7 +96,7 @@ fn printStackTrace(writer: anytype, stack_trace: *const std.builtin.StackTrace)
 }
 
 fn printCurrentBackTrace(writer: anytype, return_address: usize) void {
-    var stack_iter = std.debug.StackIterator.init(return_address, @frameAddress());
+    var stack_iter = StackIterator.initCurrent(return_address);
 
     while (stack_iter.next()) |address| {
         printSourceAtAddress(writer, address);
@@ -212,9 +217,16 @@ fn printSymbol(writer: anytype, symbol: symbol_map.Symbol) void {
         writer.writeAll(" (symbols line information is inprecise)") catch unreachable;
     }
 
-    const file_contents = embedded_source_files.get(location.file_name) orelse return;
+    const embedded_file = embedded_source_files.get(location.file_name) orelse return;
 
-    const line = findTargetLine(file_contents, location.line) orelse {
+    // the lock may be held by code this panic or backtrace interrupted, spinning on it would never print anything
+    const held = source_line_lock.tryGrab() orelse {
+        writer.writeByte('\n') catch unreachable;
+        return;
+    };
+    defer held.unlock();
+
+    const line = findTargetLine(embedded_file, location.line, &source_line_buffer) orelse {
         // no matching line found
         writer.writeAll(comptime "\n" ++ (indent ** 2)) catch unreachable;
         writer.writeAll("no such line in file?\n") catch unreachable;
@@ -245,19 +257,64 @@ fn printSymbol(writer: anytype, symbol: symbol_map.Symbol) void {
     }
 }
 
-/// Finds the target line in the given file contents.
+/// Serializes use of `source_line_buffer` and `decompression_buffer`.
+///
+/// Only ever try-grabbed, as it may be held by code interrupted by a panic or by an interrupt printing a backtrace.
+var source_line_lock: kernel.SpinLock = .{};
+
+/// Lines longer than this are truncated.
+var source_line_buffer: [256]u8 = undefined;
+
+/// Backs the allocations of the deflate decompressor, which are dominated by its 32KiB history window.
+var decompression_buffer: [64 * 1024]u8 = undefined;
+
+/// Finds the target line in the given embedded file, see `embedded_source_format.zig`.
+///
+/// The offsets of the line are looked up directly in the line table of the file, then the file is only decompressed
+/// up to the end of the target line.
 ///
 /// Returns the line contents if found, otherwise returns null.
-fn findTargetLine(file_contents: []const u8, target_line_number: usize) ?[]const u8 {
-    var line_iter = std.mem.split(u8, file_contents, "\n");
-    var line_index: u64 = 1;
+fn findTargetLine(embedded_file: []const u8, target_line_number: usize, buffer: []u8) ?[]const u8 {
+    const Header = embedded_source_format.Header;
 
-    while (line_iter.next()) |line| : (line_index += 1) {
-        if (line_index != target_line_number) continue;
-        return line;
-    }
+    if (embedded_file.len < @sizeOf(Header)) return null;
+
+    const number_of_lines = std.mem.readIntLittle(u32, embedded_file[@offsetOf(Header, "number_of_lines")..][0..4]);
+    const uncompressed_size = std.mem.readIntLittle(u32, embedded_file[@offsetOf(Header, "uncompressed_size")..][0..4]);
+
+    if (target_line_number == 0 or target_line_number > number_of_lines) return null;
+
+    const line_offsets = embedded_file[@sizeOf(Header)..];
+    const compressed_offset = @sizeOf(Header) + @as(usize, number_of_lines) * @sizeOf(u32);
+    if (embedded_file.len < compressed_offset) return null;
+
+    const line_index = target_line_number - 1;
+
+    const line_start = std.mem.readIntLittle(u32, line_offsets[line_index * @sizeOf(u32) ..][0..4]);
+    const line_end = if (line_index + 1 < number_of_lines)
+        // the offset of the next line minus the newline
+        std.mem.readIntLittle(u32, line_offsets[(line_index + 1) * @sizeOf(u32) ..][0..4]) - 1
+    else
+        uncompressed_size;
+
+    const line_length = @min(line_end - line_start, buffer.len);
+
+    var fixed_buffer_allocator = std.heap.FixedBufferAllocator.init(&decompression_buffer);
+    var compressed_stream = std.io.fixedBufferStream(embedded_file[compressed_offset..]);
+
+    var decompressor = std.compress.deflate.decompressor(
+        fixed_buffer_allocator.allocator(),
+        compressed_stream.reader(),
+        null,
+    ) catch return null;
+    defer decompressor.deinit();
+
+    const reader = decompressor.reader();
+
+    reader.skipBytes(line_start, .{}) catch return null;
+    reader.readNoEof(buffer[0..line_length]) catch return null;
 
-    return null;
+    return buffer[0..line_length];
 }
 
 const embedded_source_files = std.ComptimeStringMap([]const u8, embedded_source_files: {
@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: MIT
+
+//! The format of the source files embedded in the kernel for printing source lines in stack traces, shared by the
+//! build that generates them and the kernel that reads them.
+//!
+//! Each file is a `Header`, followed by the `Header.number_of_lines` little endian u32 offsets of the start of each
+//! line in the uncompressed contents and finally the contents compressed with deflate.
+
+pub const Header = extern struct {
+    number_of_lines: u32,
+    uncompressed_size: u32,
+};
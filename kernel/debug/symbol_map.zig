@@ -4,30 +4,50 @@ const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
 
-const DwarfSymbolMap = @import("DwarfSymbolMap.zig");
+const SymbolTable = @import("SymbolTable.zig");
 
-var dwarf_symbol_map_spinlock: kernel.SpinLock = .{};
-var dwarf_symbol_map_opt: ?DwarfSymbolMap = null;
+pub const UnwindEntry = @import("symbol_table_format.zig").UnwindEntry;
+
+/// Serializes loading of the symbol maps, readers never take this lock.
+var load_symbols_spinlock: kernel.SpinLock = .{};
+
+var symbol_table_storage: SymbolTable = undefined;
+
+/// Published using RCU once `symbol_table_storage` is fully initialized.
+var symbol_table_opt: ?*SymbolTable = null;
+
+/// Set once loading has been attempted, regardless of whether it succeeded.
+var load_attempted: bool = false;
 
 pub fn loadSymbols() void {
-    if (dwarf_symbol_map_opt == null) {
-        const held = dwarf_symbol_map_spinlock.lock();
-        defer held.unlock();
-        if (dwarf_symbol_map_opt == null) {
-            dwarf_symbol_map_opt = DwarfSymbolMap.init(kernel.info.kernel_file.address.toPtr([*]const u8)) catch null;
-        }
+    if (@atomicLoad(bool, &load_attempted, .Acquire)) return;
+
+    const held = load_symbols_spinlock.lock();
+    defer held.unlock();
+
+    if (@atomicLoad(bool, &load_attempted, .Acquire)) return;
+
+    if (kernel.boot.symbolTable()) |symbol_table_bytes| {
+        if (SymbolTable.init(symbol_table_bytes)) |symbol_table| {
+            symbol_table_storage = symbol_table;
+            kernel.rcu.assignPointer(?*SymbolTable, &symbol_table_opt, &symbol_table_storage);
+        } else |_| {}
     }
+
+    @atomicStore(bool, &load_attempted, true, .Release);
 }
 
 /// Gets the symbol for the given address.
+///
+/// Must be called with either interrupts disabled or inside a `kernel.rcu` read-side critical section.
 pub fn getSymbol(address: usize) ?Symbol {
     // We subtract one from the address to better handle the case when the address is the last instruction of the
     // function (for example `@panic` as the very last statement of a function) as in that case the return
     // address will actually point at the first instruction _after_ intended function
     const safer_address = address - 1;
 
-    if (dwarf_symbol_map_opt) |*dwarf_symbol_map| {
-        if (dwarf_symbol_map.getSymbol(safer_address)) |symbol| {
+    if (kernel.rcu.dereference(?*SymbolTable, &symbol_table_opt)) |symbol_table| {
+        if (symbol_table.getSymbol(safer_address)) |symbol| {
             return symbol;
         }
     }
@@ -35,6 +55,17 @@ pub fn getSymbol(address: usize) ?Symbol {
     return null;
 }
 
+/// Gets the unwind entry covering the given address.
+///
+/// Unlike `getSymbol` the address is not adjusted, the caller knows whether it is a return address.
+///
+/// Never locks, so can be used from non-maskable interrupts. Must be called with either interrupts disabled or inside a
+/// `kernel.rcu` read-side critical section.
+pub fn getUnwindEntry(address: usize) ?*const UnwindEntry {
+    const symbol_table = kernel.rcu.dereference(?*SymbolTable, &symbol_table_opt) orelse return null;
+    return symbol_table.getUnwindEntry(address);
+}
+
 pub const Symbol = struct {
     /// The address of the symbol.
     address: usize,
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+
+//! The format of the symbol table generated from the kernel at build time, shared by the build step that writes it and
+//! the kernel that reads it.
+//!
+//! The table is a `Header`, followed by the `SymbolEntry`s sorted by address, the `LineEntry`s sorted by address, the
+//! `UnwindEntry`s sorted by address and finally a pool of deduplicated strings that the entries reference by offset
+//! and length.
+//!
+//! The header holds a CRC-32C checksum of everything that follows it.
+
+pub const magic = "CASCSYMS".*;
+
+/// Incremented on every incompatible change to the format.
+pub const version: u32 = 3;
+
+pub const Header = extern struct {
+    magic: [8]u8 = magic,
+    version: u32 = version,
+    number_of_symbols: u32,
+    number_of_lines: u32,
+    number_of_unwind_entries: u32,
+    string_pool_size: u32,
+
+    /// The CRC-32C checksum of the entries and string pool, also keeps the entries that follow the header aligned.
+    checksum: u32 = 0,
+};
+
+comptime {
+    if (@sizeOf(Header) % @alignOf(SymbolEntry) != 0) @compileError("entries following the header must be aligned");
+}
+
+pub const StringReference = extern struct {
+    /// The offset of the string from the start of the string pool.
+    offset: u32,
+    length: u32,
+};
+
+/// A function.
+pub const SymbolEntry = extern struct {
+    address: u64,
+    size: u64,
+    name: StringReference,
+};
+
+/// The source location of every address from `address` up to the address of the next entry.
+pub const LineEntry = extern struct {
+    address: u64,
+    file: StringReference,
+
+    /// Zero if the addresses have no source location.
+    line: u32,
+
+    /// Zero if the column is unknown.
+    column: u32,
+};
+
+/// How to find the caller of every address from `address` up to the address of the next entry, precomputed from the
+/// call frame information of the kernel so that unwinding is a lookup rather than running CFI programs.
+pub const UnwindEntry = extern struct {
+    address: u64,
+
+    /// The offset of the canonical frame address from `cfa_register`.
+    cfa_offset: i32,
+
+    /// The offset from the canonical frame address the return address is saved at, zero if it is not saved on the
+    /// stack.
+    return_address_offset: i16,
+
+    /// The offset from the canonical frame address the frame pointer of the caller is saved at, zero if the frame
+    /// pointer still holds it.
+    frame_pointer_offset: i16,
+
+    cfa_register: CfaRegister,
+
+    _reserved: [7]u8 = [_]u8{0} ** 7,
+
+    pub const CfaRegister = enum(u8) {
+        /// The addresses cannot be unwound.
+        none = 0,
+
+        stack_pointer = 1,
+        frame_pointer = 2,
+    };
+};
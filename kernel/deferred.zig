@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: MIT
+
+//! Deferred interrupt work.
+//!
+//! Interrupt handlers keep the time spent with interrupts disabled short by doing only what must be done immediately
+//! and queueing the rest with `queue`, which is then run on the same processor with interrupts enabled as the
+//! interrupt returns.
+//!
+//! At most `maximum_work_per_batch` items are run each time an interrupt returns. Any remaining work is handed to the
+//! worker task of the processor, which runs it in batches of the same size and yields between them, so a flood of
+//! interrupts cannot starve every other task. While the worker is active returning from an interrupt runs no work,
+//! so work always runs in the order it was queued.
+//!
+//! Work runs with preemption disabled, possibly on the stack of whichever task was interrupted, so it must not block.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+const Task = kernel.Task;
+
+const log = kernel.log.scoped(.deferred);
+
+/// The maximum number of work items run by a single batch.
+///
+/// Bounds the time an interrupted task is delayed by work it did not queue.
+const maximum_work_per_batch = 32;
+
+/// A deferred work item, intended to be embedded in the structure it operates on.
+///
+/// Use `@fieldParentPtr` in the callback to get back to the containing structure.
+pub const Work = struct {
+    next: ?*Work = null,
+    callback: Callback = undefined,
+
+    /// Set while the work is queued.
+    queued: bool = false,
+
+    /// Called with interrupts enabled and preemption disabled on the processor the work was queued on.
+    ///
+    /// The work is no longer queued when the callback is called, so it may be queued again.
+    pub const Callback = *const fn (work: *Work) void;
+};
+
+/// Per-processor deferred work state.
+///
+/// Only accessed by the owning processor with interrupts disabled, except for `worker`.
+pub const ProcessorState = struct {
+    /// Work queued on this processor.
+    queue: WorkQueue = .{},
+
+    /// Set while this processor is running a batch, stops an interrupt arriving during the batch from starting
+    /// another.
+    running: bool = false,
+
+    /// Set while the worker task is responsible for running the queued work.
+    worker_active: bool = false,
+
+    /// Runs the work that did not fit into a batch, created by `init`.
+    worker: ?*Task = null,
+};
+
+/// Creates the worker task of every processor.
+///
+/// Until this is called work that does not fit into a batch waits for the next interrupt.
+///
+/// Only called once during `setup`, after every processor has been started.
+pub fn init() void {
+    for (Processor.all) |*processor| {
+        const worker = Task.create(workerTask, @intFromPtr(processor)) catch |err| {
+            core.panicFmt("failed to create deferred work task: {s}", .{@errorName(err)});
+        };
+        worker.pinned_processor = processor.id;
+
+        @atomicStore(?*Task, &processor.deferred.worker, worker, .Release);
+    }
+}
+
+/// Queues `work` to call `callback` on the current processor.
+///
+/// Returns false if `work` was already queued, in which case it only runs once.
+///
+/// Intended to be called from interrupt handlers. When called with interrupts enabled the work would otherwise wait
+/// for the next interrupt, so it is handed to the worker task.
+pub fn queue(work: *Work, callback: Work.Callback) bool {
+    if (@cmpxchgStrong(bool, &work.queued, false, true, .Acquire, .Monotonic) != null) return false;
+
+    work.callback = callback;
+
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const state = &Processor.current().deferred;
+
+    state.queue.append(work);
+
+    if (interrupts_enabled and !state.running) activateWorker(state);
+
+    return true;
+}
+
+/// Runs a batch of the work queued on the current processor, handing anything left over to its worker task.
+///
+/// Called by the architecture with interrupts disabled as an interrupt returns, on the stack of the interrupted
+/// task. Interrupts are enabled while the work runs and disabled again before returning.
+pub fn runFromInterrupt() void {
+    const processor = Processor.current();
+    const state = &processor.deferred;
+
+    if (state.queue.isEmpty() or state.running or state.worker_active) return;
+
+    runBatch(processor);
+
+    if (!state.queue.isEmpty()) activateWorker(state);
+}
+
+/// Runs up to `maximum_work_per_batch` items queued on `processor` with interrupts enabled and preemption disabled.
+///
+/// Must be called with interrupts disabled on `processor`, returns with interrupts disabled.
+fn runBatch(processor: *Processor) void {
+    const state = &processor.deferred;
+
+    var batch = state.queue.takeFirst(maximum_work_per_batch);
+
+    state.running = true;
+    Processor.disablePreemption();
+    kernel.arch.interrupts.enableInterrupts();
+
+    while (batch.pop()) |work| {
+        // `work` may be queued again, possibly on another processor, as soon as `queued` is cleared
+        @atomicStore(bool, &work.queued, false, .Release);
+        work.callback(work);
+    }
+
+    kernel.arch.interrupts.disableInterrupts();
+    Processor.enablePreemption();
+    state.running = false;
+}
+
+/// Makes the worker task responsible for the queued work and wakes it.
+///
+/// Must be called with interrupts disabled.
+fn activateWorker(state: *ProcessorState) void {
+    if (state.worker_active) return;
+
+    const worker = @atomicLoad(?*Task, &state.worker, .Acquire) orelse return;
+
+    state.worker_active = true;
+    kernel.scheduler.wake(worker);
+}
+
+fn workerTask(argument: usize) void {
+    // the worker is pinned so this is always the current processor
+    const processor: *Processor = @ptrFromInt(argument);
+    const state = &processor.deferred;
+
+    log.debug("deferred work task started on processor {}", .{@intFromEnum(processor.id)});
+
+    while (true) {
+        kernel.arch.interrupts.disableInterrupts();
+
+        if (state.queue.isEmpty()) {
+            state.worker_active = false;
+            kernel.arch.interrupts.enableInterrupts();
+
+            // work queued before this blocks wakes the task again, making the block return immediately
+            kernel.scheduler.block();
+            continue;
+        }
+
+        runBatch(processor);
+
+        kernel.arch.interrupts.enableInterrupts();
+
+        // let other tasks run between batches
+        kernel.scheduler.yield();
+    }
+}
+
+/// A singly linked list of work that tracks its last element to allow constant time appends.
+const WorkQueue = struct {
+    first: ?*Work = null,
+    last: ?*Work = null,
+    len: usize = 0,
+
+    fn isEmpty(self: *const WorkQueue) bool {
+        return self.first == null;
+    }
+
+    fn append(self: *WorkQueue, work: *Work) void {
+        work.next = null;
+
+        if (self.last) |last| {
+            last.next = work;
+        } else {
+            self.first = work;
+        }
+
+        self.last = work;
+        self.len += 1;
+    }
+
+    fn pop(self: *WorkQueue) ?*Work {
+        const work = self.first orelse return null;
+
+        self.first = work.next;
+        if (self.first == null) self.last = null;
+        self.len -= 1;
+
+        work.next = null;
+        return work;
+    }
+
+    /// Removes up to `count` items from the front of this queue and returns them.
+    fn takeFirst(self: *WorkQueue, count: usize) WorkQueue {
+        if (self.len <= count) {
+            const taken = self.*;
+            self.* = .{};
+            return taken;
+        }
+
+        var taken: WorkQueue = .{ .first = self.first, .len = count };
+
+        var last = self.first.?;
+        for (1..count) |_| last = last.next.?;
+
+        self.first = last.next;
+        self.len -= count;
+
+        last.next = null;
+        taken.last = last;
+
+        return taken;
+    }
+};
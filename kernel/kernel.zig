@@ -4,15 +4,28 @@ const std = @import("std");
 const core = @import("core");
 
 pub const arch = @import("arch/arch.zig");
+pub const benchmarks = @import("benchmarks/benchmarks.zig");
 pub const boot = @import("boot/boot.zig");
+pub const cross_call = @import("cross_call.zig");
 pub const debug = @import("debug/debug.zig");
+pub const deferred = @import("deferred.zig");
 pub const info = @import("info.zig");
 pub const log = @import("log.zig");
+pub const performance_counters = @import("performance_counters.zig");
 pub const pmm = @import("pmm.zig");
+pub const profiler = @import("profiler.zig");
+pub const rcu = @import("rcu.zig");
+pub const scheduler = @import("scheduler/scheduler.zig");
 pub const setup = @import("setup.zig");
+pub const syscall = @import("syscall.zig");
+pub const time = @import("time.zig");
+pub const timer = @import("timer.zig");
+pub const trace = @import("trace/trace.zig");
 pub const vmm = @import("vmm.zig");
 
+pub const Processor = @import("Processor.zig");
 pub const SpinLock = @import("SpinLock.zig");
+pub const Task = @import("Task.zig");
 
 const address = @import("address.zig");
 pub const PhysicalAddress = address.PhysicalAddress;
@@ -1,40 +1,414 @@
 // SPDX-License-Identifier: MIT
 
+//! Kernel logging.
+//!
+//! During early boot messages are written directly to the early output with a lock serializing processors.
+//!
+//! Once `init` has been called messages are instead formatted into a lock-free per-processor ring buffer, tagged with
+//! a global sequence number, and written to the early output by a background task that merges the rings in sequence
+//! order. Logging is then a format and a copy rather than waiting on the output device, and messages from different
+//! processors are never interleaved.
+//!
+//! If a ring is full the message is dropped and counted, the drainer reports the number of dropped messages.
+//!
+//! With the `binary_log` option a message whose arguments contain no pointers is not formatted when it is logged,
+//! instead the raw bytes of its arguments are copied into the ring along with the address of a formatter generated at
+//! comptime for its call site, which the drainer calls to produce the text. Logging is then a copy of a few words, so
+//! verbose logging can stay enabled without changing the timing of the code being logged.
+
 const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
 const kernel_options = @import("kernel_options");
 
+/// Set by `init` once messages are written to the per-processor rings.
 var initialized: bool = false;
 
+/// Serializes output from multiple processors during early boot.
+var early_log_lock: kernel.SpinLock = .{};
+
+/// The size of the ring of each processor, must be a power of two.
+const ring_size = 16 * 1024;
+
+/// Messages longer than this, including the scope and level, are truncated.
+const maximum_message_length = 256;
+
+/// Records start on this alignment, so a header never wraps around the end of a ring.
+const record_alignment = @sizeOf(RecordHeader);
+
+/// The sequence number of the next message.
+var next_sequence: u64 = 0;
+
+/// Set while a consumer is reading the rings, the rings have a single consumer so only one of the drainer and `flush`
+/// may read them at a time.
+var draining: bool = false;
+
+/// The shortest interval between the drainer checking the rings, used while messages are arriving.
+const minimum_drain_interval_ns = std.time.ns_per_ms;
+
+/// The longest interval between the drainer checking the rings, backed off to while no messages are arriving.
+const maximum_drain_interval_ns = 100 * std.time.ns_per_ms;
+
+const RecordHeader = extern struct {
+    sequence: u64,
+
+    /// Nanoseconds since `kernel.time.init` when the message was logged.
+    timestamp: u64,
+
+    /// The address of the `Formatter` for the arguments in the record, zero if the record contains text.
+    formatter: u64,
+
+    length: u64,
+};
+
+/// Formats the raw argument bytes of a binary record into `buffer`.
+const Formatter = *const fn (arguments: []const u8, buffer: *[maximum_message_length]u8) []const u8;
+
+/// Per-processor log state.
+pub const ProcessorState = struct {
+    /// Records waiting to be written out.
+    ring: [ring_size]u8 align(record_alignment) = undefined,
+
+    /// The total number of bytes ever written to `ring`, only modified by the owning processor.
+    write_position: usize = 0,
+
+    /// The total number of bytes ever consumed from `ring`, only modified while holding `draining`.
+    read_position: usize = 0,
+
+    /// The number of messages dropped because `ring` was full, only modified by the owning processor.
+    dropped: usize = 0,
+
+    /// The value of `dropped` the drainer last reported.
+    reported_dropped: usize = 0,
+
+    /// Messages are formatted here before being copied into `ring`.
+    format_buffer: [maximum_message_length]u8 = undefined,
+
+    /// Appends a record containing `bytes` to the ring, `formatter` is zero if `bytes` is text.
+    ///
+    /// Must be called by the owning processor with interrupts disabled.
+    fn append(self: *ProcessorState, formatter: u64, bytes: []const u8) void {
+        const record_size = std.mem.alignForward(usize, @sizeOf(RecordHeader) + bytes.len, record_alignment);
+
+        const read_position = @atomicLoad(usize, &self.read_position, .Acquire);
+        if (ring_size - (self.write_position - read_position) < record_size) {
+            @atomicStore(usize, &self.dropped, self.dropped + 1, .Monotonic);
+            return;
+        }
+
+        const header: RecordHeader = .{
+            .sequence = @atomicRmw(u64, &next_sequence, .Add, 1, .Monotonic),
+            .timestamp = kernel.time.monotonicNanoseconds(),
+            .formatter = formatter,
+            .length = bytes.len,
+        };
+
+        const offset = self.write_position % ring_size;
+        @memcpy(self.ring[offset..][0..@sizeOf(RecordHeader)], std.mem.asBytes(&header));
+        self.copyIn((offset + @sizeOf(RecordHeader)) % ring_size, bytes);
+
+        // publishes the record to the drainer
+        @atomicStore(usize, &self.write_position, self.write_position + record_size, .Release);
+    }
+
+    /// Returns the header of the oldest record in the ring, null if it is empty.
+    ///
+    /// Must only be called while holding `draining`.
+    fn peek(self: *const ProcessorState) ?RecordHeader {
+        const write_position = @atomicLoad(usize, &self.write_position, .Acquire);
+        if (self.read_position == write_position) return null;
+
+        return std.mem.bytesToValue(
+            RecordHeader,
+            self.ring[self.read_position % ring_size ..][0..@sizeOf(RecordHeader)],
+        );
+    }
+
+    /// Copies the contents of the oldest record into `buffer` and removes it from the ring.
+    ///
+    /// Must only be called while holding `draining`, after `peek` returned `header`.
+    fn take(self: *ProcessorState, header: RecordHeader, buffer: *[maximum_message_length]u8) []const u8 {
+        const contents = buffer[0..header.length];
+        self.copyOut((self.read_position + @sizeOf(RecordHeader)) % ring_size, contents);
+
+        const record_size = std.mem.alignForward(usize, @sizeOf(RecordHeader) + header.length, record_alignment);
+
+        // hands the space back to the owning processor
+        @atomicStore(usize, &self.read_position, self.read_position + record_size, .Release);
+
+        return contents;
+    }
+
+    fn copyIn(self: *ProcessorState, offset: usize, bytes: []const u8) void {
+        const first_length = @min(bytes.len, ring_size - offset);
+        @memcpy(self.ring[offset..][0..first_length], bytes[0..first_length]);
+        @memcpy(self.ring[0 .. bytes.len - first_length], bytes[first_length..]);
+    }
+
+    fn copyOut(self: *const ProcessorState, offset: usize, bytes: []u8) void {
+        const first_length = @min(bytes.len, ring_size - offset);
+        @memcpy(bytes[0..first_length], self.ring[offset..][0..first_length]);
+        @memcpy(bytes[first_length..], self.ring[0 .. bytes.len - first_length]);
+    }
+};
+
+/// Starts the drainer task and switches to logging into the per-processor rings.
+///
+/// Only called once during `setup`, once the scheduler is able to run tasks.
+pub fn init() void {
+    _ = kernel.scheduler.spawn(drainer, 0) catch |err| {
+        core.panicFmt("failed to start log drainer: {s}", .{@errorName(err)});
+    };
+
+    @atomicStore(bool, &initialized, true, .Release);
+}
+
+/// Writes every message in the per-processor rings to the early output.
+///
+/// Called by the panic handler so that messages logged before the panic are not lost.
+///
+/// If the drainer is part way through draining, either on another processor or interrupted on this one, the flush is
+/// skipped rather than reading the rings concurrently with it.
+pub fn flush() void {
+    if (!@atomicLoad(bool, &initialized, .Acquire)) return;
+
+    const writer = kernel.arch.setup.getEarlyOutputWriter();
+
+    if (!tryDrain(writer)) {
+        writer.writeAll("log flush skipped, the drainer is running\n") catch {};
+    }
+}
+
+/// Blocks until every message logged before the call has been written out.
+///
+/// Allows logging large amounts of output, such as a profile, without overflowing the rings and dropping messages.
+///
+/// Must be called from a task.
+pub fn waitForDrain() void {
+    if (!@atomicLoad(bool, &initialized, .Acquire)) return;
+
+    for (kernel.Processor.all) |*processor| {
+        const state = &processor.log_buffer;
+
+        const target = @atomicLoad(usize, &state.write_position, .Acquire);
+        while (@atomicLoad(usize, &state.read_position, .Acquire) < target) {
+            kernel.timer.sleepNanoseconds(minimum_drain_interval_ns);
+        }
+    }
+}
+
+fn drainer(argument: usize) void {
+    _ = argument;
+
+    var interval: u64 = minimum_drain_interval_ns;
+
+    while (true) {
+        if (tryDrain(kernel.arch.setup.getEarlyOutputWriter())) {
+            interval = minimum_drain_interval_ns;
+        } else {
+            interval = @min(interval * 2, maximum_drain_interval_ns);
+        }
+
+        kernel.timer.sleepNanoseconds(interval);
+    }
+}
+
+/// Drains the rings unless another consumer is already draining them, returns true if any messages were written.
+fn tryDrain(writer: anytype) bool {
+    if (@cmpxchgStrong(bool, &draining, false, true, .Acquire, .Monotonic) != null) return false;
+    defer @atomicStore(bool, &draining, false, .Release);
+
+    return drain(writer);
+}
+
+/// Writes out every message in the rings in sequence order, returns true if there were any.
+///
+/// Must only be called through `tryDrain`.
+fn drain(writer: anytype) bool {
+    var buffer: [maximum_message_length]u8 = undefined;
+    var format_buffer: [maximum_message_length]u8 = undefined;
+    var drained_any = false;
+
+    while (true) {
+        var oldest_state: ?*ProcessorState = null;
+        var oldest_header: RecordHeader = undefined;
+
+        for (kernel.Processor.all) |*processor| {
+            const state = &processor.log_buffer;
+            const header = state.peek() orelse continue;
+
+            if (oldest_state == null or header.sequence < oldest_header.sequence) {
+                oldest_state = state;
+                oldest_header = header;
+            }
+        }
+
+        const state = oldest_state orelse break;
+
+        const contents = state.take(oldest_header, &buffer);
+
+        const seconds = oldest_header.timestamp / std.time.ns_per_s;
+        const microseconds = (oldest_header.timestamp % std.time.ns_per_s) / std.time.ns_per_us;
+        writer.print("[{d:>5}.{d:0>6}] ", .{ seconds, microseconds }) catch {};
+
+        if (oldest_header.formatter == 0) {
+            writer.writeAll(contents) catch {};
+        } else {
+            const formatter: Formatter = @ptrFromInt(oldest_header.formatter);
+            writer.writeAll(formatter(contents, &format_buffer)) catch {};
+        }
+
+        drained_any = true;
+    }
+
+    for (kernel.Processor.all) |*processor| {
+        const state = &processor.log_buffer;
+
+        const dropped = @atomicLoad(usize, &state.dropped, .Monotonic);
+        if (dropped == state.reported_dropped) continue;
+
+        writer.print("{} log messages dropped on processor {}\n", .{
+            dropped - state.reported_dropped,
+            @intFromEnum(processor.id),
+        }) catch {};
+        state.reported_dropped = dropped;
+    }
+
+    return drained_any;
+}
+
 pub fn scoped(comptime scope: @Type(.EnumLiteral)) type {
     return struct {
+        /// The runtime level of this scope.
+        var state: ScopeState linksection(".log_scopes") = .{
+            .name = @tagName(scope),
+            .level = initialLevelFor(scope),
+        };
+
         pub inline fn err(comptime format: []const u8, args: anytype) void {
-            if (comptime !levelEnabled(.err)) return;
+            if (!levelEnabled(.err)) return;
             logFnDispatch(scope, .err, format, args);
         }
 
         pub inline fn warn(comptime format: []const u8, args: anytype) void {
-            if (comptime !levelEnabled(.warn)) return;
+            if (!levelEnabled(.warn)) return;
             logFnDispatch(scope, .warn, format, args);
         }
 
         pub inline fn info(comptime format: []const u8, args: anytype) void {
-            if (comptime !levelEnabled(.info)) return;
+            if (!levelEnabled(.info)) return;
             logFnDispatch(scope, .info, format, args);
         }
 
         pub inline fn debug(comptime format: []const u8, args: anytype) void {
-            if (comptime !levelEnabled(.debug)) return;
+            if (!levelEnabled(.debug)) return;
             logFnDispatch(scope, .debug, format, args);
         }
 
+        /// Returns true if messages of `message_level` are logged for this scope, so work only needed to produce them
+        /// can be skipped.
+        ///
+        /// Compiles to false if the level is not compiled in, otherwise checks the runtime level of the scope.
         pub inline fn levelEnabled(comptime message_level: kernel.log.Level) bool {
+            if (comptime !levelCompiledIn(message_level)) return false;
+            return runtimeLevelEnabled(message_level);
+        }
+
+        /// Returns true if messages of `message_level` are compiled in for this scope.
+        ///
+        /// Whether they are actually logged also depends on the runtime level of the scope, see `levelEnabled`.
+        pub inline fn levelCompiledIn(comptime message_level: kernel.log.Level) bool {
             comptime return loggingEnabledFor(scope, message_level);
         }
+
+        inline fn runtimeLevelEnabled(comptime message_level: kernel.log.Level) bool {
+            return @intFromEnum(message_level) <= @intFromEnum(@atomicLoad(Level, &state.level, .Monotonic));
+        }
     };
 }
 
+/// The runtime level of a scope.
+///
+/// One is placed in the `.log_scopes` section for every scope used in the kernel, so they can be found by name.
+const ScopeState = struct {
+    name: []const u8,
+
+    /// Messages more verbose than this are not logged.
+    level: Level,
+};
+
+const linker_symbols = struct {
+    extern var __log_scopes_start: ScopeState;
+    extern var __log_scopes_end: ScopeState;
+};
+
+fn scopeStates() []ScopeState {
+    const start: [*]ScopeState = @ptrCast(&linker_symbols.__log_scopes_start);
+    const length = @intFromPtr(&linker_symbols.__log_scopes_end) - @intFromPtr(start);
+    return start[0 .. length / @sizeOf(ScopeState)];
+}
+
+/// Sets the runtime level of every scope whose name contains `scope_matcher`, returns the number of scopes changed.
+///
+/// Messages more verbose than the level compiled in for a scope are never logged, whatever its runtime level.
+pub fn setLevel(scope_matcher: []const u8, new_level: Level) usize {
+    var count: usize = 0;
+
+    for (scopeStates()) |*scope_state| {
+        if (std.mem.indexOf(u8, scope_state.name, scope_matcher) == null) continue;
+
+        @atomicStore(Level, &scope_state.level, new_level, .Monotonic);
+        count += 1;
+    }
+
+    return count;
+}
+
+/// Applies the log levels given on the kernel command line.
+///
+/// Each `log=` option is a comma separated list of `<scope matcher>:<level>` entries, the scope matchers are matched
+/// as in `setLevel`. An entry without a scope matcher sets the level of every scope, entries are applied in order.
+///
+/// For example `log=debug` or `log=warn,vmm:debug`.
+///
+/// Only called once during `setup`.
+pub fn configureFromCommandLine() void {
+    const command_line = kernel.boot.kernelCommandLine() orelse return;
+
+    var options = std.mem.tokenizeScalar(u8, command_line, ' ');
+    while (options.next()) |option| {
+        if (!std.mem.startsWith(u8, option, "log=")) continue;
+
+        var entries = std.mem.tokenizeScalar(u8, option["log=".len..], ',');
+        while (entries.next()) |entry| {
+            const separator = std.mem.lastIndexOfScalar(u8, entry, ':');
+
+            const scope_matcher = if (separator) |index| entry[0..index] else "";
+            const level_name = if (separator) |index| entry[index + 1 ..] else entry;
+
+            const new_level = std.meta.stringToEnum(Level, level_name) orelse {
+                command_line_log.warn("unknown log level '{s}' in '{s}'", .{ level_name, entry });
+                continue;
+            };
+
+            if (@intFromEnum(new_level) > @intFromEnum(maximum_level)) {
+                command_line_log.warn(
+                    "'{s}' requests {s} messages but they are compiled out, only forced debug scopes will log them",
+                    .{ entry, @tagName(new_level) },
+                );
+            }
+
+            const count = setLevel(scope_matcher, new_level);
+            command_line_log.debug(
+                "set {} scopes matching '{s}' to {s}",
+                .{ count, scope_matcher, @tagName(new_level) },
+            );
+        }
+    }
+}
+
+const command_line_log = scoped(.log);
+
 fn logFnDispatch(
     comptime scope: @Type(.EnumLiteral),
     comptime message_level: kernel.log.Level,
@@ -42,7 +416,7 @@ fn logFnDispatch(
     args: anytype,
 ) void {
     // TODO Use per branch cold https://github.com/CascadeOS/CascadeOS/issues/17
-    if (initialized) {
+    if (@atomicLoad(bool, &initialized, .Acquire)) {
         standardLogFn(scope, message_level, format, args);
     } else {
         earlyLogFn(scope, message_level, format, args);
@@ -56,12 +430,99 @@ fn standardLogFn(
     comptime format: []const u8,
     args: anytype,
 ) void {
-    _ = args;
-    _ = format;
-    _ = message_level;
-    _ = scope;
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const state = &kernel.Processor.current().log_buffer;
 
-    core.panic("UNIMPLEMENTED `standardLogFn`"); // TODO: implement standardLogFn https://github.com/CascadeOS/CascadeOS/issues/18
+    const Args = @TypeOf(args);
+
+    if (comptime kernel_options.binary_log and isBinaryLoggable(Args) and @sizeOf(Args) <= maximum_message_length) {
+        const arguments: Args = args;
+        const formatter: Formatter = &BinaryFormatter(scope, message_level, format, Args).format;
+
+        state.append(@intFromPtr(formatter), std.mem.asBytes(&arguments));
+        return;
+    }
+
+    state.append(0, formatMessage(scope, message_level, format, args, &state.format_buffer));
+}
+
+/// Formats a message into `buffer`, truncating it if it does not fit.
+fn formatMessage(
+    comptime scope: @Type(.EnumLiteral),
+    comptime message_level: kernel.log.Level,
+    comptime format: []const u8,
+    args: anytype,
+    buffer: *[maximum_message_length]u8,
+) []const u8 {
+    var stream = std.io.fixedBufferStream(buffer);
+    const writer = stream.writer();
+
+    const scopeAndLevelText = comptime kernel.log.formatScopeAndLevel(message_level, scope);
+    const user_fmt = comptime if (format.len != 0 and format[format.len - 1] == '\n') format else format ++ "\n";
+
+    writer.writeAll(scopeAndLevelText) catch {};
+    writer.print(user_fmt, args) catch {
+        // the message was truncated, make sure it still ends the line
+        buffer[buffer.len - 1] = '\n';
+        return buffer;
+    };
+
+    return stream.getWritten();
+}
+
+/// Generates the formatter of a call site logging in binary.
+///
+/// The address of `format` identifies the call site in the records it logs.
+fn BinaryFormatter(
+    comptime scope: @Type(.EnumLiteral),
+    comptime message_level: kernel.log.Level,
+    comptime message_format: []const u8,
+    comptime Args: type,
+) type {
+    return struct {
+        fn format(arguments: []const u8, buffer: *[maximum_message_length]u8) []const u8 {
+            var args: Args = undefined;
+            @memcpy(std.mem.asBytes(&args), arguments);
+
+            return formatMessage(scope, message_level, message_format, args, buffer);
+        }
+    };
+}
+
+/// Returns true if a value of type `T` can be copied into a ring and formatted later.
+///
+/// Anything containing a pointer is formatted immediately, as whatever it points to may have changed or been freed by
+/// the time the record is drained.
+///
+/// A struct with a `format` function, such as the address and range types, is still logged in binary as the copy it
+/// is called on contains everything it can read.
+fn isBinaryLoggable(comptime T: type) bool {
+    return switch (@typeInfo(T)) {
+        .Void, .Bool, .Int, .Enum, .ErrorSet => true,
+        .Optional => |optional| isBinaryLoggable(optional.child),
+        .Array => |array| isBinaryLoggable(array.child),
+        .Struct => |struct_info| {
+            inline for (struct_info.fields) |field| {
+                if (field.is_comptime) continue;
+                if (!isBinaryLoggable(field.type)) return false;
+            }
+
+            return true;
+        },
+        else => false,
+    };
+}
+
+comptime {
+    // the pmm, vmm and paging messages log addresses and ranges, which must not be formatted at the call site
+    std.debug.assert(isBinaryLoggable(struct { kernel.PhysicalRange, kernel.VirtualAddress }));
+    std.debug.assert(isBinaryLoggable(struct { kernel.VirtualRange, kernel.vmm.MapType }));
+
+    std.debug.assert(!isBinaryLoggable(struct { []const u8 }));
+    std.debug.assert(!isBinaryLoggable(struct { *const kernel.VirtualRange }));
 }
 
 /// Logging function for early boot only.
@@ -71,6 +532,9 @@ fn earlyLogFn(
     comptime format: []const u8,
     args: anytype,
 ) void {
+    const held = early_log_lock.lock();
+    defer held.unlock();
+
     const writer = kernel.arch.setup.getEarlyOutputWriter();
 
     const scopeAndLevelText = comptime kernel.log.formatScopeAndLevel(message_level, scope);
@@ -80,7 +544,7 @@ fn earlyLogFn(
     writer.print(user_fmt, args) catch unreachable;
 }
 
-pub const Level = enum {
+pub const Level = enum(u8) {
     /// Error: something has gone wrong. This might be recoverable or might be followed by the program exiting.
     err,
     /// Warning: it is uncertain if something has gone wrong or not, but the circumstances would be worth investigating.
@@ -129,9 +593,14 @@ pub inline fn formatScopeAndLevel(
     comptime return tag ++ tag_padding ++ " | " ++ level_txt ++ level_padding ++ " | ";
 }
 
-/// Determine if a specific scope and log level pair is enabled for logging.
+/// Determine if a specific scope and log level pair is compiled in.
 inline fn loggingEnabledFor(comptime scope: @Type(.EnumLiteral), comptime message_level: Level) bool {
-    comptime return isScopeInForcedDebugScopes(scope) or @intFromEnum(message_level) <= @intFromEnum(level);
+    comptime return isScopeInForcedDebugScopes(scope) or @intFromEnum(message_level) <= @intFromEnum(maximum_level);
+}
+
+/// The runtime level a scope starts at.
+inline fn initialLevelFor(comptime scope: @Type(.EnumLiteral)) Level {
+    comptime return if (isScopeInForcedDebugScopes(scope)) .debug else default_level;
 }
 
 /// Checks if a scope is in the list of scopes forced to log at debug level.
@@ -143,15 +612,14 @@ inline fn isScopeInForcedDebugScopes(comptime scope: @Type(.EnumLiteral)) bool {
     return false;
 }
 
-const level: Level = blk: {
-    if (kernel_options.force_debug_log) break :blk .debug;
-
-    // TODO: Once the kernel matures use per mode logging levels https://github.com/CascadeOS/CascadeOS/issues/19
-    if (true) break :blk .info;
+/// The most verbose level compiled in for scopes not forced to debug, anything more verbose compiles away.
+///
+/// Debug messages are compiled in for every optimization mode unless the `compile_out_debug_log` option is set, so
+/// they can always be enabled at runtime.
+const maximum_level: Level = if (kernel_options.compile_out_debug_log and !kernel_options.force_debug_log)
+    .info
+else
+    .debug;
 
-    break :blk switch (kernel.info.mode) {
-        .Debug => .info,
-        .ReleaseSafe => .warn,
-        .ReleaseFast, .ReleaseSmall => .err,
-    };
-};
+/// The runtime level of every scope not forced to debug until changed with `setLevel`.
+const default_level: Level = if (kernel_options.force_debug_log) .debug else .info;
@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: MIT
+
+//! Per-task hardware performance counters.
+//!
+//! Cycles are always counted, in ticks of `kernel.arch.readCycleCounter`. The other events are counted by the hardware
+//! once `enable` has been called, on hardware that supports them, otherwise they stay at zero.
+//!
+//! The counts are virtualized per task, on every task switch the counts of the processor since the outgoing task was
+//! switched in are added to its total. A `Region` therefore only measures the task it was started on, even if it is
+//! preempted or migrated part way through:
+//!
+//!   const region = kernel.performance_counters.Region.begin();
+//!   const page = kernel.pmm.allocatePage();
+//!   log.info("allocatePage: {}", .{region.end()});
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+const Task = kernel.Task;
+
+const log = kernel.log.scoped(.performance_counters);
+
+pub const Event = enum {
+    cycles,
+    instructions,
+    last_level_cache_misses,
+    branch_misses,
+    data_tlb_misses,
+};
+
+/// A count of every event.
+pub const Counts = struct {
+    values: std.enums.EnumArray(Event, u64) = std.enums.EnumArray(Event, u64).initFill(0),
+
+    /// Returns the count of `event`, or null if it is not counted.
+    pub fn get(self: Counts, event: Event) ?u64 {
+        if (!isCounted(event)) return null;
+        return self.values.get(event);
+    }
+
+    fn add(self: Counts, other: Counts) Counts {
+        var result = self;
+        for (std.enums.values(Event)) |event| {
+            result.values.set(event, self.values.get(event) +% other.values.get(event));
+        }
+        return result;
+    }
+
+    fn subtract(self: Counts, other: Counts) Counts {
+        var result = self;
+        for (std.enums.values(Event)) |event| {
+            result.values.set(event, self.values.get(event) -% other.values.get(event));
+        }
+        return result;
+    }
+
+    /// Prints the count of every counted event.
+    pub fn print(self: Counts, writer: anytype) !void {
+        var first = true;
+
+        for (std.enums.values(Event)) |event| {
+            const value = self.get(event) orelse continue;
+
+            if (!first) try writer.writeAll(", ");
+            first = false;
+
+            try writer.print("{s}: {}", .{ @tagName(event), value });
+        }
+    }
+
+    pub inline fn format(
+        self: Counts,
+        comptime fmt: []const u8,
+        options: std.fmt.FormatOptions,
+        writer: anytype,
+    ) !void {
+        _ = fmt;
+        _ = options;
+        return print(self, writer);
+    }
+};
+
+/// Measures the events of a region of code on the current task.
+pub const Region = struct {
+    start: Counts,
+
+    pub fn begin() Region {
+        return .{ .start = readCurrentTask() };
+    }
+
+    /// Returns the events that occurred on the current task since `begin`.
+    ///
+    /// Must be called on the same task as `begin`.
+    pub fn end(self: Region) Counts {
+        return readCurrentTask().subtract(self.start);
+    }
+};
+
+/// Per-processor performance counter state.
+pub const ProcessorState = struct {
+    /// Set once the hardware counters of this processor are counting.
+    enabled: bool = false,
+};
+
+/// Per-task performance counter state.
+pub const TaskState = struct {
+    /// The counts of the task up to when it was last switched in.
+    total: Counts = .{},
+
+    /// The counts of the processor the task is running on when it was last switched in.
+    switched_in_at: Counts = .{},
+};
+
+/// Set once `enable` has been called.
+var enabled: bool = false;
+
+/// Starts counting hardware events on every processor.
+///
+/// Counting stays enabled from then on. Regions that began before the call have meaningless hardware counts.
+pub fn enable() void {
+    if (@atomicLoad(bool, &enabled, .Acquire)) return;
+
+    var any_supported = false;
+    for (std.enums.values(Event)) |event| {
+        if (event != .cycles and kernel.arch.performance_counters.isEventSupported(event)) any_supported = true;
+    }
+
+    if (!any_supported) {
+        log.warn("no hardware events are supported, only cycles are counted", .{});
+        return;
+    }
+
+    kernel.cross_call.callAndWait(Processor.allProcessorsMask(), enableOnProcessor, 0);
+
+    @atomicStore(bool, &enabled, true, .Release);
+
+    for (std.enums.values(Event)) |event| {
+        log.debug("{s}: {s}", .{ @tagName(event), if (isCounted(event)) "counted" else "not supported" });
+    }
+}
+
+fn enableOnProcessor(context: usize) void {
+    _ = context;
+
+    const processor = Processor.current();
+
+    kernel.arch.performance_counters.enable();
+    processor.performance_counters.enabled = true;
+
+    // the current task was switched in with the hardware counters disabled
+    processor.scheduler.current_task.performance_counters.switched_in_at = readProcessor(processor);
+}
+
+/// Returns true if `event` is counted.
+pub fn isCounted(event: Event) bool {
+    if (event == .cycles) return true;
+    return @atomicLoad(bool, &enabled, .Acquire) and kernel.arch.performance_counters.isEventSupported(event);
+}
+
+/// Returns the counts of the current task.
+pub fn readCurrentTask() Counts {
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+    const task = processor.scheduler.current_task;
+
+    return task.performance_counters.total.add(
+        readProcessor(processor).subtract(task.performance_counters.switched_in_at),
+    );
+}
+
+/// Moves the counts of `processor` since `current_task` was switched in to its total and starts counting for
+/// `next_task`.
+///
+/// Called by the scheduler on `processor` with interrupts disabled, just before it switches tasks.
+pub fn switchTask(processor: *Processor, current_task: *Task, next_task: *Task) void {
+    const now = readProcessor(processor);
+
+    const current_state = &current_task.performance_counters;
+    current_state.total = current_state.total.add(now.subtract(current_state.switched_in_at));
+
+    next_task.performance_counters.switched_in_at = now;
+}
+
+/// Reads the counters of `processor`, which must be the current processor.
+fn readProcessor(processor: *Processor) Counts {
+    var counts: Counts = .{};
+
+    counts.values.set(.cycles, kernel.arch.readCycleCounter());
+
+    if (processor.performance_counters.enabled) {
+        inline for (comptime std.enums.values(Event)) |event| {
+            if (event != .cycles and kernel.arch.performance_counters.isEventSupported(event)) {
+                counts.values.set(event, kernel.arch.performance_counters.read(event));
+            }
+        }
+    }
+
+    return counts;
+}
@@ -7,9 +7,15 @@ const kernel = @import("kernel");
 const arch = kernel.arch;
 
 const log = kernel.log.scoped(.pmm);
+const trace = kernel.trace.scoped(.pmm);
 
 // TODO: better data structure https://github.com/CascadeOS/CascadeOS/issues/20
 
+/// Protects `first_free_physical_page`.
+///
+/// A lock-free pop is not safe once pages are freed concurrently, as the head can be popped, pushed again and compared
+/// equal while the `next` read before it is stale.
+var free_page_lock: kernel.SpinLock = .{};
 var first_free_physical_page: ?*PhysPageNode = null;
 var total_memory: core.Size = core.Size.zero;
 var total_usable_memory: core.Size = core.Size.zero;
@@ -87,21 +93,17 @@ fn addMemoryMapEntryToAllocator(memory_map_entry: kernel.boot.MemoryMapEntry) vo
 
 /// Allocates a physical page.
 pub fn allocatePage() ?kernel.PhysicalRange {
-    var first_free_page_opt = @atomicLoad(?*PhysPageNode, &first_free_physical_page, .Monotonic);
-
-    while (first_free_page_opt) |first_free_page| {
-        if (@cmpxchgWeak(
-            ?*PhysPageNode,
-            &first_free_physical_page,
-            first_free_page,
-            first_free_page.next,
-            .AcqRel,
-            .Monotonic,
-        )) |new_first_free_page| {
-            first_free_page_opt = new_first_free_page;
-            continue;
-        }
+    const first_free_page_opt: ?*PhysPageNode = blk: {
+        const held = free_page_lock.lock();
+        defer held.unlock();
+
+        const first_free_page = first_free_physical_page orelse break :blk null;
+        first_free_physical_page = first_free_page.next;
 
+        break :blk first_free_page;
+    };
+
+    if (first_free_page_opt) |first_free_page| {
         // Decrement `free_memory`
         _ = @atomicRmw(
             usize,
@@ -117,6 +119,8 @@ pub fn allocatePage() ?kernel.PhysicalRange {
 
         log.debug("found free page: {}", .{allocated_range});
 
+        trace.instant(.allocate_page, .{physical_address.value});
+
         return allocated_range;
     } else {
         log.warn("STANDARD PAGE ALLOCATION FAILED", .{});
@@ -131,9 +135,24 @@ pub fn deallocatePage(allocated_range: kernel.PhysicalRange) void {
     std.debug.assert(allocated_range.size.equal(arch.paging.standard_page_size));
 
     const page_node = allocated_range.address.toDirectMap().toPtr(*PhysPageNode);
-    _ = page_node;
 
-    core.panic("UNIMPLEMENTED `deallocatePage`"); // TODO: implement deallocatePage https://github.com/CascadeOS/CascadeOS/issues/21
+    {
+        const held = free_page_lock.lock();
+        defer held.unlock();
+
+        page_node.next = first_free_physical_page;
+        first_free_physical_page = page_node;
+    }
+
+    _ = @atomicRmw(
+        usize,
+        &free_memory.bytes,
+        .Add,
+        arch.paging.standard_page_size.bytes,
+        .Monotonic,
+    );
+
+    log.debug("freed page: {}", .{allocated_range});
 }
 
 const PhysPageNode = extern struct {
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: MIT
+
+//! Statistical sampling profiler.
+//!
+//! While profiling, the architecture interrupts each processor every `period` cycles it spends executing, see
+//! `kernel.arch.profiling`, and the interrupted instruction pointer along with a walk of the interrupted stack, see
+//! `kernel.debug.StackIterator`, is recorded into a buffer owned by that processor. Recording a sample takes no locks and does no
+//! symbolization, that is left to `dump`.
+//!
+//! `dump` logs one line per distinct stack in the folded stack format, prefixed with `folded `, which can be turned
+//! into a flame graph on the host:
+//!
+//!   grep -o 'folded .*' kernel.log | cut -d' ' -f2- | flamegraph.pl > kernel.svg
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+
+const log = kernel.log.scoped(.profiler);
+
+/// The default sampling frequency in Hz, a prime to avoid sampling in lockstep with periodic activity.
+pub const default_frequency = 997;
+
+/// The maximum number of frames recorded per sample, including the interrupted instruction pointer.
+const maximum_stack_depth = 32;
+
+/// The number of samples each processor can hold, further samples are dropped.
+const samples_per_processor = 4096;
+
+/// Longer stacks have the frames closest to the root dropped, leaving room in the log message for the prefix and the
+/// count.
+const maximum_folded_stack_length = 192;
+
+/// The number of lines logged by `dump` before waiting for the log to drain.
+const lines_per_drain = 16;
+
+const Sample = struct {
+    depth: usize,
+
+    /// The interrupted instruction pointer followed by the return addresses of the stack, innermost first.
+    frames: [maximum_stack_depth]usize,
+
+    fn stack(self: *const Sample) []const usize {
+        return self.frames[0..self.depth];
+    }
+
+    fn lessThan(context: void, lhs: Sample, rhs: Sample) bool {
+        _ = context;
+        return std.mem.order(usize, lhs.stack(), rhs.stack()) == .lt;
+    }
+};
+
+/// Per-processor profiler state.
+pub const ProcessorState = struct {
+    /// Allocated by the first call to `start`.
+    samples: []Sample = &.{},
+
+    /// Only modified by the owning processor while profiling.
+    number_of_samples: usize = 0,
+
+    /// The number of samples dropped because `samples` was full.
+    dropped: usize = 0,
+};
+
+/// Starts sampling every processor at `frequency` Hz, discarding the samples of any previous profile.
+///
+/// Must not be called concurrently with `start`, `stop` or `dump`.
+pub fn start(frequency: u64) !void {
+    if (!kernel.arch.profiling.isAvailable()) return error.ProfilingNotAvailable;
+    if (frequency == 0) return error.InvalidFrequency;
+
+    // the stack is walked with the unwind entries of the symbol table, which cannot be loaded from the interrupt
+    kernel.debug.symbol_map.loadSymbols();
+
+    for (Processor.all) |*processor| {
+        const state = &processor.profiler;
+
+        if (state.samples.len == 0) {
+            state.samples = try kernel.vmm.allocateKernelBuffer(Sample, samples_per_processor);
+        }
+
+        state.number_of_samples = 0;
+        state.dropped = 0;
+    }
+
+    const period = @max(kernel.time.cycle_counter_frequency / frequency, 1);
+
+    kernel.cross_call.callAndWait(Processor.allProcessorsMask(), startOnProcessor, period);
+
+    log.info("profiling at {} Hz", .{frequency});
+}
+
+/// Stops sampling every processor.
+///
+/// Must not be called concurrently with `start`, `stop` or `dump`.
+pub fn stop() void {
+    kernel.cross_call.callAndWait(Processor.allProcessorsMask(), stopOnProcessor, 0);
+
+    log.info("profiling stopped", .{});
+}
+
+fn startOnProcessor(period: usize) void {
+    kernel.arch.profiling.start(period);
+}
+
+fn stopOnProcessor(context: usize) void {
+    _ = context;
+    kernel.arch.profiling.stop();
+}
+
+/// Starts a task that profiles every processor for `duration` nanoseconds then dumps the profile.
+pub fn profileFor(duration: u64) void {
+    _ = kernel.scheduler.spawn(profileTask, duration) catch |err| {
+        core.panicFmt("failed to start profiler: {s}", .{@errorName(err)});
+    };
+}
+
+fn profileTask(duration: usize) void {
+    start(default_frequency) catch |err| {
+        log.warn("unable to profile: {s}", .{@errorName(err)});
+        return;
+    };
+
+    kernel.timer.sleepNanoseconds(duration);
+
+    stop();
+    dump();
+}
+
+/// Records a sample on the current processor.
+///
+/// `interrupted` are the registers of the interrupted code, its stack is only walked if `walk_stack` is set.
+///
+/// Called by the architecture from the profiling interrupt, which can interrupt any code including code running with
+/// interrupts disabled, so this must not take locks or fault.
+pub fn recordSample(interrupted: kernel.debug.StackIterator.Registers, walk_stack: bool) void {
+    const state = &Processor.current().profiler;
+
+    if (state.number_of_samples == state.samples.len) {
+        state.dropped += 1;
+        return;
+    }
+
+    const sample = &state.samples[state.number_of_samples];
+    sample.frames[0] = interrupted.instruction_pointer;
+
+    var depth: usize = 1;
+
+    if (walk_stack) {
+        var stack_iterator = kernel.debug.StackIterator.init(interrupted, null);
+        while (depth < maximum_stack_depth) : (depth += 1) {
+            sample.frames[depth] = stack_iterator.next() orelse break;
+        }
+    }
+
+    sample.depth = depth;
+    state.number_of_samples += 1;
+}
+
+/// Logs the samples of the last profile in the folded stack format, see the top of this file.
+///
+/// Identical stacks recorded on the same processor are combined, identical stacks from different processors are
+/// combined by the flame graph tools.
+///
+/// Profiling must be stopped. Must be called from a task.
+pub fn dump() void {
+    kernel.debug.symbol_map.loadSymbols();
+
+    var lines_since_drain: usize = 0;
+
+    for (Processor.all) |*processor| {
+        const state = &processor.profiler;
+        const samples = state.samples[0..state.number_of_samples];
+
+        log.info("processor {}: {} samples, {} dropped", .{
+            @intFromEnum(processor.id),
+            samples.len,
+            state.dropped,
+        });
+
+        // sorted in place, the cache of `std.sort.block` would not fit on a task stack
+        std.sort.pdq(Sample, samples, {}, Sample.lessThan);
+
+        var index: usize = 0;
+        while (index < samples.len) {
+            const stack = samples[index].stack();
+
+            var count: usize = 1;
+            while (index + count < samples.len and
+                std.mem.eql(usize, samples[index + count].stack(), stack)) count += 1;
+
+            index += count;
+
+            var buffer: [maximum_folded_stack_length]u8 = undefined;
+            log.info("folded {s} {}", .{ foldStack(&buffer, stack), count });
+
+            lines_since_drain += 1;
+            if (lines_since_drain == lines_per_drain) {
+                kernel.log.waitForDrain();
+                lines_since_drain = 0;
+            }
+        }
+    }
+
+    kernel.log.waitForDrain();
+}
+
+/// Writes the symbolized `stack` into `buffer` root first with the frames separated by `;`.
+fn foldStack(buffer: []u8, stack: []const usize) []const u8 {
+    const truncated_marker = "[truncated];";
+
+    // symbols must be looked up with interrupts disabled
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    var name_buffer: [2 + 2 * @sizeOf(usize)]u8 = undefined;
+
+    // the innermost frames are the most interesting, so the frames closest to the root are dropped if needed
+    var number_of_frames: usize = 0;
+    var length: usize = truncated_marker.len;
+    while (number_of_frames < stack.len) : (number_of_frames += 1) {
+        const name_length = frameName(stack, number_of_frames, &name_buffer).len + 1;
+        if (length + name_length > buffer.len) break;
+        length += name_length;
+    }
+
+    var stream = std.io.fixedBufferStream(buffer);
+    const writer = stream.writer();
+
+    if (number_of_frames != stack.len) writer.writeAll(truncated_marker) catch unreachable;
+
+    var frame_index = number_of_frames;
+    while (frame_index != 0) {
+        frame_index -= 1;
+
+        writer.writeAll(frameName(stack, frame_index, &name_buffer)) catch unreachable;
+        if (frame_index != 0) writer.writeByte(';') catch unreachable;
+    }
+
+    const folded = stream.getWritten();
+
+    // spaces separate the stack from the count
+    for (folded) |*char| {
+        if (char.* == ' ') char.* = '_';
+    }
+
+    return folded;
+}
+
+/// Returns the name of the function containing the frame at `frame_index`, or its address if it has no symbol.
+fn frameName(stack: []const usize, frame_index: usize, name_buffer: []u8) []const u8 {
+    // `symbol_map.getSymbol` expects a return address, which the interrupted instruction pointer is not
+    const address = if (frame_index == 0) stack[0] + 1 else stack[frame_index];
+
+    // the symbol table uses the addresses the kernel was linked at
+    if (kernel.debug.symbol_map.getSymbol(address -% kernel.info.kernel_load_offset.bytes)) |symbol| return symbol.name;
+
+    return std.fmt.bufPrint(name_buffer, "0x{x}", .{stack[frame_index]}) catch unreachable;
+}
@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: MIT
+
+//! Read-copy-update.
+//!
+//! Readers access RCU protected data inside a `readLock`/`readUnlock` pair which does nothing more than disable
+//! preemption, readers never write to shared memory or wait.
+//!
+//! Updaters publish a new version of the data with `assignPointer` and defer reclamation of the old version until a
+//! grace period has elapsed, either by blocking in `synchronize` or by queueing a callback with `call`.
+//!
+//! A grace period ends once every processor has passed through a quiescent state (a point where it cannot be in a
+//! read-side critical section), quiescent states are reported by calling `quiescentState`.
+//!
+//! As quiescent states are only reported explicitly, code running with interrupts disabled is also a read-side
+//! critical section.
+//!
+//! Idle processors are halted until interrupted, so starting a grace period interrupts them to report their quiescent
+//! state.
+//!
+//! Callbacks are queued per-processor and are moved through the stages below in batches:
+//!   1. `next` - queued but not yet assigned a grace period
+//!   2. `waiting` - waiting for the grace period numbered `waiting_for` to complete
+//!   3. `done` - grace period has completed, ready to be invoked
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.rcu);
+
+/// The maximum number of callbacks invoked by a single call to `quiescentState`.
+///
+/// Bounds the amount of time spent invoking callbacks, any remaining callbacks are invoked on the next call.
+const maximum_callbacks_per_batch = 64;
+
+/// Protects starting and completing grace periods.
+var grace_period_lock: kernel.SpinLock = .{};
+
+/// The number of the most recently started grace period.
+var current_grace_period: u64 = 0;
+
+/// The number of the most recently completed grace period.
+var completed_grace_period: u64 = 0;
+
+/// Set when a grace period has been requested while one was already in progress.
+///
+/// Protected by `grace_period_lock`.
+var next_grace_period_requested: bool = false;
+
+/// The set of processors that have not passed through a quiescent state during the current grace period.
+var processors_pending_quiescent_state: u64 = 0;
+
+/// An RCU callback head, intended to be embedded in the structure being reclaimed.
+///
+/// Use `@fieldParentPtr` in the callback to get back to the containing structure.
+pub const Head = struct {
+    next: ?*Head = null,
+    callback: Callback = undefined,
+
+    pub const Callback = *const fn (head: *Head) void;
+};
+
+/// Per-processor RCU state.
+pub const ProcessorState = struct {
+    /// Callbacks that have not yet been assigned a grace period.
+    next: CallbackList = .{},
+
+    /// Callbacks waiting for grace period `waiting_for` to complete.
+    waiting: CallbackList = .{},
+
+    /// The grace period that `waiting` is waiting for.
+    waiting_for: u64 = 0,
+
+    /// Callbacks whose grace period has completed.
+    done: CallbackList = .{},
+};
+
+/// Marks the beginning of a read-side critical section.
+///
+/// Read-side critical sections can be nested but must not block.
+pub inline fn readLock() void {
+    kernel.Processor.disablePreemption();
+}
+
+/// Marks the end of a read-side critical section.
+pub inline fn readUnlock() void {
+    kernel.Processor.enablePreemption();
+}
+
+/// Loads an RCU protected pointer.
+///
+/// Must only be called inside a read-side critical section, and the returned pointer must not be used outside of it.
+pub inline fn dereference(comptime PointerT: type, pointer: *const PointerT) PointerT {
+    return @atomicLoad(PointerT, pointer, .Acquire);
+}
+
+/// Publishes a new value for an RCU protected pointer.
+///
+/// Ensures that the initialization of the pointed to value is visible to readers before the pointer is.
+pub inline fn assignPointer(comptime PointerT: type, pointer: *PointerT, value: PointerT) void {
+    @atomicStore(PointerT, pointer, value, .Release);
+}
+
+/// Queues `callback` to be called with `head` after a grace period has elapsed.
+///
+/// Safe to call from interrupt context.
+pub fn call(head: *Head, callback: Head.Callback) void {
+    head.* = .{ .callback = callback };
+
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    kernel.Processor.current().rcu.next.append(head);
+}
+
+/// Blocks until a grace period has elapsed, meaning all read-side critical sections that were in progress when this
+/// function was called have completed.
+///
+/// Must not be called from inside a read-side critical section.
+pub fn synchronize() void {
+    // with a single processor the caller being outside a read-side critical section is a quiescent state
+    if (kernel.Processor.all.len == 1) return;
+
+    var completion: SynchronizeCompletion = .{};
+    call(&completion.head, SynchronizeCompletion.complete);
+
+    while (!@atomicLoad(bool, &completion.completed, .Acquire)) {
+        kernel.Processor.disablePreemption();
+        quiescentState();
+        kernel.Processor.enablePreemption();
+
+        kernel.arch.spinLoopHint();
+    }
+}
+
+const SynchronizeCompletion = struct {
+    head: Head = .{},
+    completed: bool = false,
+
+    fn complete(head: *Head) void {
+        const self = @fieldParentPtr(SynchronizeCompletion, "head", head);
+        @atomicStore(bool, &self.completed, true, .Release);
+    }
+};
+
+/// Reports a quiescent state for the current processor and processes its callbacks.
+///
+/// Must be called with preemption disabled and outside of any read-side critical section, for example from the
+/// scheduler or the idle loop.
+pub fn quiescentState() void {
+    const processor = kernel.Processor.current();
+
+    reportQuiescentState(processor);
+    processCallbacks(processor);
+}
+
+fn reportQuiescentState(processor: *kernel.Processor) void {
+    const processor_mask = processor.id.mask();
+
+    // fast path, this processor has nothing to report
+    if (@atomicLoad(u64, &processors_pending_quiescent_state, .SeqCst) & processor_mask == 0) return;
+
+    const previous_pending = @atomicRmw(
+        u64,
+        &processors_pending_quiescent_state,
+        .And,
+        ~processor_mask,
+        .AcqRel,
+    );
+
+    // we were the last processor the grace period was waiting for
+    if (previous_pending == processor_mask) completeGracePeriod();
+}
+
+fn completeGracePeriod() void {
+    const held = grace_period_lock.lock();
+    defer held.unlock();
+
+    @atomicStore(u64, &completed_grace_period, current_grace_period, .Release);
+
+    if (next_grace_period_requested) {
+        next_grace_period_requested = false;
+        startGracePeriodLocked();
+    }
+}
+
+/// Returns the number of the grace period that must complete before callbacks queued before this call can be invoked.
+fn requestGracePeriod() u64 {
+    const held = grace_period_lock.lock();
+    defer held.unlock();
+
+    if (current_grace_period == completed_grace_period) {
+        startGracePeriodLocked();
+        return current_grace_period;
+    }
+
+    // the grace period in progress may have started before the callbacks were queued, so we need the next one
+    next_grace_period_requested = true;
+    return current_grace_period + 1;
+}
+
+/// Starts a new grace period.
+///
+/// The caller must hold `grace_period_lock`.
+fn startGracePeriodLocked() void {
+    std.debug.assert(@atomicLoad(u64, &processors_pending_quiescent_state, .Acquire) == 0);
+
+    @atomicStore(u64, &current_grace_period, current_grace_period + 1, .Release);
+
+    // pairs with the idle task setting its idle flag before reporting a quiescent state, either the idle processor
+    // observes the new grace period or we observe it as idle
+    @atomicStore(u64, &processors_pending_quiescent_state, kernel.Processor.allProcessorsMask(), .SeqCst);
+
+    const current_processor = kernel.Processor.current();
+    for (kernel.Processor.all) |*processor| {
+        if (processor == current_processor) continue;
+        if (processor.scheduler.isIdle()) kernel.arch.scheduling.sendSchedulerInterrupt(processor);
+    }
+
+    log.debug("started grace period {}", .{current_grace_period});
+}
+
+/// Advances the callbacks of the given processor through the stages and invokes any that are ready.
+fn processCallbacks(processor: *kernel.Processor) void {
+    var batch: CallbackList = .{};
+
+    {
+        const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+        kernel.arch.interrupts.disableInterrupts();
+        defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+        const state = &processor.rcu;
+
+        if (!state.waiting.isEmpty() and
+            @atomicLoad(u64, &completed_grace_period, .Acquire) >= state.waiting_for)
+        {
+            state.done.appendList(&state.waiting);
+        }
+
+        if (state.waiting.isEmpty() and !state.next.isEmpty()) {
+            state.waiting.appendList(&state.next);
+            state.waiting_for = requestGracePeriod();
+        }
+
+        batch = state.done.takeFirst(maximum_callbacks_per_batch);
+    }
+
+    // callbacks are invoked with interrupts in their original state
+    var head_opt = batch.first;
+    while (head_opt) |head| {
+        head_opt = head.next;
+        head.callback(head);
+    }
+}
+
+/// A singly linked list of callbacks that tracks its last element to allow constant time appends.
+const CallbackList = struct {
+    first: ?*Head = null,
+    last: ?*Head = null,
+    len: usize = 0,
+
+    fn isEmpty(self: *const CallbackList) bool {
+        return self.first == null;
+    }
+
+    fn append(self: *CallbackList, head: *Head) void {
+        head.next = null;
+
+        if (self.last) |last| {
+            last.next = head;
+        } else {
+            self.first = head;
+        }
+
+        self.last = head;
+        self.len += 1;
+    }
+
+    /// Moves all callbacks in `other` to the end of this list.
+    fn appendList(self: *CallbackList, other: *CallbackList) void {
+        const other_first = other.first orelse return;
+
+        if (self.last) |last| {
+            last.next = other_first;
+        } else {
+            self.first = other_first;
+        }
+
+        self.last = other.last;
+        self.len += other.len;
+
+        other.* = .{};
+    }
+
+    /// Removes up to `count` callbacks from the front of this list and returns them.
+    fn takeFirst(self: *CallbackList, count: usize) CallbackList {
+        if (self.len <= count) {
+            const taken = self.*;
+            self.* = .{};
+            return taken;
+        }
+
+        var taken: CallbackList = .{ .first = self.first, .len = count };
+
+        var last = self.first.?;
+        for (1..count) |_| last = last.next.?;
+
+        self.first = last.next;
+        self.len -= count;
+
+        last.next = null;
+        taken.last = last;
+
+        return taken;
+    }
+};
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+
+//! A fixed capacity Chase-Lev work-stealing deque of tasks.
+//!
+//! The owning processor pushes and pops at the bottom without any atomic read-modify-write operations (except when
+//! taking the last task), other processors steal from the top.
+//!
+//! Based on "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê, Pop, Cohen and Zappa Nardelli.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Task = kernel.Task;
+
+const RunQueue = @This();
+
+/// The maximum number of tasks the queue can hold, must be a power of two.
+pub const capacity = 256;
+
+/// The index of the next task to be stolen, only ever increases.
+top: isize align(std.atomic.cache_line) = 0,
+
+/// The index the owner pushes the next task at.
+///
+/// Kept on a separate cache line from `top` so that the owner and thieves do not contend on it.
+bottom: isize align(std.atomic.cache_line) = 0,
+
+tasks: [capacity]?*Task = [_]?*Task{null} ** capacity,
+
+/// Pushes `task` onto the bottom of the queue.
+///
+/// Must only be called by the owning processor.
+pub fn push(self: *RunQueue, task: *Task) error{RunQueueFull}!void {
+    const bottom = @atomicLoad(isize, &self.bottom, .Monotonic);
+    const top = @atomicLoad(isize, &self.top, .Acquire);
+
+    if (bottom - top >= capacity) return error.RunQueueFull;
+
+    @atomicStore(?*Task, self.slot(bottom), task, .Monotonic);
+    @fence(.Release);
+    @atomicStore(isize, &self.bottom, bottom + 1, .Monotonic);
+}
+
+/// Pops the most recently pushed task from the bottom of the queue.
+///
+/// Must only be called by the owning processor.
+pub fn pop(self: *RunQueue) ?*Task {
+    const bottom = @atomicLoad(isize, &self.bottom, .Monotonic) - 1;
+    @atomicStore(isize, &self.bottom, bottom, .Monotonic);
+
+    @fence(.SeqCst);
+
+    const top = @atomicLoad(isize, &self.top, .Monotonic);
+
+    if (top > bottom) {
+        // the queue is empty
+        @atomicStore(isize, &self.bottom, bottom + 1, .Monotonic);
+        return null;
+    }
+
+    const task = @atomicLoad(?*Task, self.slot(bottom), .Monotonic);
+
+    // there is more than one task so no thief can be racing us for this one
+    if (top != bottom) return task;
+
+    // this is the last task, race any thieves for it
+    const won = @cmpxchgStrong(isize, &self.top, top, top + 1, .SeqCst, .Monotonic) == null;
+    @atomicStore(isize, &self.bottom, bottom + 1, .Monotonic);
+
+    return if (won) task else null;
+}
+
+/// Steals the oldest task from the top of the queue.
+///
+/// Returns null if the queue is empty or another processor won the race for the task.
+///
+/// Can be called by any processor.
+pub fn steal(self: *RunQueue) ?*Task {
+    const top = @atomicLoad(isize, &self.top, .Acquire);
+
+    @fence(.SeqCst);
+
+    const bottom = @atomicLoad(isize, &self.bottom, .Acquire);
+
+    if (top >= bottom) return null;
+
+    const task = @atomicLoad(?*Task, self.slot(top), .Monotonic);
+
+    if (@cmpxchgStrong(isize, &self.top, top, top + 1, .SeqCst, .Monotonic) != null) return null;
+
+    return task;
+}
+
+inline fn slot(self: *RunQueue, index: isize) *?*Task {
+    return &self.tasks[@as(usize, @intCast(index)) & (capacity - 1)];
+}
+
+comptime {
+    if (!std.math.isPowerOfTwo(capacity)) @compileError("RunQueue capacity must be a power of two");
+}
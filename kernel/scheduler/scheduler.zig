@@ -0,0 +1,559 @@
+// SPDX-License-Identifier: MIT
+
+//! Preemptive task scheduler with per-processor run queues.
+//!
+//! Each processor owns a `RunQueue`, a Chase-Lev work-stealing deque, holding tasks that may run on any processor.
+//! The owner pushes and pops at the bottom so recently woken tasks run while their data is still in cache, processors
+//! that run out of work steal the oldest tasks from the top of other processors' queues, preferring processors that
+//! share their last level cache.
+//!
+//! Tasks that are pinned to a processor or that have been preempted are kept in the processor's `local_queue` instead,
+//! which is never stolen from.
+//!
+//! Only the owner may push onto a `RunQueue`, so tasks woken for another processor are pushed onto its lock-free
+//! `incoming` list which the owner drains the next time it schedules.
+//!
+//! Every task other than the idle task runs for at most `time_slice` before it is preempted, by a per-processor
+//! `kernel.timer` armed when the task is switched to.
+//!
+//! All scheduler state of a processor is only accessed by that processor with interrupts disabled, except for
+//! `incoming`, `idle` and the top of the `RunQueue`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+const Task = kernel.Task;
+
+pub const RunQueue = @import("RunQueue.zig");
+
+const log = kernel.log.scoped(.scheduler);
+const trace = kernel.trace.scoped(.scheduler);
+
+/// The number of consecutive tasks taken from the run queue before the local queue is given priority.
+///
+/// Prevents preempted tasks starving while woken tasks keep arriving.
+const local_queue_fairness_interval = 16;
+
+/// How long a task runs before it is preempted, if there is another task to run.
+const time_slice_nanoseconds = 10 * std.time.ns_per_ms;
+
+/// Per-processor scheduler state.
+pub const ProcessorState = struct {
+    run_queue: RunQueue = .{},
+
+    /// Tasks that must run on this processor, either because they are pinned to it or have been preempted.
+    local_queue: TaskQueue = .{},
+
+    /// Tasks woken by other processors to run on this processor, linked through `Task.next` in reverse order.
+    incoming: ?*Task = null,
+
+    /// The task currently executing on this processor.
+    current_task: *Task = undefined,
+
+    /// The task switched away from by the most recent task switch, handled by `finishSwitch`.
+    previous_task: ?*Task = null,
+
+    /// The task that runs when there is nothing else to run, executes on the stack this processor was started with.
+    idle_task: Task = undefined,
+
+    /// Set when this processor is running its idle task, which halts until interrupted.
+    ///
+    /// Accessed with sequentially consistent ordering, anything that makes work available to the processor must
+    /// either be observed by the idle task before it halts or see this set and interrupt the processor.
+    idle: bool = false,
+
+    /// Set when the current task should be preempted at the next opportunity.
+    preemption_requested: bool = false,
+
+    /// The number of consecutive tasks taken from `run_queue`.
+    run_queue_streak: u32 = 0,
+
+    /// Requests preemption of the current task when its time slice ends, pending whenever a task other than the idle
+    /// task is running.
+    time_slice_timer: kernel.timer.Timer = .{},
+
+    /// Returns true if the processor is running its idle task.
+    pub fn isIdle(self: *const ProcessorState) bool {
+        return @atomicLoad(bool, &self.idle, .SeqCst);
+    }
+};
+
+/// Initializes the scheduler state of `processor`.
+///
+/// The context that calls `idle` on `processor` becomes its idle task.
+pub fn initializeProcessor(processor: *Processor) void {
+    const state = &processor.scheduler;
+
+    state.* = .{};
+    state.idle_task = .{
+        .id = .idle,
+        .state = .running,
+        .stack = kernel.VirtualRange.fromAddr(kernel.VirtualAddress.zero, core.Size.zero),
+        .pinned_processor = processor.id,
+    };
+    state.current_task = &state.idle_task;
+}
+
+/// Records the stack provided by the bootloader that `processor` started on as the stack of its idle task.
+///
+/// Must be called on `processor` before it does anything that may need to walk its stack.
+pub fn setBootloaderStack(processor: *Processor, stack: kernel.VirtualRange) void {
+    processor.scheduler.idle_task.stack = stack;
+}
+
+/// Returns the task executing on the current processor.
+pub fn currentTask() *Task {
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    return Processor.current().scheduler.current_task;
+}
+
+/// Creates a task that calls `entry` with `argument` and makes it runnable.
+pub fn spawn(entry: Task.Entry, argument: usize) !*Task {
+    const task = try Task.create(entry, argument);
+    wake(task);
+    return task;
+}
+
+/// Wakes `task`.
+///
+/// If `task` is not blocked the wakeup is remembered and its next call to `block` returns immediately.
+///
+/// Safe to call from interrupt context.
+pub fn wake(task: *Task) void {
+    {
+        const held = task.lock.lock();
+        defer held.unlock();
+
+        if (task.state != .blocked) {
+            task.wake_pending = true;
+            return;
+        }
+
+        task.state = .runnable;
+    }
+
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+    const target = selectProcessor(processor, task);
+
+    if (target == processor) {
+        enqueueLocal(processor, task);
+    } else {
+        pushIncoming(target, task);
+
+        // an idle processor only notices its incoming list when interrupted
+        if (target.scheduler.isIdle()) kernel.arch.scheduling.sendSchedulerInterrupt(target);
+    }
+}
+
+/// Blocks the current task until it is woken by `wake`.
+///
+/// Returns immediately if the task has been woken since it last blocked.
+///
+/// Must not be called with preemption disabled.
+pub fn block() void {
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+    std.debug.assert(processor.preemption_disable_count == 0);
+
+    const task = processor.scheduler.current_task;
+    std.debug.assert(task != &processor.scheduler.idle_task);
+
+    {
+        const held = task.lock.grab();
+        defer held.unlock();
+
+        if (task.wake_pending) {
+            task.wake_pending = false;
+            return;
+        }
+
+        task.state = .blocking;
+    }
+
+    switchTo(processor, findNextTask(processor) orelse &processor.scheduler.idle_task);
+}
+
+/// Yields the current processor to another runnable task, if there is one.
+///
+/// Must not be called with preemption disabled.
+pub fn yield() void {
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+    std.debug.assert(processor.preemption_disable_count == 0);
+
+    yieldWithInterruptsDisabled(processor);
+}
+
+/// Exits the current task.
+pub fn exit() noreturn {
+    kernel.arch.interrupts.disableInterrupts();
+
+    const processor = Processor.current();
+    const task = processor.scheduler.current_task;
+    std.debug.assert(task != &processor.scheduler.idle_task);
+
+    {
+        const held = task.lock.grab();
+        defer held.unlock();
+
+        task.state = .dead;
+    }
+
+    switchTo(processor, findNextTask(processor) orelse &processor.scheduler.idle_task);
+
+    core.panic("exited task was switched to");
+}
+
+/// Requests that the current task is preempted at the next opportunity.
+///
+/// Intended to be called from interrupt handlers, for example a timer interrupt.
+pub fn requestPreemption() void {
+    @atomicStore(bool, &Processor.current().scheduler.preemption_requested, true, .Monotonic);
+}
+
+/// Preempts the current task if preemption has been requested.
+///
+/// Called by `kernel.Processor.enablePreemption` when preemption has been requested, does nothing if interrupts are
+/// disabled as the caller is then still in a critical section.
+pub fn preemptIfRequested() void {
+    if (!kernel.arch.interrupts.interruptsEnabled()) return;
+
+    kernel.arch.interrupts.disableInterrupts();
+    defer kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+
+    if (processor.preemption_disable_count != 0) return;
+    if (!@atomicLoad(bool, &processor.scheduler.preemption_requested, .Monotonic)) return;
+
+    yieldWithInterruptsDisabled(processor);
+}
+
+/// Preempts the interrupted task if preemption has been requested and the interrupted task had preemption enabled.
+///
+/// Called with interrupts disabled before returning from an interrupt that executed on the stack of the interrupted
+/// task.
+pub fn preemptFromInterrupt() void {
+    const processor = Processor.current();
+
+    if (!@atomicLoad(bool, &processor.scheduler.preemption_requested, .Monotonic)) return;
+    if (processor.preemption_disable_count != 0) return;
+
+    yieldWithInterruptsDisabled(processor);
+}
+
+/// Runs the idle task of the current processor.
+///
+/// The calling context becomes the idle task, which looks for work and reports quiescent states whenever the
+/// processor has nothing else to run.
+pub fn idle() noreturn {
+    {
+        const processor = Processor.current();
+        log.debug("processor {} entering idle loop", .{@intFromEnum(processor.id)});
+        @atomicStore(bool, &processor.scheduler.idle, true, .SeqCst);
+    }
+
+    while (true) {
+        kernel.arch.interrupts.disableInterrupts();
+
+        const processor = Processor.current();
+
+        kernel.rcu.quiescentState();
+
+        if (findNextTask(processor)) |task| {
+            switchTo(processor, task);
+            continue;
+        }
+
+        // there is no periodic tick, the processor sleeps until a timer expires or it is sent work
+        kernel.arch.interrupts.enableInterruptsAndHalt();
+    }
+}
+
+/// The first function run by every task, called by the architecture specific task entry trampoline.
+///
+/// Only exposed for `kernel.Task.create`.
+pub fn taskEntry(task: *Task) callconv(.C) noreturn {
+    finishSwitch();
+    kernel.arch.interrupts.enableInterrupts();
+
+    task.entry(task.argument);
+
+    exit();
+}
+
+fn yieldWithInterruptsDisabled(processor: *Processor) void {
+    @atomicStore(bool, &processor.scheduler.preemption_requested, false, .Monotonic);
+
+    // the idle task only runs when there is nothing else to do, so it is never returned to by a yield
+    const next_task = findNextTask(processor) orelse {
+        // nothing else wants to run, so the current task gets another time slice
+        startTimeSlice(processor, processor.scheduler.current_task);
+        return;
+    };
+
+    switchTo(processor, next_task);
+}
+
+/// Arms the time slice timer of `processor` for `task`, or leaves it disarmed if `task` is the idle task.
+///
+/// Must be called with interrupts disabled.
+fn startTimeSlice(processor: *Processor, task: *Task) void {
+    const state = &processor.scheduler;
+
+    _ = kernel.timer.cancel(&state.time_slice_timer);
+
+    if (task == &state.idle_task) return;
+
+    kernel.timer.schedule(
+        &state.time_slice_timer,
+        kernel.arch.readCycleCounter() + kernel.time.nanosecondsToCycles(time_slice_nanoseconds),
+        timeSliceExpired,
+    );
+}
+
+/// Called from the timer interrupt, the switch itself happens on the way out of the interrupt.
+fn timeSliceExpired(timer: *kernel.timer.Timer) void {
+    _ = timer;
+    requestPreemption();
+}
+
+/// Switches from the current task of `processor` to `next_task`.
+///
+/// Must be called with interrupts disabled, when this returns the calling task may be on a different processor.
+fn switchTo(processor: *Processor, next_task: *Task) void {
+    const state = &processor.scheduler;
+    const current_task = state.current_task;
+
+    if (current_task == next_task) return;
+
+    // read-side critical sections cannot span a task switch, so this is a quiescent state
+    kernel.rcu.quiescentState();
+
+    if (next_task != &state.idle_task) {
+        const held = next_task.lock.grab();
+        defer held.unlock();
+
+        next_task.state = .running;
+    }
+
+    state.previous_task = current_task;
+    state.current_task = next_task;
+    @atomicStore(bool, &state.idle, next_task == &state.idle_task, .SeqCst);
+
+    kernel.performance_counters.switchTask(processor, current_task, next_task);
+
+    startTimeSlice(processor, next_task);
+
+    trace.instant(.switch_task, .{ current_task.id, next_task.id });
+
+    kernel.arch.scheduling.switchToTask(current_task, next_task);
+
+    finishSwitch();
+}
+
+/// Completes a task switch on the new task, by handling the task that was switched away from.
+///
+/// This is done after the switch as until then the previous task is still executing on its stack.
+fn finishSwitch() void {
+    const processor = Processor.current();
+    const state = &processor.scheduler;
+
+    const previous_task = state.previous_task orelse unreachable;
+    state.previous_task = null;
+
+    if (previous_task == &state.idle_task) return;
+
+    previous_task.last_processor = processor.id;
+
+    const held = previous_task.lock.grab();
+
+    switch (previous_task.state) {
+        .running => {
+            // the task was preempted or yielded
+            previous_task.state = .runnable;
+            held.unlock();
+
+            state.local_queue.append(previous_task);
+        },
+        .blocking => {
+            if (!previous_task.wake_pending) {
+                previous_task.state = .blocked;
+                held.unlock();
+                return;
+            }
+
+            // the task was woken while it was switching away
+            previous_task.wake_pending = false;
+            previous_task.state = .runnable;
+            held.unlock();
+
+            enqueueLocal(processor, previous_task);
+        },
+        .dead => {
+            held.unlock();
+            Task.destroy(previous_task);
+        },
+        .runnable, .blocked => unreachable,
+    }
+}
+
+/// Finds the next task for `processor` to run, returns null if there is none.
+fn findNextTask(processor: *Processor) ?*Task {
+    const state = &processor.scheduler;
+
+    drainIncoming(processor);
+
+    if (state.run_queue_streak >= local_queue_fairness_interval) {
+        state.run_queue_streak = 0;
+        if (state.local_queue.pop()) |task| return task;
+    }
+
+    if (state.run_queue.pop()) |task| {
+        state.run_queue_streak += 1;
+        return task;
+    }
+
+    state.run_queue_streak = 0;
+
+    if (state.local_queue.pop()) |task| return task;
+
+    return steal(processor);
+}
+
+/// Attempts to steal a task from another processor.
+///
+/// Processors sharing a last level cache with `processor` are tried first, starting from the next processor by id so
+/// that thieves spread out over their victims.
+fn steal(processor: *Processor) ?*Task {
+    const processors = Processor.all;
+    const start = @intFromEnum(processor.id);
+
+    inline for (.{ true, false }) |same_cache_domain| {
+        for (1..processors.len) |offset| {
+            const victim = &processors[(start + offset) % processors.len];
+
+            const shares_cache = victim.topology.cache_domain == processor.topology.cache_domain;
+            if (shares_cache != same_cache_domain) continue;
+
+            if (victim.scheduler.run_queue.steal()) |task| return task;
+        }
+    }
+
+    return null;
+}
+
+/// Selects the processor `task` should be woken on.
+fn selectProcessor(current_processor: *Processor, task: *Task) *Processor {
+    if (task.pinned_processor) |pinned_processor| return Processor.get(pinned_processor);
+
+    const last_processor = Processor.get(task.last_processor orelse return current_processor);
+    if (last_processor == current_processor) return current_processor;
+
+    // the cache of the processor the task last ran on most likely still holds its working set
+    if (last_processor.scheduler.isIdle()) return last_processor;
+
+    // otherwise an idle processor sharing that cache is the next best thing
+    for (Processor.all) |*processor| {
+        if (processor.topology.cache_domain != last_processor.topology.cache_domain) continue;
+        if (processor.scheduler.isIdle()) return processor;
+    }
+
+    // everything near the task's cache is busy, run it here and let idle processors steal it if needed
+    return current_processor;
+}
+
+/// Queues `task` on the current processor.
+///
+/// Must be called with interrupts disabled.
+fn enqueueLocal(processor: *Processor, task: *Task) void {
+    const state = &processor.scheduler;
+
+    if (task.pinned_processor != null) {
+        state.local_queue.append(task);
+        return;
+    }
+
+    state.run_queue.push(task) catch state.local_queue.append(task);
+}
+
+/// Pushes `task` onto the incoming list of `processor`.
+fn pushIncoming(processor: *Processor, task: *Task) void {
+    var head = @atomicLoad(?*Task, &processor.scheduler.incoming, .Monotonic);
+
+    while (true) {
+        task.next = head;
+        head = @cmpxchgWeak(
+            ?*Task,
+            &processor.scheduler.incoming,
+            head,
+            task,
+            .Release,
+            .Monotonic,
+        ) orelse return;
+    }
+}
+
+/// Moves all tasks on the incoming list of `processor` into its queues.
+///
+/// Must be called with interrupts disabled.
+fn drainIncoming(processor: *Processor) void {
+    var task_opt = @atomicRmw(?*Task, &processor.scheduler.incoming, .Xchg, null, .Acquire);
+
+    // the incoming list is in reverse order of wakeup
+    var reversed: ?*Task = null;
+    while (task_opt) |task| {
+        task_opt = task.next;
+        task.next = reversed;
+        reversed = task;
+    }
+
+    while (reversed) |task| {
+        reversed = task.next;
+        task.next = null;
+        enqueueLocal(processor, task);
+    }
+}
+
+/// A FIFO queue of tasks linked through `Task.next`.
+const TaskQueue = struct {
+    first: ?*Task = null,
+    last: ?*Task = null,
+
+    fn append(self: *TaskQueue, task: *Task) void {
+        task.next = null;
+
+        if (self.last) |last| {
+            last.next = task;
+        } else {
+            self.first = task;
+        }
+
+        self.last = task;
+    }
+
+    fn pop(self: *TaskQueue) ?*Task {
+        const task = self.first orelse return null;
+
+        self.first = task.next;
+        if (self.first == null) self.last = null;
+
+        task.next = null;
+        return task;
+    }
+};
@@ -3,10 +3,19 @@
 const std = @import("std");
 const core = @import("core");
 const kernel = @import("kernel");
+const kernel_options = @import("kernel_options");
+
+const boot_report_format = @import("boot_report_format.zig");
 
 const log = kernel.log.scoped(.setup);
 
 pub fn setup() void {
+    // captured before anything else runs so that it is within a page of the top of the stack
+    const bootloader_stack = kernel.boot.bootloaderStack(kernel.arch.captureUnwindRegisters().stack_pointer);
+
+    // output is not available yet, so the first phase is only recorded
+    recordPhase("setting up early output");
+
     // we try to get output up and running as soon as possible
     kernel.arch.setup.setupEarlyOutput();
 
@@ -22,25 +31,135 @@ pub fn setup() void {
         comptime "starting CascadeOS " ++ kernel.info.version ++ "\n",
     ) catch {};
 
-    log.info("performing early system initialization", .{});
+    // applied as early as possible so the rest of setup is logged at the requested levels
+    kernel.log.configureFromCommandLine();
+
+    beginPhase("performing early system initialization");
     kernel.arch.setup.earlyArchInitialization();
 
-    log.info("capturing bootloader information", .{});
+    beginPhase("initializing bootstrap processor");
+    kernel.Processor.initializeBootstrapProcessor();
+    kernel.scheduler.setBootloaderStack(kernel.Processor.current(), bootloader_stack);
+
+    beginPhase("capturing bootloader information");
     captureBootloaderInformation();
 
-    log.info("capturing system information", .{});
+    beginPhase("capturing system information");
     kernel.arch.setup.captureSystemInformation();
 
-    log.info("configuring system features", .{});
+    beginPhase("configuring system features");
     kernel.arch.setup.configureSystemFeatures();
 
-    log.info("initializing physical memory", .{});
+    beginPhase("initializing time");
+    kernel.time.init();
+
+    beginPhase("initializing physical memory");
     kernel.pmm.init();
 
-    log.info("initializing virtual memory", .{});
+    beginPhase("initializing virtual memory");
     kernel.vmm.init();
 
-    core.panic("UNIMPLEMENTED"); // TODO: implement initial system setup
+    beginPhase("capturing processor topology");
+    kernel.arch.setup.captureProcessorTopology(kernel.Processor.current());
+
+    beginPhase("initializing interrupt controller");
+    kernel.arch.setup.initializeLocalInterruptController(kernel.Processor.current());
+
+    beginPhase("initializing devices");
+    kernel.arch.setup.initializeDevices();
+
+    beginPhase("starting non-bootstrap processors");
+    kernel.Processor.initializeNonBootstrapProcessors(nonBootstrapProcessorSetup);
+
+    beginPhase("initializing deferred work");
+    kernel.deferred.init();
+
+    beginPhase("switching to buffered logging");
+    kernel.log.init();
+
+    // needs buffered logging to dump the events and every processor online to allocate their rings
+    kernel.trace.configureFromCommandLine();
+
+    logBootReport();
+
+    if (kernel_options.profile_seconds != 0) {
+        log.info("starting profiler", .{});
+        kernel.profiler.profileFor(kernel_options.profile_seconds * std.time.ns_per_s);
+    }
+
+    if (kernel_options.run_benchmarks) {
+        log.info("starting benchmarks", .{});
+        kernel.benchmarks.start();
+    }
+
+    kernel.scheduler.idle();
+}
+
+const BootPhase = struct {
+    name: []const u8,
+
+    /// The value of the cycle counter when the phase began.
+    start: u64,
+};
+
+const maximum_number_of_boot_phases = 32;
+
+/// The phases of `setup` in the order they ran, each ends when the next begins.
+var boot_phases: [maximum_number_of_boot_phases]BootPhase = undefined;
+var number_of_boot_phases: usize = 0;
+
+/// Ends the current phase of `setup` and begins the next.
+fn beginPhase(comptime name: []const u8) void {
+    recordPhase(name);
+    log.info(name, .{});
+}
+
+/// Records the start of a phase of `setup` without logging it.
+fn recordPhase(comptime name: []const u8) void {
+    // the cycle counter is readable before `kernel.time.init`, only its frequency is unknown until then
+    boot_phases[number_of_boot_phases] = .{ .name = name, .start = kernel.arch.readCycleCounter() };
+    number_of_boot_phases += 1;
+}
+
+/// Logs the duration of every phase of `setup` so far, see `boot_report_format`.
+fn logBootReport() void {
+    const end = kernel.arch.readCycleCounter();
+    const total = end - boot_phases[0].start;
+
+    for (boot_phases[0..number_of_boot_phases], 0..) |phase, i| {
+        const phase_end = if (i + 1 < number_of_boot_phases) boot_phases[i + 1].start else end;
+        const duration = phase_end - phase.start;
+
+        // tenths of a percent
+        const permille = if (total == 0) 0 else @as(u64, @intCast(@as(u128, duration) * 1000 / total));
+
+        log.info(boot_report_format.line_marker ++ "phase {} {}.{}% {s}", .{
+            kernel.time.cyclesToNanoseconds(duration),
+            permille / 10,
+            permille % 10,
+            phase.name,
+        });
+    }
+
+    log.info(boot_report_format.line_marker ++ "total {}", .{kernel.time.cyclesToNanoseconds(total)});
+    log.info(boot_report_format.line_marker ++ "end", .{});
+}
+
+/// Entry point of every non-bootstrap processor.
+fn nonBootstrapProcessorSetup(processor: *kernel.Processor) noreturn {
+    kernel.scheduler.setBootloaderStack(
+        processor,
+        kernel.boot.bootloaderStack(kernel.arch.captureUnwindRegisters().stack_pointer),
+    );
+
+    kernel.arch.setup.nonBootstrapArchInitialization(processor);
+    kernel.vmm.loadKernelPageTable();
+    kernel.arch.setup.captureProcessorTopology(processor);
+    kernel.arch.setup.initializeLocalInterruptController(processor);
+
+    kernel.Processor.markOnline();
+
+    kernel.scheduler.idle();
 }
 
 fn captureBootloaderInformation() void {
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+//! System calls.
+//!
+//! The architecture saves the registers of the caller and calls `dispatch` with the system call number and its
+//! arguments, which is used as a direct index into `handlers`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.syscall);
+
+pub const Number = enum(usize) {
+    /// Does nothing, used to measure the cost of entering and leaving the kernel.
+    null = 0,
+
+    _,
+};
+
+pub const Arguments = [6]usize;
+
+pub const Handler = *const fn (arguments: *const Arguments) usize;
+
+/// Returned for a system call number without a handler.
+pub const invalid_syscall: usize = std.math.maxInt(usize);
+
+/// Indexed by `Number`.
+const handlers = [_]Handler{
+    nullSyscall,
+};
+
+/// Calls the handler for the system call `number`.
+///
+/// Called by the architecture with interrupts in the state of the caller.
+pub fn dispatch(number: usize, arguments: *const Arguments) usize {
+    if (number >= handlers.len) return invalid_syscall;
+    return handlers[number](arguments);
+}
+
+fn nullSyscall(arguments: *const Arguments) usize {
+    _ = arguments;
+    return 0;
+}
+
+comptime {
+    for (std.meta.tags(Number)) |number| {
+        if (@intFromEnum(number) >= handlers.len) {
+            @compileError("no handler for system call `" ++ @tagName(number) ++ "`");
+        }
+    }
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+
+//! Monotonic time.
+//!
+//! Time is read from `kernel.arch.readCycleCounter` and converted to nanoseconds with a single multiply and shift by a
+//! 32.32 fixed point multiplier, calculated once from the calibrated frequency of the cycle counter.
+//!
+//! The cycle counter is assumed to be synchronized between processors.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const log = kernel.log.scoped(.time);
+
+/// The frequency of `kernel.arch.readCycleCounter` in Hz.
+///
+/// Initialized by `init`.
+pub var cycle_counter_frequency: u64 = 0;
+
+/// The value of the cycle counter when `init` was called, time is measured from this point.
+var cycles_at_init: u64 = 0;
+
+/// Nanoseconds per cycle as a 32.32 fixed point number.
+var nanoseconds_per_cycle: u64 = 0;
+
+/// Cycles per nanosecond as a 32.32 fixed point number.
+var cycles_per_nanosecond: u64 = 0;
+
+/// Calibrates the cycle counter.
+///
+/// Only called once during `setup`.
+pub fn init() void {
+    const frequency = kernel.arch.setup.cycleCounterFrequency();
+    if (frequency == 0) core.panic("cycle counter frequency is zero");
+
+    cycle_counter_frequency = frequency;
+    nanoseconds_per_cycle = @intCast((@as(u128, std.time.ns_per_s) << 32) / frequency);
+    cycles_per_nanosecond = @intCast((@as(u128, frequency) << 32) / std.time.ns_per_s);
+
+    cycles_at_init = kernel.arch.readCycleCounter();
+
+    log.debug("cycle counter frequency: {} Hz", .{frequency});
+}
+
+/// Returns the number of nanoseconds since `init`.
+pub inline fn monotonicNanoseconds() u64 {
+    return cyclesToNanoseconds(kernel.arch.readCycleCounter() - cycles_at_init);
+}
+
+/// Converts a number of cycles of `kernel.arch.readCycleCounter` to nanoseconds.
+pub inline fn cyclesToNanoseconds(cycles: u64) u64 {
+    return @truncate(std.math.mulWide(u64, cycles, nanoseconds_per_cycle) >> 32);
+}
+
+/// Converts a number of nanoseconds to cycles of `kernel.arch.readCycleCounter`.
+pub inline fn nanosecondsToCycles(nanoseconds: u64) u64 {
+    return @truncate(std.math.mulWide(u64, nanoseconds, cycles_per_nanosecond) >> 32);
+}
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: MIT
+
+//! One-shot timers.
+//!
+//! Each processor keeps its pending timers in a hierarchical timer wheel and arms its one-shot hardware timer for the
+//! earliest occupied slot only. There is no periodic tick, a processor with nothing to do stays halted until one of
+//! its timers actually expires.
+//!
+//! The wheel has `number_of_levels` levels of `slots_per_level` slots, each level `1 << level_shift` times coarser
+//! than the one below it. A timer is placed in the finest level that can hold its distance from the wheel clock,
+//! rounded up to the granularity of that level so it never fires early, which bounds how late it fires to roughly an
+//! eighth of the distance. Timers are never cascaded between levels, so arming and cancelling a timer are O(1).
+//!
+//! Each level has a bitmap of its occupied slots, so finding the next expiry looks at a single word per level.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+
+const log = kernel.log.scoped(.timer);
+
+/// Deadlines are in ticks of `kernel.arch.readCycleCounter`, the wheel advances in units of `1 << cycle_shift` of
+/// them.
+const cycle_shift = 10;
+
+const slot_bits = 6;
+const slots_per_level = 1 << slot_bits;
+
+/// Each level is `1 << level_shift` times coarser than the level below it.
+const level_shift = 3;
+
+const number_of_levels = 8;
+
+/// The furthest from the wheel clock a timer can be placed, in wheel ticks.
+///
+/// Timers further away are placed at this distance and placed again once it is reached.
+const maximum_distance = levelCapacity(number_of_levels - 1) - 1;
+
+/// Stored in `ProcessorState.armed_for` while the hardware timer is disarmed.
+const disarmed = std.math.maxInt(u64);
+
+pub const Timer = struct {
+    /// The value of `kernel.arch.readCycleCounter` at which the timer expires.
+    deadline: u64 = 0,
+
+    callback: Callback = undefined,
+
+    /// Available for use by the callback.
+    context: usize = 0,
+
+    /// The wheel the timer is pending on, null if it is not pending.
+    wheel: ?*ProcessorState = null,
+
+    /// The index into `ProcessorState.slots` of the slot the timer is in.
+    slot: u16 = 0,
+
+    next: ?*Timer = null,
+    previous: ?*Timer = null,
+
+    /// Called from interrupt context with interrupts disabled, on the processor the timer was armed on.
+    ///
+    /// The timer is no longer pending when the callback is called, so it may be armed again.
+    pub const Callback = *const fn (timer: *Timer) void;
+
+    /// Returns true if the timer is armed and has not yet expired.
+    pub fn isPending(self: *const Timer) bool {
+        return @atomicLoad(?*ProcessorState, &self.wheel, .Acquire) != null;
+    }
+};
+
+/// Per-processor timer state.
+pub const ProcessorState = struct {
+    /// Protects the wheel and the list links of the timers on it.
+    lock: kernel.SpinLock = .{},
+
+    /// The next wheel tick to be processed, every earlier tick has been.
+    clock: u64 = 0,
+
+    /// For each level, a bitmap of the slots containing at least one timer.
+    occupied: [number_of_levels]u64 = [_]u64{0} ** number_of_levels,
+
+    slots: [number_of_levels * slots_per_level]?*Timer = [_]?*Timer{null} ** (number_of_levels * slots_per_level),
+
+    /// The wheel tick the hardware timer is armed for, `disarmed` if it is not armed.
+    armed_for: u64 = disarmed,
+
+    /// Advances the clock as far towards `now` as possible without passing an occupied slot.
+    ///
+    /// Keeps the distance of newly armed timers small, and so their placement precise, after a period with no expiries.
+    fn forward(self: *ProcessorState, now: u64) void {
+        const target = @min(now, self.nextExpiry() orelse now);
+        if (target > self.clock) self.clock = target;
+    }
+
+    fn insert(self: *ProcessorState, timer: *Timer) void {
+        const expires = @max(deadlineToTick(timer.deadline), self.clock);
+        const distance = @min(expires - self.clock, maximum_distance);
+
+        const level = levelFor(distance);
+        const shift = levelShiftFor(level);
+
+        // rounding up to the granularity of the level means the timer never fires early
+        const index = (self.clock + distance + (@as(u64, 1) << shift) - 1) >> shift;
+        const position: u6 = @truncate(index);
+
+        const slot: u16 = @intCast(@as(usize, level) * slots_per_level + position);
+
+        timer.slot = slot;
+        timer.previous = null;
+        timer.next = self.slots[slot];
+        if (self.slots[slot]) |first| first.previous = timer;
+        self.slots[slot] = timer;
+
+        self.occupied[level] |= @as(u64, 1) << position;
+
+        @atomicStore(?*ProcessorState, &timer.wheel, self, .Release);
+    }
+
+    fn remove(self: *ProcessorState, timer: *Timer) void {
+        if (timer.previous) |previous| {
+            previous.next = timer.next;
+        } else {
+            self.slots[timer.slot] = timer.next;
+        }
+        if (timer.next) |next| next.previous = timer.previous;
+
+        if (self.slots[timer.slot] == null) {
+            const level = timer.slot / slots_per_level;
+            const position: u6 = @intCast(timer.slot % slots_per_level);
+            self.occupied[level] &= ~(@as(u64, 1) << position);
+        }
+
+        timer.next = null;
+        timer.previous = null;
+
+        @atomicStore(?*ProcessorState, &timer.wheel, null, .Release);
+    }
+
+    /// Returns the wheel tick of the earliest occupied slot.
+    fn nextExpiry(self: *const ProcessorState) ?u64 {
+        var next: ?u64 = null;
+
+        for (self.occupied, 0..) |occupied, level| {
+            if (occupied == 0) continue;
+
+            const shift = levelShiftFor(@intCast(level));
+
+            // the occupied slots of a level are always within one revolution from the current position of the clock
+            const base = (self.clock + (@as(u64, 1) << shift) - 1) >> shift;
+            const offset = @ctz(std.math.rotr(u64, occupied, @as(u6, @truncate(base))));
+
+            const tick = (base + offset) << shift;
+            next = if (next) |current_next| @min(current_next, tick) else tick;
+        }
+
+        return next;
+    }
+
+    /// Moves every timer in the slots due at `self.clock` onto `list`.
+    fn collectDue(self: *ProcessorState, list: *?*Timer) void {
+        var clock = self.clock;
+
+        for (0..number_of_levels) |level| {
+            const position: u6 = @truncate(clock);
+            const slot = level * slots_per_level + position;
+
+            while (self.slots[slot]) |timer| {
+                self.remove(timer);
+                timer.next = list.*;
+                list.* = timer;
+            }
+
+            // the next level only has a slot due if the clock is aligned to its granularity
+            if (clock & ((1 << level_shift) - 1) != 0) break;
+            clock >>= level_shift;
+        }
+    }
+
+    /// Arms the hardware timer for the next expiry, if it is not already.
+    ///
+    /// Must be called on the processor that owns this state.
+    fn program(self: *ProcessorState) void {
+        const next = self.nextExpiry() orelse disarmed;
+        if (next == self.armed_for) return;
+
+        self.armed_for = next;
+
+        if (next == disarmed) {
+            kernel.arch.timer.cancel();
+        } else {
+            kernel.arch.timer.setDeadline(next << cycle_shift);
+        }
+    }
+};
+
+/// Arms `timer` on the current processor to call `callback` at `deadline`, in ticks of
+/// `kernel.arch.readCycleCounter`.
+///
+/// `timer` must not be pending.
+pub fn schedule(timer: *Timer, deadline: u64, callback: Timer.Callback) void {
+    std.debug.assert(!timer.isPending());
+
+    timer.deadline = deadline;
+    timer.callback = callback;
+
+    kernel.Processor.disablePreemption();
+    defer kernel.Processor.enablePreemption();
+
+    const state = &Processor.current().timers;
+
+    const held = state.lock.lock();
+    defer held.unlock();
+
+    state.forward(currentTick());
+    state.insert(timer);
+    state.program();
+}
+
+/// Cancels `timer`.
+///
+/// Returns false if the timer was not pending, meaning it has already expired and its callback may still be running.
+///
+/// Can be called from any processor, the hardware timer of the processor the timer was armed on is left as is.
+pub fn cancel(timer: *Timer) bool {
+    while (true) {
+        const state = @atomicLoad(?*ProcessorState, &timer.wheel, .Acquire) orelse return false;
+
+        const held = state.lock.lock();
+        defer held.unlock();
+
+        // the timer expired or was cancelled between the load and taking the lock
+        if (timer.wheel != state) continue;
+
+        state.remove(timer);
+        return true;
+    }
+}
+
+/// Blocks the current task until `deadline`, in ticks of `kernel.arch.readCycleCounter`.
+pub fn sleepUntil(deadline: u64) void {
+    var sleeper: Sleeper = .{ .task = kernel.scheduler.currentTask() };
+
+    schedule(&sleeper.timer, deadline, Sleeper.expired);
+
+    while (!@atomicLoad(bool, &sleeper.expired_flag, .Acquire)) kernel.scheduler.block();
+}
+
+/// Blocks the current task for at least `cycles` ticks of `kernel.arch.readCycleCounter`.
+pub fn sleep(cycles: u64) void {
+    sleepUntil(kernel.arch.readCycleCounter() +| cycles);
+}
+
+/// Blocks the current task for at least `nanoseconds`.
+pub fn sleepNanoseconds(nanoseconds: u64) void {
+    // rounded up so the task never wakes early
+    sleep(kernel.time.nanosecondsToCycles(nanoseconds) + 1);
+}
+
+const Sleeper = struct {
+    timer: Timer = .{},
+    task: *kernel.Task,
+    expired_flag: bool = false,
+
+    fn expired(timer: *Timer) void {
+        const self = @fieldParentPtr(Sleeper, "timer", timer);
+
+        // `self` must not be accessed once `expired_flag` is set as the sleeping task may have moved on
+        const task = self.task;
+
+        @atomicStore(bool, &self.expired_flag, true, .Release);
+        kernel.scheduler.wake(task);
+    }
+};
+
+/// Expires every due timer on the current processor and arms the hardware timer for the next expiry.
+///
+/// Called by the architecture when the hardware timer fires, with interrupts disabled.
+pub fn expire() void {
+    const state = &Processor.current().timers;
+
+    var due: ?*Timer = null;
+
+    {
+        const held = state.lock.grab();
+        defer held.unlock();
+
+        // the hardware timer is no longer armed, and may have fired before the tick it was armed for
+        state.armed_for = disarmed;
+
+        const now = currentTick();
+
+        while (state.clock <= now) {
+            state.collectDue(&due);
+
+            // skip straight to the next occupied slot rather than stepping through empty ticks
+            state.clock = @min(state.nextExpiry() orelse now + 1, now + 1);
+        }
+
+        // timers beyond `maximum_distance` when they were armed are due before their deadline, so they are placed again
+        var timer_opt = due;
+        due = null;
+        while (timer_opt) |timer| {
+            timer_opt = timer.next;
+
+            if (deadlineToTick(timer.deadline) > now) {
+                state.insert(timer);
+            } else {
+                timer.next = due;
+                due = timer;
+            }
+        }
+
+        state.program();
+    }
+
+    var timer_opt = due;
+    while (timer_opt) |timer| {
+        timer_opt = timer.next;
+        timer.next = null;
+        timer.callback(timer);
+    }
+}
+
+inline fn currentTick() u64 {
+    return kernel.arch.readCycleCounter() >> cycle_shift;
+}
+
+/// Converts a deadline to the first wheel tick at or after it.
+inline fn deadlineToTick(deadline: u64) u64 {
+    return (deadline +| ((1 << cycle_shift) - 1)) >> cycle_shift;
+}
+
+inline fn levelShiftFor(level: u3) u6 {
+    return @as(u6, level) * level_shift;
+}
+
+/// The distance, in wheel ticks, a timer must be below to be placed in `level`.
+///
+/// One slot is kept free so that the rounded up slot of a timer never aliases the slot under the clock.
+fn levelCapacity(comptime level: u3) u64 {
+    return @as(u64, slots_per_level - 1) << levelShiftFor(level);
+}
+
+fn levelFor(distance: u64) u3 {
+    inline for (0..number_of_levels - 1) |level| {
+        if (distance < levelCapacity(level)) return level;
+    }
+    return number_of_levels - 1;
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+//! The format of the events recorded by tracepoints, shared by the kernel that records them and the host tool that
+//! converts them to the Chrome trace format.
+//!
+//! `kernel.trace.dump` logs a line per tracepoint and per event, each starting with `line_marker`:
+//!
+//!   @trace frequency <cycle counter frequency in Hz>
+//!   @trace tracepoint <id> <scope> <name>
+//!   @trace event <processor> <the bytes of the `Event` in hex>
+
+pub const line_marker = "@trace ";
+
+pub const Phase = enum(u8) {
+    /// Something happened at a point in time.
+    instant = 0,
+
+    /// The start of an interval, ended by the next `end` event of the same tracepoint on the same processor.
+    begin = 1,
+
+    end = 2,
+};
+
+pub const Event = extern struct {
+    /// The value of the cycle counter when the event was recorded.
+    timestamp: u64,
+
+    /// The id of the tracepoint that recorded the event.
+    tracepoint: u16,
+
+    phase: Phase,
+
+    _reserved: u8 = 0,
+
+    /// The id of the task that was running when the event was recorded.
+    task: u32,
+
+    /// The meaning of the arguments depends on the tracepoint.
+    arguments: [2]u64,
+};
+
+comptime {
+    if (@sizeOf(Event) != 32) @compileError("events are expected to be 32 bytes");
+}
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: MIT
+
+//! Static tracepoints.
+//!
+//! A tracepoint is declared at its call site through a scope, in the same way as a log scope:
+//!
+//!   const trace = kernel.trace.scoped(.vmm);
+//!
+//!   trace.begin(.map_range, .{ virtual_range.address.value, virtual_range.size.bytes });
+//!   defer trace.end(.map_range, .{ virtual_range.address.value, virtual_range.size.bytes });
+//!
+//! Every tracepoint has a state in the `.tracepoints` section, so they can be found and enabled by name at runtime. A
+//! disabled tracepoint costs a load and a well predicted branch, recording an event is kept out of line.
+//!
+//! An enabled tracepoint records a fixed size `Event` timestamped with the cycle counter into a ring owned by the
+//! current processor, once a ring is full the oldest events are overwritten. Recording takes no locks and does no
+//! formatting, that is left to `dump`, which logs the events in a form the `trace_to_chrome` tool converts into the
+//! Chrome trace format.
+//!
+//! Tracing is enabled from the kernel command line, see `configureFromCommandLine`.
+
+const std = @import("std");
+const core = @import("core");
+const kernel = @import("kernel");
+
+const Processor = kernel.Processor;
+
+pub const event_format = @import("event_format.zig");
+pub const Event = event_format.Event;
+pub const Phase = event_format.Phase;
+
+const log = kernel.log.scoped(.trace);
+
+/// The number of events each processor can hold, once full the oldest events are overwritten.
+const events_per_processor = 8192;
+
+/// The number of lines logged by `dump` before waiting for the log to drain.
+const lines_per_drain = 16;
+
+/// How long tracing runs for if `trace_seconds=` is not given on the kernel command line.
+const default_trace_seconds = 1;
+
+pub fn scoped(comptime scope: @Type(.EnumLiteral)) type {
+    return struct {
+        /// Records that `name` happened.
+        pub inline fn instant(comptime name: @Type(.EnumLiteral), arguments: anytype) void {
+            record(scope, name, .instant, arguments);
+        }
+
+        /// Records the start of `name`, must be followed by an `end` of the same tracepoint on the same processor.
+        pub inline fn begin(comptime name: @Type(.EnumLiteral), arguments: anytype) void {
+            record(scope, name, .begin, arguments);
+        }
+
+        /// Records the end of `name`.
+        pub inline fn end(comptime name: @Type(.EnumLiteral), arguments: anytype) void {
+            record(scope, name, .end, arguments);
+        }
+    };
+}
+
+fn Tracepoint(comptime scope: @Type(.EnumLiteral), comptime name: @Type(.EnumLiteral)) type {
+    return struct {
+        var state: TracepointState linksection(".tracepoints") = .{
+            .scope = @tagName(scope),
+            .name = @tagName(name),
+        };
+    };
+}
+
+/// The runtime state of a tracepoint.
+///
+/// One is placed in the `.tracepoints` section for every tracepoint used in the kernel, the id of a tracepoint is its
+/// index in the section.
+const TracepointState = struct {
+    scope: []const u8,
+    name: []const u8,
+
+    enabled: bool = false,
+
+    fn id(self: *const TracepointState) u16 {
+        return @intCast(@divExact(
+            @intFromPtr(self) - @intFromPtr(&linker_symbols.__tracepoints_start),
+            @sizeOf(TracepointState),
+        ));
+    }
+};
+
+const linker_symbols = struct {
+    extern var __tracepoints_start: TracepointState;
+    extern var __tracepoints_end: TracepointState;
+};
+
+fn tracepointStates() []TracepointState {
+    const start: [*]TracepointState = @ptrCast(&linker_symbols.__tracepoints_start);
+    const length = @intFromPtr(&linker_symbols.__tracepoints_end) - @intFromPtr(start);
+    return start[0 .. length / @sizeOf(TracepointState)];
+}
+
+/// Per-processor trace state.
+pub const ProcessorState = struct {
+    /// Allocated by the first call to `enable`.
+    events: []Event = &.{},
+
+    /// The total number of events ever recorded, only modified by the owning processor.
+    write_index: usize = 0,
+};
+
+inline fn record(
+    comptime scope: @Type(.EnumLiteral),
+    comptime name: @Type(.EnumLiteral),
+    comptime phase: Phase,
+    arguments: anytype,
+) void {
+    const state = &Tracepoint(scope, name).state;
+
+    // acquire pairs with the release in `enable`, so the rings are visible to any processor that sees the tracepoint
+    // as enabled
+    if (!@atomicLoad(bool, &state.enabled, .Acquire)) return;
+
+    recordEvent(state, phase, toArguments(arguments));
+}
+
+noinline fn recordEvent(state: *const TracepointState, phase: Phase, arguments: [2]u64) void {
+    @setCold(true);
+
+    const interrupts_enabled = kernel.arch.interrupts.interruptsEnabled();
+    kernel.arch.interrupts.disableInterrupts();
+    defer if (interrupts_enabled) kernel.arch.interrupts.enableInterrupts();
+
+    const processor = Processor.current();
+    const trace_state = &processor.trace;
+
+    // the slot is claimed before it is written so that an event recorded from a non-maskable interrupt part way
+    // through does not overwrite it
+    const index = @atomicRmw(usize, &trace_state.write_index, .Add, 1, .Monotonic);
+
+    trace_state.events[index % events_per_processor] = .{
+        .timestamp = kernel.arch.readCycleCounter(),
+        .tracepoint = state.id(),
+        .phase = phase,
+        .task = @intFromEnum(processor.scheduler.current_task.id),
+        .arguments = arguments,
+    };
+}
+
+inline fn toArguments(arguments: anytype) [2]u64 {
+    const fields = @typeInfo(@TypeOf(arguments)).Struct.fields;
+    if (fields.len > 2) @compileError("tracepoints take at most two arguments");
+
+    var result = [_]u64{ 0, 0 };
+    inline for (fields, 0..) |field, i| {
+        result[i] = toArgument(@field(arguments, field.name));
+    }
+    return result;
+}
+
+inline fn toArgument(value: anytype) u64 {
+    const T = @TypeOf(value);
+    return switch (@typeInfo(T)) {
+        .Int => |int| if (int.signedness == .signed) @bitCast(@as(i64, value)) else value,
+        .ComptimeInt => value,
+        .Bool => @intFromBool(value),
+        .Enum => toArgument(@intFromEnum(value)),
+        .Pointer => @intFromPtr(value),
+        else => @compileError("unsupported tracepoint argument type " ++ @typeName(T)),
+    };
+}
+
+/// Enables every tracepoint whose `<scope>.<name>` contains `matcher`, returns the number of tracepoints enabled.
+///
+/// Must be called once every processor is online.
+pub fn enable(matcher: []const u8) !usize {
+    for (Processor.all) |*processor| {
+        const state = &processor.trace;
+        if (state.events.len != 0) continue;
+
+        state.events = try kernel.vmm.allocateKernelBuffer(Event, events_per_processor);
+    }
+
+    var count: usize = 0;
+
+    for (tracepointStates()) |*tracepoint_state| {
+        var buffer: [128]u8 = undefined;
+        const full_name = std.fmt.bufPrint(
+            &buffer,
+            "{s}.{s}",
+            .{ tracepoint_state.scope, tracepoint_state.name },
+        ) catch &buffer;
+
+        if (std.mem.indexOf(u8, full_name, matcher) == null) continue;
+
+        @atomicStore(bool, &tracepoint_state.enabled, true, .Release);
+        count += 1;
+    }
+
+    return count;
+}
+
+/// Disables every tracepoint and waits for any event being recorded to complete.
+///
+/// Must be called from a task.
+pub fn disableAll() void {
+    for (tracepointStates()) |*tracepoint_state| {
+        @atomicStore(bool, &tracepoint_state.enabled, false, .Release);
+    }
+
+    // events are recorded with interrupts disabled, so once every processor has handled a cross call any event that
+    // was being recorded is complete
+    kernel.cross_call.callAndWait(Processor.allProcessorsMask(), barrier, 0);
+}
+
+fn barrier(context: usize) void {
+    _ = context;
+}
+
+/// Enables the tracepoints given on the kernel command line, then starts a task that disables them and dumps the
+/// events once the requested time has passed.
+///
+/// Each `trace=` option is a comma separated list of matchers, matched as in `enable`. `trace_seconds=` sets how
+/// long tracing runs for.
+///
+/// For example `trace=interrupts,spinlock trace_seconds=5`.
+///
+/// Only called once during `setup`, after buffered logging is initialized.
+pub fn configureFromCommandLine() void {
+    const command_line = kernel.boot.kernelCommandLine() orelse return;
+
+    var seconds: u64 = default_trace_seconds;
+    var enabled_any = false;
+
+    var options = std.mem.tokenizeScalar(u8, command_line, ' ');
+    while (options.next()) |option| {
+        if (std.mem.startsWith(u8, option, "trace_seconds=")) {
+            seconds = std.fmt.parseInt(u64, option["trace_seconds=".len..], 10) catch {
+                log.warn("invalid trace duration in '{s}'", .{option});
+                continue;
+            };
+            continue;
+        }
+
+        if (!std.mem.startsWith(u8, option, "trace=")) continue;
+
+        var matchers = std.mem.tokenizeScalar(u8, option["trace=".len..], ',');
+        while (matchers.next()) |matcher| {
+            const count = enable(matcher) catch |err| {
+                log.warn("unable to enable tracing: {s}", .{@errorName(err)});
+                return;
+            };
+
+            log.debug("enabled {} tracepoints matching '{s}'", .{ count, matcher });
+            if (count != 0) enabled_any = true;
+        }
+    }
+
+    if (!enabled_any) return;
+
+    _ = kernel.scheduler.spawn(traceTask, seconds * std.time.ns_per_s) catch |err| {
+        core.panicFmt("failed to start tracing: {s}", .{@errorName(err)});
+    };
+
+    log.info("tracing for {} seconds", .{seconds});
+}
+
+fn traceTask(duration: usize) void {
+    kernel.timer.sleepNanoseconds(duration);
+
+    disableAll();
+    dump();
+}
+
+/// Logs every tracepoint and the events in the ring of every processor, see `event_format`.
+///
+/// Tracing must be disabled. Must be called from a task.
+pub fn dump() void {
+    var lines_since_drain: usize = 0;
+
+    log.info(event_format.line_marker ++ "frequency {}", .{kernel.time.cycle_counter_frequency});
+
+    for (tracepointStates()) |*tracepoint_state| {
+        log.info(event_format.line_marker ++ "tracepoint {} {s} {s}", .{
+            tracepoint_state.id(),
+            tracepoint_state.scope,
+            tracepoint_state.name,
+        });
+        drainEvery(&lines_since_drain);
+    }
+
+    for (Processor.all) |*processor| {
+        const state = &processor.trace;
+        if (state.events.len == 0) continue;
+
+        const number_of_events = @min(state.write_index, events_per_processor);
+        const overwritten = state.write_index - number_of_events;
+
+        if (overwritten != 0) {
+            log.warn("processor {}: {} oldest events overwritten", .{ @intFromEnum(processor.id), overwritten });
+        }
+
+        for (overwritten..state.write_index) |index| {
+            const event = &state.events[index % events_per_processor];
+            log.info(event_format.line_marker ++ "event {} {}", .{
+                @intFromEnum(processor.id),
+                std.fmt.fmtSliceHexLower(std.mem.asBytes(event)),
+            });
+            drainEvery(&lines_since_drain);
+        }
+
+        state.write_index = 0;
+    }
+
+    kernel.log.waitForDrain();
+}
+
+fn drainEvery(lines_since_drain: *usize) void {
+    lines_since_drain.* += 1;
+    if (lines_since_drain.* == lines_per_drain) {
+        kernel.log.waitForDrain();
+        lines_since_drain.* = 0;
+    }
+}
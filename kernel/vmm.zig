@@ -9,10 +9,26 @@ const paging = kernel.arch.paging;
 const PageTable = paging.PageTable;
 
 const log = kernel.log.scoped(.vmm);
+const trace = kernel.trace.scoped(.vmm);
 
 var kernel_root_page_table: *PageTable = undefined;
 var heap_range: kernel.VirtualRange = undefined;
 
+/// Protects `next_kernel_stack_address` and `free_kernel_stacks`.
+var kernel_stacks_lock: kernel.SpinLock = .{};
+
+/// The address the next kernel stack (including its guard page) will be placed at.
+var next_kernel_stack_address: kernel.VirtualAddress = undefined;
+
+/// The unmapped virtual ranges of freed kernel stacks, reused by stacks of the same size.
+///
+/// The guard page before each range is not included.
+var free_kernel_stacks: [maximum_free_kernel_stacks]kernel.VirtualRange = undefined;
+var number_of_free_kernel_stacks: usize = 0;
+
+/// Once this many freed kernel stacks are waiting to be reused, the virtual ranges of any more are not reused.
+const maximum_free_kernel_stacks = 64;
+
 pub fn init() void {
     log.debug("allocating kernel root page table", .{});
     kernel_root_page_table = paging.allocatePageTable() catch
@@ -37,7 +53,7 @@ pub fn init() void {
     sortKernelMemoryLayout();
 
     log.debug("switching to kernel page table", .{});
-    paging.switchToPageTable(kernel_root_page_table);
+    switchToPageTable(kernel_root_page_table);
 
     if (log.levelEnabled(.debug)) {
         log.debug("kernel memory regions:", .{});
@@ -48,6 +64,270 @@ pub fn init() void {
     }
 }
 
+/// Switches the current processor to the kernel page table.
+///
+/// Used by non-bootstrap processors which start on the bootloader's page table.
+pub fn loadKernelPageTable() void {
+    switchToPageTable(kernel_root_page_table);
+}
+
+/// Switches the current processor to `page_table`, recording it for `TlbShootdown`.
+fn switchToPageTable(page_table: *const PageTable) void {
+    kernel.Processor.disablePreemption();
+    defer kernel.Processor.enablePreemption();
+
+    // pairs with `TlbShootdown.targets`, either the shootdown sees this processor using the page table or the switch
+    // happens after the page table was modified
+    @atomicStore(?*const PageTable, &kernel.Processor.current().page_table, page_table, .SeqCst);
+    paging.switchToPageTable(page_table);
+}
+
+/// Unmaps `virtual_range` from `page_table`, adding it to `shootdown` to be flushed from the TLBs.
+///
+/// The range must be mapped with standard sized pages, pages that are not mapped are skipped.
+///
+/// The range must not be accessed or reused until `shootdown.flush` has been called.
+pub fn unmapRange(page_table: *PageTable, virtual_range: kernel.VirtualRange, shootdown: *TlbShootdown) void {
+    std.debug.assert(virtual_range.address.isAligned(arch.paging.standard_page_size));
+    std.debug.assert(virtual_range.size.isAligned(arch.paging.standard_page_size));
+    std.debug.assert(shootdown.page_table == page_table);
+
+    log.debug("unmapping: {}", .{virtual_range});
+
+    kernel.arch.paging.unmapRange(page_table, virtual_range);
+    shootdown.add(virtual_range);
+}
+
+/// Batches TLB invalidations for a page table so that all of them are performed with a single cross-processor call.
+///
+/// Only processors using the page table are interrupted, for the kernel page table that is every processor as its
+/// mappings are global.
+pub const TlbShootdown = struct {
+    page_table: *const PageTable,
+
+    ranges: [maximum_ranges]kernel.VirtualRange = undefined,
+    number_of_ranges: usize = 0,
+
+    /// The number of pages covered by `ranges`.
+    number_of_pages: usize = 0,
+
+    /// Set when the ranges do not fit in `ranges` or cover more than `flush_all_threshold` pages, the entire TLB is
+    /// flushed instead.
+    flush_all: bool = false,
+
+    const maximum_ranges = 16;
+
+    /// Beyond this many pages invalidating each page individually costs more than refilling the entire TLB.
+    const flush_all_threshold = 64;
+
+    pub fn init(page_table: *const PageTable) TlbShootdown {
+        return .{ .page_table = page_table };
+    }
+
+    /// Adds `virtual_range` to be flushed by the next `flush`.
+    pub fn add(self: *TlbShootdown, virtual_range: kernel.VirtualRange) void {
+        if (self.flush_all) return;
+
+        self.number_of_pages += virtual_range.size.divide(arch.paging.standard_page_size);
+        if (self.number_of_pages > flush_all_threshold) {
+            self.flush_all = true;
+            return;
+        }
+
+        if (self.number_of_ranges != 0) {
+            const last = &self.ranges[self.number_of_ranges - 1];
+            if (last.end().equal(virtual_range.address)) {
+                last.size.addInPlace(virtual_range.size);
+                return;
+            }
+        }
+
+        if (self.number_of_ranges == maximum_ranges) {
+            self.flush_all = true;
+            return;
+        }
+
+        self.ranges[self.number_of_ranges] = virtual_range;
+        self.number_of_ranges += 1;
+    }
+
+    /// Flushes every added range from the TLBs of all processors using the page table, waiting for them to finish.
+    pub fn flush(self: *TlbShootdown) void {
+        if (self.number_of_ranges == 0 and !self.flush_all) return;
+
+        kernel.cross_call.callAndWait(self.targets(), flushLocal, @intFromPtr(self));
+
+        self.number_of_ranges = 0;
+        self.number_of_pages = 0;
+        self.flush_all = false;
+    }
+
+    /// Returns the processors that may have translations from the page table cached.
+    fn targets(self: *const TlbShootdown) u64 {
+        const all_page_tables = self.page_table == kernel_root_page_table;
+
+        var mask: u64 = 0;
+
+        for (kernel.Processor.all) |*processor| {
+            const page_table = @atomicLoad(?*const PageTable, &processor.page_table, .SeqCst) orelse continue;
+            if (all_page_tables or page_table == self.page_table) mask |= processor.id.mask();
+        }
+
+        return mask;
+    }
+
+    fn flushLocal(context: usize) void {
+        const self: *const TlbShootdown = @ptrFromInt(context);
+
+        if (self.flush_all) {
+            kernel.arch.paging.flushAll();
+            return;
+        }
+
+        for (self.ranges[0..self.number_of_ranges]) |range| kernel.arch.paging.flushRange(range);
+    }
+};
+
+/// Allocates a kernel stack of `size`, which must be a multiple of the standard page size.
+///
+/// The stack is preceded by an unmapped guard page so that an overflow faults rather than corrupting memory.
+///
+/// Kernel stacks are carved from the start of the kernel heap range, the virtual ranges of freed stacks are reused.
+pub fn allocateKernelStack(size: core.Size) !kernel.VirtualRange {
+    return allocateGuardedRange(size);
+}
+
+/// Frees a kernel stack allocated by `allocateKernelStack`, which must no longer be in use.
+pub fn freeKernelStack(stack_range: kernel.VirtualRange) void {
+    freeGuardedRange(stack_range);
+}
+
+/// Allocates a buffer of `count` values of `T` for data too large for a stack or a global, such as per-processor
+/// sample and event buffers. The contents are undefined.
+///
+/// There is no general purpose kernel allocator, so the buffer is rounded up to whole pages and placed like a kernel
+/// stack, after an unmapped guard page.
+pub fn allocateKernelBuffer(comptime T: type, count: usize) ![]align(paging.standard_page_size.bytes) T {
+    const size = core.Size.from(count * @sizeOf(T), .byte).alignForward(paging.standard_page_size);
+
+    const range = try allocateGuardedRange(size);
+    return range.address.toPtr([*]align(paging.standard_page_size.bytes) T)[0..count];
+}
+
+/// Frees a buffer allocated by `allocateKernelBuffer`, which must no longer be in use.
+pub fn freeKernelBuffer(comptime T: type, buffer: []align(paging.standard_page_size.bytes) T) void {
+    const size = core.Size.from(buffer.len * @sizeOf(T), .byte).alignForward(paging.standard_page_size);
+
+    freeGuardedRange(kernel.VirtualRange.fromAddr(kernel.VirtualAddress.fromPtr(buffer.ptr), size));
+}
+
+/// Maps a range of `size` preceded by an unmapped guard page in the kernel heap range.
+fn allocateGuardedRange(size: core.Size) !kernel.VirtualRange {
+    std.debug.assert(size.isAligned(paging.standard_page_size));
+
+    const range = try reserveKernelStackRange(size);
+    errdefer releaseKernelStackRange(range);
+
+    var mapped_range = kernel.VirtualRange.fromAddr(range.address, core.Size.zero);
+    errdefer unmapAndFreePages(mapped_range);
+
+    while (mapped_range.size.lessThan(range.size)) {
+        const page_range = kernel.VirtualRange.fromAddr(mapped_range.end(), paging.standard_page_size);
+
+        const physical_page = kernel.pmm.allocatePage() orelse return error.PageAllocationFailed;
+        errdefer kernel.pmm.deallocatePage(physical_page);
+
+        try mapRange(
+            kernel_root_page_table,
+            page_range,
+            physical_page,
+            .{ .writeable = true, .global = true },
+        );
+
+        mapped_range.size.addInPlace(paging.standard_page_size);
+    }
+
+    return range;
+}
+
+/// Frees a range allocated by `allocateGuardedRange`.
+fn freeGuardedRange(range: kernel.VirtualRange) void {
+    unmapAndFreePages(range);
+    releaseKernelStackRange(range);
+}
+
+fn reserveKernelStackRange(size: core.Size) !kernel.VirtualRange {
+    const held = kernel_stacks_lock.lock();
+    defer held.unlock();
+
+    for (free_kernel_stacks[0..number_of_free_kernel_stacks], 0..) |free_range, i| {
+        if (!free_range.size.equal(size)) continue;
+
+        number_of_free_kernel_stacks -= 1;
+        free_kernel_stacks[i] = free_kernel_stacks[number_of_free_kernel_stacks];
+
+        return free_range;
+    }
+
+    const stack_address = next_kernel_stack_address.moveForward(paging.standard_page_size);
+    const stack_range = kernel.VirtualRange.fromAddr(stack_address, size);
+
+    if (stack_range.end().greaterThan(heap_range.end())) return error.OutOfKernelStackSpace;
+
+    next_kernel_stack_address = stack_range.end();
+
+    return stack_range;
+}
+
+/// Makes the unmapped `stack_range` available to `reserveKernelStackRange` again.
+fn releaseKernelStackRange(stack_range: kernel.VirtualRange) void {
+    const held = kernel_stacks_lock.lock();
+    defer held.unlock();
+
+    if (stack_range.end().equal(next_kernel_stack_address)) {
+        next_kernel_stack_address = stack_range.address.moveBackward(paging.standard_page_size);
+        return;
+    }
+
+    if (number_of_free_kernel_stacks == maximum_free_kernel_stacks) {
+        log.warn("too many free kernel stacks, {} will not be reused", .{stack_range});
+        return;
+    }
+
+    free_kernel_stacks[number_of_free_kernel_stacks] = stack_range;
+    number_of_free_kernel_stacks += 1;
+}
+
+/// Unmaps `virtual_range` from the kernel page table and frees the physical pages that backed it.
+fn unmapAndFreePages(virtual_range: kernel.VirtualRange) void {
+    if (virtual_range.size.equal(core.Size.zero)) return;
+
+    // the physical pages are linked through their direct map as they cannot be freed until no TLB can still
+    // translate to them
+    const FreedPage = struct { next: ?*@This() };
+    var freed_pages: ?*FreedPage = null;
+
+    var page_address = virtual_range.address;
+    while (page_address.lessThan(virtual_range.end())) : (page_address.moveForwardInPlace(paging.standard_page_size)) {
+        const physical_address = paging.translate(kernel_root_page_table, page_address) orelse continue;
+
+        const freed_page = physical_address.toDirectMap().toPtr(*FreedPage);
+        freed_page.next = freed_pages;
+        freed_pages = freed_page;
+    }
+
+    var shootdown = TlbShootdown.init(kernel_root_page_table);
+    unmapRange(kernel_root_page_table, virtual_range, &shootdown);
+    shootdown.flush();
+
+    while (freed_pages) |freed_page| {
+        freed_pages = freed_page.next;
+
+        const physical_address = kernel.VirtualAddress.fromPtr(freed_page).toPhysicalFromDirectMap() catch unreachable;
+        kernel.pmm.deallocatePage(kernel.PhysicalRange.fromAddr(physical_address, paging.standard_page_size));
+    }
+}
+
 pub const MapType = struct {
     user: bool = false,
     global: bool = false,
@@ -97,6 +377,9 @@ pub fn mapRange(
         .{ virtual_range, physical_range, map_type },
     );
 
+    trace.begin(.map_range, .{ virtual_range.address.value, virtual_range.size.bytes });
+    defer trace.end(.map_range, .{ virtual_range.address.value, virtual_range.size.bytes });
+
     return kernel.arch.paging.mapRange(
         page_table,
         virtual_range,
@@ -123,6 +406,9 @@ pub fn mapRangeUseAllPageSizes(
         .{ virtual_range, physical_range, map_type },
     );
 
+    trace.begin(.map_range_use_all_page_sizes, .{ virtual_range.address.value, virtual_range.size.bytes });
+    defer trace.end(.map_range_use_all_page_sizes, .{ virtual_range.address.value, virtual_range.size.bytes });
+
     return kernel.arch.paging.mapRangeUseAllPageSizes(
         page_table,
         virtual_range,
@@ -254,6 +540,8 @@ fn prepareKernelHeap() !void {
     heap_range = try kernel.arch.paging.getHeapRangeAndFillFirstLevel(kernel_root_page_table);
     registerKernelMemoryRegion(.{ .range = heap_range, .type = .kernel_heap });
     log.debug("kernel heap: {}", .{heap_range});
+
+    next_kernel_stack_address = heap_range.address;
 }
 
 /// Maps a section.
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+
+//! Converts the tracepoint events dumped into a kernel log by `kernel.trace.dump` into the Chrome trace format, which
+//! can be opened in `chrome://tracing` or Perfetto.
+//!
+//!   zig build run_trace_to_chrome -- kernel.log > trace.json
+//!
+//! Reads from stdin if no file is given. Each processor is shown as a thread, timestamps are relative to the first
+//! event.
+
+const std = @import("std");
+const event_format = @import("trace_event_format");
+
+const Event = event_format.Event;
+
+const usage = "usage: trace_to_chrome [kernel log]\n";
+
+const Tracepoint = struct {
+    scope: []const u8,
+    name: []const u8,
+};
+
+const ProcessorEvent = struct {
+    processor: u32,
+    event: Event,
+};
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+
+    const input = switch (args.len) {
+        1 => try std.io.getStdIn().readToEndAlloc(allocator, std.math.maxInt(usize)),
+        2 => try std.fs.cwd().readFileAlloc(allocator, args[1], std.math.maxInt(usize)),
+        else => {
+            try std.io.getStdErr().writeAll(usage);
+            std.process.exit(1);
+        },
+    };
+
+    var frequency: ?u64 = null;
+    var tracepoints = std.AutoHashMap(u16, Tracepoint).init(allocator);
+    var events = std.ArrayList(ProcessorEvent).init(allocator);
+
+    var lines = std.mem.tokenizeAny(u8, input, "\r\n");
+    while (lines.next()) |line| {
+        const marker_index = std.mem.indexOf(u8, line, event_format.line_marker) orelse continue;
+
+        var fields = std.mem.tokenizeScalar(u8, line[marker_index + event_format.line_marker.len ..], ' ');
+        const kind = fields.next() orelse continue;
+
+        if (std.mem.eql(u8, kind, "frequency")) {
+            frequency = try std.fmt.parseInt(u64, fields.next() orelse return error.MalformedLine, 10);
+        } else if (std.mem.eql(u8, kind, "tracepoint")) {
+            const id = try std.fmt.parseInt(u16, fields.next() orelse return error.MalformedLine, 10);
+            try tracepoints.put(id, .{
+                .scope = fields.next() orelse return error.MalformedLine,
+                .name = fields.next() orelse return error.MalformedLine,
+            });
+        } else if (std.mem.eql(u8, kind, "event")) {
+            const processor = try std.fmt.parseInt(u32, fields.next() orelse return error.MalformedLine, 10);
+
+            var bytes: [@sizeOf(Event)]u8 = undefined;
+            const decoded = try std.fmt.hexToBytes(&bytes, fields.next() orelse return error.MalformedLine);
+            if (decoded.len != bytes.len) return error.MalformedLine;
+
+            try events.append(.{ .processor = processor, .event = std.mem.bytesToValue(Event, &bytes) });
+        }
+    }
+
+    const cycles_per_microsecond = @as(f64, @floatFromInt(frequency orelse return error.MissingFrequency)) /
+        std.time.us_per_s;
+
+    var first_timestamp: u64 = std.math.maxInt(u64);
+    for (events.items) |processor_event| first_timestamp = @min(first_timestamp, processor_event.event.timestamp);
+
+    var buffered_writer = std.io.bufferedWriter(std.io.getStdOut().writer());
+    const writer = buffered_writer.writer();
+
+    try writer.writeAll("{\"traceEvents\":[\n");
+
+    for (events.items, 0..) |processor_event, i| {
+        const event = processor_event.event;
+        const tracepoint = tracepoints.get(event.tracepoint) orelse return error.UnknownTracepoint;
+
+        const timestamp = @as(f64, @floatFromInt(event.timestamp - first_timestamp)) / cycles_per_microsecond;
+
+        try writer.print(
+            "{{\"name\":\"{s}\",\"cat\":\"{s}\",\"ph\":\"{s}\",\"ts\":{d:.3},\"pid\":0,\"tid\":{}",
+            .{ tracepoint.name, tracepoint.scope, phaseName(event.phase), timestamp, processor_event.processor },
+        );
+
+        if (event.phase == .instant) try writer.writeAll(",\"s\":\"t\"");
+
+        try writer.print(
+            ",\"args\":{{\"task\":{},\"argument0\":\"0x{x}\",\"argument1\":\"0x{x}\"}}}}",
+            .{ event.task, event.arguments[0], event.arguments[1] },
+        );
+
+        try writer.writeAll(if (i + 1 == events.items.len) "\n" else ",\n");
+    }
+
+    try writer.writeAll("]}\n");
+    try buffered_writer.flush();
+}
+
+fn phaseName(phase: event_format.Phase) []const u8 {
+    return switch (phase) {
+        .instant => "i",
+        .begin => "B",
+        .end => "E",
+    };
+}